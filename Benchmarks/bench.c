@@ -0,0 +1,601 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <omp.h>
+
+#include "../Seq_Lib/cpu.h"
+#include "../Seq_Lib/fqreader.h"
+#include "../Seq_Lib/gccount.h"
+#include "../Kmer_Hash/ht.h"
+#include "../NWalgo/nw.h"
+#include "../Seq_Gen/synth.h"
+
+#define DEFAULT_SIZES "1,4,16" // MB of FASTQ text
+#define DEFAULT_REPS 5
+#define DEFAULT_WARMUP 1
+#define MAX_SWEEP 64           // most sizes or thread counts in one run
+#define SPLIT_BATCH 4096       // records split off at a time when parsing
+#define SYNTH_BATCH 1024       // synthetic reads generated at a time
+#define DP_MAX_LEN 1000        // dp skips pairs with a longer read
+#define KMER_K 21
+#define MATCH 2                // NWalgo/dp defaults
+#define MISMATCH -1
+#define GAP -2
+
+
+// FASTQ text and its records, parsed once before timing
+typedef struct{
+    const char *text;
+    size_t len;
+    fq_record *recs;
+    size_t nreads;
+    size_t nbases;
+    size_t max_len;     // longest read
+    char *owned;        // text when generated, NULL when mapped from a file
+    fq_reader *reader;  // the file otherwise
+} bench_input;
+
+// A kernel runs once over the whole input on nt threads, sets *bytes to
+// the bytes it went through and returns a checksum that must not depend
+// on nt
+typedef struct{
+    const char *name;
+    const char *desc;
+    uint64_t (*run)(const bench_input *in, int nt, size_t *bytes);
+} bench_kernel;
+
+
+static void print_usage_and_exit(const char *progname){
+    fprintf(stderr,
+        "Usage: %s [-k KERNELS] [-s MB,...] [-i FASTQ] [-t THREADS,...] [-r REPS] [-w WARMUP] [-o JSON]\n"
+        " -k KERNELS : comma-separated kernels to run (default all):\n"
+        "              parse : split FASTQ text into records (fq_split)\n"
+        "              gc    : GC count every read (gc_count)\n"
+        "              kmer  : count the %d-mers of every read in a hash table\n"
+        "              dp    : Needleman-Wunsch fill for consecutive read pairs\n"
+        "                      (pairs with a read over %d bases are skipped)\n"
+        " -s MB,... : sizes of synthetic FASTQ input (default %s), 150 base reads\n"
+        "             from Seq_Gen's generator with its default options\n"
+        " -i FASTQ : time on this uncompressed FASTQ file instead, e.g. one\n"
+        "            written by Seq_Gen/seqgen\n"
+        " -t THREADS,... : thread counts (default 1, 2, 4, ... up to all CPUs)\n"
+        " -r REPS : timed runs per point, the median is reported (default %d)\n"
+        " -w WARMUP : untimed runs before them (default %d)\n"
+        " -o JSON : also write every timing to this file\n"
+        "Times each kernel by wall clock for every size and thread count,\n"
+        "exiting with an error if a thread count changes its result.\n",
+        progname, KMER_K, DP_MAX_LEN, DEFAULT_SIZES, DEFAULT_REPS, DEFAULT_WARMUP);
+
+    exit(EXIT_FAILURE);
+}
+
+static void exit_nomem(void){
+    fprintf(stderr, "out of memory\n");
+    exit(EXIT_FAILURE);
+}
+
+
+/* Kernels */
+
+static uint64_t run_parse(const bench_input *in, int nt, size_t *bytes){
+
+    uint64_t total = 0;
+    int failed = 0;
+    int bad = 0;
+
+    // Each thread resyncs to the first record of its byte range, as
+    // multiGC_optim does on a mapped file
+    #pragma omp parallel num_threads(nt) reduction(+:total, failed, bad)
+    {
+        int t = omp_get_thread_num();
+        size_t start = fq_sync(in->text, in->len, in->len * t / nt);
+        size_t stop = fq_sync(in->text, in->len, in->len * (t + 1) / nt);
+        fq_record *recs = malloc(SPLIT_BATCH * sizeof(fq_record));
+
+        failed += recs == NULL;
+
+        while(recs && start < stop){
+            size_t n = 0;
+            size_t used = 0;
+            if(fq_split(in->text + start, stop - start, 1, recs, SPLIT_BATCH, &n, &used) != 1 || n == 0){
+                bad++;
+                break;
+            }
+            total += n;
+            start += used;
+        }
+
+        free(recs);
+    }
+
+    if(failed){
+        exit_nomem();
+    }
+
+    if(bad){
+        fprintf(stderr, "x Synthetic input did not parse\n");
+        exit(EXIT_FAILURE);
+    }
+
+    *bytes = in->len;
+    return total;
+}
+
+static uint64_t run_gc(const bench_input *in, int nt, size_t *bytes){
+
+    uint64_t gc = 0;
+
+    #pragma omp parallel for num_threads(nt) reduction(+:gc) schedule(static)
+    for(size_t i = 0; i < in->nreads; i++){
+        gc += gc_count(in->recs[i].seq, in->recs[i].seq_len);
+    }
+
+    *bytes = in->nbases;
+    return gc;
+}
+
+/* Add n to the count of key, as the k-mer tools do. Return 0, or -1 if
+out of memory */
+static int add_count(ht *kcounts, const char *key, int n){
+
+    int *pcount = ht_get(kcounts, key);
+
+    if(pcount){
+        *pcount += n;
+        return 0;
+    }
+
+    pcount = malloc(sizeof(int));
+
+    if(!pcount){
+        return -1;
+    }
+
+    *pcount = n;
+
+    if(ht_set(kcounts, key, pcount) == NULL){
+        free(pcount);
+        return -1;
+    }
+
+    return 0;
+}
+
+static uint64_t run_kmer(const bench_input *in, int nt, size_t *bytes){
+
+    uint64_t total = 0;
+    int failed = 0;
+
+    // Thread-local tables over even slices of the reads; the checksum is
+    // the k-mers counted, which any split of the reads gives the same
+    #pragma omp parallel num_threads(nt) reduction(+:total, failed)
+    {
+        int t = omp_get_thread_num();
+        ht *kcounts = ht_create();
+        char kmer[KMER_K + 1];
+
+        failed += kcounts == NULL;
+
+        for(size_t i = in->nreads * t / nt; kcounts && !failed && i < in->nreads * (t + 1) / nt; i++){
+            const fq_record *rec = &in->recs[i];
+            for(size_t j = 0; j + KMER_K <= rec->seq_len; j++){
+                memcpy(kmer, rec->seq + j, KMER_K);
+                kmer[KMER_K] = '\0';
+                if(add_count(kcounts, kmer, 1) != 0){
+                    failed++;
+                    break;
+                }
+            }
+        }
+
+        if(kcounts){
+            hti it = ht_iterator(kcounts);
+            while(ht_next(&it)){
+                total += *(int *)it.value;
+                free(it.value);
+            }
+            ht_destroy(kcounts);
+        }
+    }
+
+    if(failed){
+        exit_nomem();
+    }
+
+    *bytes = in->nbases;
+    return total;
+}
+
+static uint64_t run_dp(const bench_input *in, int nt, size_t *bytes){
+
+    int64_t total = 0;
+    size_t aligned = 0;
+    int failed = 0;
+    size_t max_len = in->max_len < DP_MAX_LEN ? in->max_len : DP_MAX_LEN;
+
+    // Read 2i against read 2i + 1, each thread reusing one matrix
+    #pragma omp parallel num_threads(nt) reduction(+:total, aligned, failed)
+    {
+        int *S = malloc((max_len + 1) * (max_len + 1) * sizeof(int));
+
+        failed += S == NULL;
+
+        #pragma omp for schedule(dynamic, 64)
+        for(size_t p = 0; p < in->nreads / 2; p++){
+            const fq_record *a = &in->recs[2 * p];
+            const fq_record *b = &in->recs[2 * p + 1];
+            if(S && a->seq_len <= max_len && b->seq_len <= max_len){
+                nw_fill(a->seq, a->seq_len, b->seq, b->seq_len, MATCH, MISMATCH, GAP, S);
+                total += S[(a->seq_len + 1) * (b->seq_len + 1) - 1];
+                aligned += a->seq_len + b->seq_len;
+            }
+        }
+
+        free(S);
+    }
+
+    if(failed){
+        exit_nomem();
+    }
+
+    *bytes = aligned;
+    return (uint64_t)total;
+}
+
+static const bench_kernel KERNELS[] = {
+    {"parse", "records split from FASTQ text", run_parse},
+    {"gc", "reads GC counted", run_gc},
+    {"kmer", "reads k-mer counted", run_kmer},
+    {"dp", "reads aligned in pairs", run_dp},
+};
+
+#define NUM_KERNELS (sizeof KERNELS / sizeof KERNELS[0])
+
+
+/* Input */
+
+/* Split in->text into records, setting every field but the text's */
+static void split_input(bench_input *in, const char *path){
+
+    size_t cap = 0;
+    size_t off = 0;
+    in->recs = NULL;
+    in->nreads = 0;
+    in->nbases = 0;
+    in->max_len = 0;
+
+    while(off < in->len){
+
+        if(cap - in->nreads < SPLIT_BATCH){
+            cap = 2 * cap + SPLIT_BATCH;
+            fq_record *grown = realloc(in->recs, cap * sizeof(fq_record));
+            if(!grown){
+                exit_nomem();
+            }
+            in->recs = grown;
+        }
+
+        size_t n = 0;
+        size_t used = 0;
+        if(fq_split(in->text + off, in->len - off, 1, in->recs + in->nreads, SPLIT_BATCH, &n, &used) != 1){
+            fprintf(stderr, "x Malformed FASTQ record after read %zu in '%s'\n", in->nreads + n, path);
+            exit(EXIT_FAILURE);
+        }
+        if(n == 0){
+            break;
+        }
+
+        for(size_t i = in->nreads; i < in->nreads + n; i++){
+            in->nbases += in->recs[i].seq_len;
+            if(in->recs[i].seq_len > in->max_len){
+                in->max_len = in->recs[i].seq_len;
+            }
+        }
+
+        in->nreads += n;
+        off += used;
+
+    }
+}
+
+/* Generate about MB megabytes of FASTQ with the Seq_Gen defaults. The
+same size always gives the same input */
+static void make_input(size_t MB, bench_input *in){
+
+    synth_opts o;
+    synth_defaults(&o, 0);
+
+    synth *g = synth_new(&o);
+    size_t cap = 0;
+    size_t len = 0;
+
+    in->owned = NULL;
+    in->reader = NULL;
+
+    if(!g){
+        exit_nomem();
+    }
+
+    for(uint64_t first = 0; len < MB << 20; first += SYNTH_BATCH){
+        if(synth_records(g, first, SYNTH_BATCH, &in->owned, &len, &cap) != 0){
+            exit_nomem();
+        }
+    }
+
+    synth_free(g);
+
+    in->text = in->owned;
+    in->len = len;
+    split_input(in, "synthetic input");
+}
+
+/* Map a FASTQ file as the input */
+static void load_input(const char *path, bench_input *in){
+
+    in->owned = NULL;
+    in->reader = fq_open(path);
+
+    if(!in->reader){
+        perror("fq_open");
+        fprintf(stderr, "x Failed to open '%s'\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    in->text = fq_mapped(in->reader, &in->len);
+
+    if(!in->text){
+        fprintf(stderr, "x '%s' is not an uncompressed FASTQ file\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    split_input(in, path);
+}
+
+static void free_input(bench_input *in){
+    free(in->owned);
+    free(in->recs);
+    if(in->reader){
+        fq_close(in->reader);
+    }
+}
+
+
+/* Options */
+
+/* Parse a comma-separated list of positive integers into out[0, max).
+Return how many, or -1 if the list is not one */
+static int parse_list(const char *s, long *out, int max){
+
+    int n = 0;
+
+    while(*s){
+        char *end = NULL;
+        long v = strtol(s, &end, 10);
+        if(end == s || v <= 0 || n == max || (*end != ',' && *end != '\0')){
+            return -1;
+        }
+        out[n++] = v;
+        s = *end ? end + 1 : end;
+    }
+
+    return n ? n : -1;
+}
+
+/* Write s as a JSON string */
+static void json_string(FILE *out, const char *s){
+
+    fputc('"', out);
+    for(; *s; s++){
+        if(*s == '"' || *s == '\\'){
+            fputc('\\', out);
+        }
+        if((unsigned char)*s < 0x20){
+            fprintf(out, "\\u%04x", *s);
+        }else{
+            fputc(*s, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static int compare_double(const void *a, const void *b){
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+
+int main(int argc, char *argv[]){
+
+    const char *kernel_list = NULL;
+    const char *json_path = NULL;
+    const char *input_path = NULL;
+    long sizes[MAX_SWEEP];
+    long threads[MAX_SWEEP];
+    int nsizes = parse_list(DEFAULT_SIZES, sizes, MAX_SWEEP);
+    int nthreads = 0;
+    long reps = DEFAULT_REPS;
+    long warmup = DEFAULT_WARMUP;
+
+    int c;
+    while((c = getopt(argc, argv, "k:s:i:t:r:w:o:")) != -1){
+        switch(c){
+            case 'k': kernel_list = optarg; break;
+            case 's': nsizes = parse_list(optarg, sizes, MAX_SWEEP); break;
+            case 'i': input_path = optarg; break;
+            case 't': nthreads = parse_list(optarg, threads, MAX_SWEEP); break;
+            case 'r': reps = atol(optarg); break;
+            case 'w': warmup = strtol(optarg, NULL, 10); break;
+            case 'o': json_path = optarg; break;
+            default : print_usage_and_exit(argv[0]);
+        }
+    }
+
+    if(optind != argc || nsizes < 0 || nthreads < 0 || reps <= 0 || warmup < 0){
+        print_usage_and_exit(argv[0]);
+    }
+
+    // A file is one input, whatever its size
+    if(input_path){
+        nsizes = 1;
+    }
+
+    /* Which kernels? */
+
+    int run_kernel[NUM_KERNELS];
+
+    for(size_t k = 0; k < NUM_KERNELS; k++){
+        run_kernel[k] = kernel_list == NULL;
+    }
+
+    if(kernel_list){
+        const char *p = kernel_list;
+        while(*p){
+            size_t len = strcspn(p, ",");
+            size_t k = 0;
+            while(k < NUM_KERNELS && (strlen(KERNELS[k].name) != len || strncmp(KERNELS[k].name, p, len) != 0)){
+                k++;
+            }
+            if(k == NUM_KERNELS){
+                fprintf(stderr, "x Unknown kernel '%.*s'\n", (int)len, p);
+                return EXIT_FAILURE;
+            }
+            run_kernel[k] = 1;
+            p += len + (p[len] == ',');
+        }
+    }
+
+    // Default sweep doubles up to every CPU, always ending on all of them
+    if(nthreads == 0){
+        int max = omp_get_max_threads();
+        for(long p = 1; nthreads < MAX_SWEEP; p *= 2){
+            threads[nthreads++] = p < max ? p : max;
+            if(p >= max){
+                break;
+            }
+        }
+    }
+
+    FILE *json = NULL;
+
+    if(json_path){
+        json = fopen(json_path, "w");
+        if(!json){
+            perror("fopen");
+            fprintf(stderr, "x Failed to open '%s'\n", json_path);
+            return EXIT_FAILURE;
+        }
+
+        char date[32];
+        time_t now = time(NULL);
+        strftime(date, sizeof date, "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+        fprintf(json, "{\n  \"date\": \"%s\",\n  \"simd\": \"%s\",\n  \"cpus\": %d,\n"
+                      "  \"reps\": %ld,\n  \"warmup\": %ld,\n  \"input\": ",
+                date, cpu_level_name(cpu_detect()), omp_get_num_procs(), reps, warmup);
+        json_string(json, input_path ? input_path : "synthetic");
+        fprintf(json, ",\n  \"results\": [");
+    }
+
+    double *secs = malloc(reps * sizeof(double));
+
+    if(!secs){
+        exit_nomem();
+    }
+
+    printf("%-6s %8s %8s %10s %10s %10s %9s\n",
+           "kernel", "MB", "threads", "median s", "best s", "Mreads/s", "GB/s");
+
+    int first_result = 1;
+
+    for(int s = 0; s < nsizes; s++){
+
+        bench_input in;
+        if(input_path){
+            load_input(input_path, &in);
+        }else{
+            make_input((size_t)sizes[s], &in);
+        }
+        double MB = in.len / 1048576.0;
+
+        for(size_t k = 0; k < NUM_KERNELS; k++){
+
+            if(!run_kernel[k]){
+                continue;
+            }
+
+            uint64_t expect = 0;
+
+            for(int t = 0; t < nthreads; t++){
+
+                int nt = (int)threads[t];
+                size_t bytes = 0;
+                uint64_t sum = 0;
+
+                for(long w = 0; w < warmup; w++){
+                    sum = KERNELS[k].run(&in, nt, &bytes);
+                }
+
+                for(long r = 0; r < reps; r++){
+                    double start = omp_get_wtime();
+                    sum = KERNELS[k].run(&in, nt, &bytes);
+                    secs[r] = omp_get_wtime() - start;
+                }
+
+                if(t == 0){
+                    expect = sum;
+                }else if(sum != expect){
+                    fprintf(stderr, "x %s gave a different result on %d threads than on %ld\n",
+                            KERNELS[k].name, nt, threads[0]);
+                    return EXIT_FAILURE;
+                }
+
+                qsort(secs, reps, sizeof(double), compare_double);
+
+                // Odd and even counts alike: mean of the middle one or two
+                double median = (secs[(reps - 1) / 2] + secs[reps / 2]) / 2;
+                double reads_per_s = in.nreads / median;
+                double gb_per_s = bytes / median / 1e9;
+
+                printf("%-6s %8.1f %8d %10.4f %10.4f %10.3f %9.3f\n",
+                       KERNELS[k].name, MB, nt, median, secs[0], reads_per_s / 1e6, gb_per_s);
+
+                if(json){
+                    fprintf(json, "%s\n    {\"kernel\": \"%s\", \"desc\": \"%s\", \"mb\": %.2f, \"threads\": %d,"
+                                  " \"reads\": %zu, \"bytes\": %zu, \"checksum\": %llu,\n"
+                                  "     \"median_s\": %.6f, \"best_s\": %.6f, \"reads_per_s\": %.1f,"
+                                  " \"gb_per_s\": %.4f, \"seconds\": [",
+                            first_result ? "" : ",", KERNELS[k].name, KERNELS[k].desc, MB, nt,
+                            in.nreads, bytes, (unsigned long long)sum,
+                            median, secs[0], reads_per_s, gb_per_s);
+                    for(long r = 0; r < reps; r++){
+                        fprintf(json, "%s%.6f", r ? ", " : "", secs[r]);
+                    }
+                    fprintf(json, "]}");
+                    first_result = 0;
+                }
+
+            }
+
+        }
+
+        free_input(&in);
+
+    }
+
+    free(secs);
+
+    if(json){
+        fprintf(json, "\n  ]\n}\n");
+        if(fclose(json) != 0){
+            perror("fclose");
+            fprintf(stderr, "x Failed to write '%s'\n", json_path);
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
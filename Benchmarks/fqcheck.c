@@ -0,0 +1,244 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "../Seq_Lib/fqreader.h"
+
+#define DEFAULT_MB 24   // several of the streamed reader's 4 MiB blocks
+#define READ_LEN 150
+#define BLANK_EVERY 1000 // records between blank lines
+
+
+// Records, bases and a hash of every field, for checking one read of a
+// file against what was written to it
+typedef struct{
+    size_t reads;
+    size_t bases;
+    uint64_t hash;
+} file_summary;
+
+// How a generated file lays out its lines
+typedef struct{
+    const char *name;
+    const char *eol;        // line terminator
+    const char *blank;      // what goes between records every BLANK_EVERY
+    int last_newline;       // whether the last line is terminated
+} layout;
+
+static const layout LAYOUTS[] = {
+    {"blank lines", "\n", "\n", 1},
+    {"runs of blank lines", "\n", "\n\n\n", 1},
+    {"CRLF with blank lines", "\r\n", "\r\n", 1},
+    {"no final newline", "\n", "\n", 0},
+};
+#define NUM_LAYOUTS (sizeof LAYOUTS / sizeof LAYOUTS[0])
+
+// The SEQLIB_IO settings for plain files; NULL maps them
+static const char *PLAIN_IO[] = {NULL, "pread", "uring"};
+#define NUM_PLAIN_IO (sizeof PLAIN_IO / sizeof PLAIN_IO[0])
+
+
+static void print_usage_and_exit(const char *progname){
+    fprintf(stderr,
+        "Usage: %s [MB] \n"
+        " [MB] : size of each generated FASTQ file (default %d)\n"
+        "Writes FASTQ files with blank lines between records, with LF and CRLF\n"
+        "line ends, plain and gzipped, and checks that every input path of\n"
+        "fq_open reads back exactly the records written, exiting with an error\n"
+        "on any difference.\n",
+        progname, DEFAULT_MB);
+
+    exit(EXIT_FAILURE);
+}
+
+/* FNV-1a over buf, continuing from h */
+static uint64_t hash_bytes(uint64_t h, const char *buf, size_t len){
+
+    for(size_t i = 0; i < len; i++){
+        h = (h ^ (unsigned char)buf[i]) * 0x100000001B3ULL;
+    }
+
+    return h;
+}
+
+/* Fold one record's fields into sum */
+static void add_record(file_summary *sum, const char *name, size_t name_len,
+                       const char *seq, const char *qual, size_t len){
+
+    sum->reads++;
+    sum->bases += len;
+    sum->hash = hash_bytes(sum->hash, name, name_len);
+    sum->hash = hash_bytes(sum->hash, seq, len);
+    sum->hash = hash_bytes(sum->hash, qual, len);
+}
+
+/*
+Write about mb MiB of FASTQ laid out as lay to path, gzipped if gz is set,
+and summarise what was written in sum. Return 0, or -1 on failure.
+*/
+static int write_file(const char *path, const layout *lay, size_t mb, int gz, file_summary *sum){
+
+    gzFile out = gzopen(path, gz ? "wb1" : "wbT");
+
+    if(!out){
+        return -1;
+    }
+
+    const char bases[4] = {'A', 'C', 'G', 'T'};
+    char name[32], seq[READ_LEN], qual[READ_LEN];
+    uint64_t state = 42;
+    size_t written = 0;
+    int failed = 0;
+
+    *sum = (file_summary){0, 0, 0xCBF29CE484222325ULL};
+
+    for(size_t i = 0; !failed; i++){
+
+        if(i > 0 && i % BLANK_EVERY == 0){
+            failed |= gzputs(out, lay->blank) < 0;
+        }
+
+        // Lengths vary so record ends fall anywhere in a block
+        size_t len = 1 + i % READ_LEN;
+        int name_len = snprintf(name, sizeof name, "r%zu", i);
+
+        for(size_t j = 0; j < len; j++){
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            seq[j] = bases[state >> 62];
+            qual[j] = (char)('!' + (state >> 32) % 41);
+        }
+
+        add_record(sum, name, (size_t)name_len, seq, qual, len);
+
+        written += (size_t)name_len + 2 * len + 2 + 4 * strlen(lay->eol);
+        int last = written >= mb << 20;
+
+        failed |= gzprintf(out, "@%s%s%.*s%s+%s%.*s", name, lay->eol, (int)len, seq,
+                           lay->eol, lay->eol, (int)len, qual) <= 0;
+
+        if(!last || lay->last_newline){
+            failed |= gzputs(out, lay->eol) < 0;
+        }
+
+        if(last){
+            break;
+        }
+    }
+
+    return gzclose(out) != Z_OK || failed ? -1 : 0;
+}
+
+/* Read path through fq_open into sum. Return fq_next's last status */
+static int read_file(const char *path, file_summary *sum){
+
+    *sum = (file_summary){0, 0, 0xCBF29CE484222325ULL};
+
+    fq_reader *reader = fq_open(path);
+
+    if(!reader){
+        return -1;
+    }
+
+    fq_record rec;
+    int status;
+
+    while((status = fq_next(reader, &rec)) == 1){
+        add_record(sum, rec.name, rec.name_len, rec.seq, rec.qual, rec.seq_len);
+        fq_recycle(reader);
+    }
+
+    fq_close(reader);
+
+    return status;
+}
+
+/* Read path with SEQLIB_IO set to io (unset if NULL) and compare to want;
+via names the input path in the report */
+static int check(const char *path, const char *io, const char *via,
+                 const file_summary *want, const char *what){
+
+    if(io){
+        setenv("SEQLIB_IO", io, 1);
+    }else{
+        unsetenv("SEQLIB_IO");
+    }
+
+    file_summary got;
+    int status = read_file(path, &got);
+    int ok = status == 0 && got.reads == want->reads && got.bases == want->bases &&
+             got.hash == want->hash;
+
+    printf("%-24s %-8s %s (%zu of %zu reads)\n", what, via,
+           ok ? "ok" : "FAILED", got.reads, want->reads);
+
+    return ok ? 0 : -1;
+}
+
+
+int main(int argc, char *argv[]){
+
+    size_t mb = DEFAULT_MB;
+
+    if(argc > 2){
+        print_usage_and_exit(argv[0]);
+    }
+
+    if(argc == 2){
+
+        char *endptr = NULL;
+        mb = strtoul(argv[1], &endptr, 10);
+
+        if(*endptr != '\0' || mb == 0){
+            print_usage_and_exit(argv[0]);
+        }
+
+    }
+
+    char dir[] = "/tmp/fqcheck.XXXXXX";
+
+    if(!mkdtemp(dir)){
+        perror("mkdtemp");
+        fprintf(stderr, "x Failed to make a scratch directory\n");
+        return EXIT_FAILURE;
+    }
+
+    char plain[sizeof dir + 16], gzipped[sizeof dir + 16];
+    snprintf(plain, sizeof plain, "%s/in.fq", dir);
+    snprintf(gzipped, sizeof gzipped, "%s/in.fq.gz", dir);
+
+    int failures = 0;
+
+    for(size_t l = 0; l < NUM_LAYOUTS; l++){
+
+        file_summary want, want_gz;
+
+        if(write_file(plain, &LAYOUTS[l], mb, 0, &want) != 0 ||
+           write_file(gzipped, &LAYOUTS[l], mb, 1, &want_gz) != 0){
+            perror("gzopen");
+            fprintf(stderr, "x Failed to write test files in '%s'\n", dir);
+            return EXIT_FAILURE;
+        }
+
+        for(size_t i = 0; i < NUM_PLAIN_IO; i++){
+            failures += check(plain, PLAIN_IO[i], PLAIN_IO[i] ? PLAIN_IO[i] : "mmap",
+                              &want, LAYOUTS[l].name) != 0;
+        }
+
+        failures += check(gzipped, NULL, "gzip", &want_gz, LAYOUTS[l].name) != 0;
+
+    }
+
+    unlink(plain);
+    unlink(gzipped);
+    rmdir(dir);
+
+    if(failures){
+        fprintf(stderr, "x %d input paths read back different records\n", failures);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "../Seq_Lib/cpu.h"
+#include "../Seq_Lib/gccount.h"
+
+#define DEFAULT_MB 256
+#define CHECK_LEN 300   // every length up to this is checked at every offset
+#define CHECK_OFFSETS 64
+#define REPEATS 5
+
+
+static void print_usage_and_exit(const char *progname){
+    fprintf(stderr,
+        "Usage: %s [MB] \n"
+        " [MB] : size of the buffer each GC kernel is timed on (default %d)\n"
+        "Checks every GC kernel this CPU can run against the scalar reference,\n"
+        "exiting with an error on any disagreement, then times each one next\n"
+        "to a plain read of the same buffer.\n",
+        progname, DEFAULT_MB);
+
+    exit(EXIT_FAILURE);
+}
+
+static double now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Read every word of buf, the bandwidth a kernel can at best reach */
+static size_t read_all(const char *buf, size_t len){
+
+    // Independent accumulators so the loop is bound by loads, not adds
+    uint64_t sum[4] = {0, 0, 0, 0};
+
+    for(size_t i = 0; i + 32 <= len; i += 32){
+        uint64_t w[4];
+        memcpy(w, buf + i, 32);
+        for(int k = 0; k < 4; k++){
+            sum[k] ^= w[k];
+        }
+    }
+
+    return (size_t)(sum[0] ^ sum[1] ^ sum[2] ^ sum[3]);
+}
+
+/* Best time over REPEATS passes of fn over buf, in GB/s */
+static double time_kernel(gc_count_fn fn, const char *buf, size_t len, size_t *result){
+
+    double best = 0.0;
+
+    for(int r = 0; r < REPEATS; r++){
+        double start = now();
+        *result = fn(buf, len);
+        double rate = len / (now() - start) / 1e9;
+        if(rate > best){
+            best = rate;
+        }
+    }
+
+    return best;
+}
+
+
+int main(int argc, char *argv[]){
+
+    if(argc > 2){
+        print_usage_and_exit(argv[0]);
+    }
+
+    size_t MB = DEFAULT_MB;
+
+    if(argc == 2){
+        long tmp = atol(argv[1]);
+        if(tmp <= 0){
+            print_usage_and_exit(argv[0]);
+        }
+        MB = (size_t)tmp;
+    }
+
+    size_t len = MB << 20;
+    char *buf = malloc(len);
+
+    if(!buf){
+        fprintf(stderr, "out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    // Mostly bases in both cases, with every other byte value mixed in
+    const char bases[] = "ACGTNacgtn";
+    srand(1);
+    for(size_t i = 0; i < len; i++){
+        buf[i] = rand() % 8 ? bases[rand() % 10] : (char)(rand() % 256);
+    }
+
+    cpu_level top = cpu_detect();
+
+    /* Check kernels against the scalar reference */
+
+    for(int level = CPU_SSE2; level <= (int)top; level++){
+
+        gc_count_fn fn = gc_count_kernel((cpu_level)level);
+
+        if(!fn){
+            continue;
+        }
+
+        for(size_t off = 0; off < CHECK_OFFSETS; off++){
+            for(size_t n = 0; n <= CHECK_LEN; n++){
+                if(fn(buf + off, n) != gc_count_scalar(buf + off, n)){
+                    fprintf(stderr, "x %s kernel disagrees with scalar at offset %zu, length %zu\n",
+                            cpu_level_name((cpu_level)level), off, n);
+                    return EXIT_FAILURE;
+                }
+            }
+        }
+
+        if(fn(buf, len) != gc_count_scalar(buf, len)){
+            fprintf(stderr, "x %s kernel disagrees with scalar on %zu MB\n",
+                    cpu_level_name((cpu_level)level), MB);
+            return EXIT_FAILURE;
+        }
+
+    }
+
+    printf("All kernels up to %s agree with scalar\n", cpu_level_name(top));
+
+    /* Time kernels */
+
+    printf("%-8s %8s\n", "kernel", "GB/s");
+
+    double start = now();
+    size_t sink = read_all(buf, len);
+    double best = len / (now() - start) / 1e9;
+    for(int r = 1; r < REPEATS; r++){
+        start = now();
+        sink ^= read_all(buf, len);
+        double rate = len / (now() - start) / 1e9;
+        if(rate > best){
+            best = rate;
+        }
+    }
+    printf("%-8s %8.2f\n", "read", best);
+
+    for(int level = CPU_SCALAR; level <= (int)top; level++){
+
+        gc_count_fn fn = gc_count_kernel((cpu_level)level);
+        size_t gc;
+
+        if(fn){
+            printf("%-8s %8.2f\n", cpu_level_name((cpu_level)level), time_kernel(fn, buf, len, &gc));
+            sink ^= gc;
+        }
+
+    }
+
+    printf("gc_count uses %s (checksum %zx)\n", gc_count_impl(), sink);
+
+    free(buf);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,231 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../Seq_Lib/fqreader.h"
+#include "../Seq_Lib/gccount.h"
+
+#define DEFAULT_RUNS 3
+
+
+// What one pass over the file found, so the input paths can be checked
+// against each other as well as timed.
+typedef struct{
+    size_t reads;
+    size_t bases;
+    size_t GCcount;
+} pass_result;
+
+
+static void print_usage_and_exit(const char *progname){
+    fprintf(stderr,
+        "Usage: %s [-w] <fastq file> [runs] \n"
+        " <fastq file> : path to an uncompressed .fastq or .fq file\n"
+        " [runs] : passes per input path (default %d), best and mean are shown\n"
+        " -w : leave the file in the page cache between passes (warm cache)\n"
+        "Times a full parse and GC count of the file through getline (the\n"
+        "original tools' stdio path) and through fq_open with each SEQLIB_IO\n"
+        "setting. Before each pass the file is evicted from the page cache,\n"
+        "so by default every pass reads from the device.\n",
+        progname, DEFAULT_RUNS);
+
+    exit(EXIT_FAILURE);
+}
+
+static double now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Drop the file's pages from the page cache so the next pass is cold */
+static int evict(const char *path){
+
+    int fd = open(path, O_RDONLY);
+
+    if(fd < 0){
+        return -1;
+    }
+
+    int err = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+
+    return err == 0 ? 0 : -1;
+}
+
+/* Parse with fopen/getline the way the tools originally did */
+static int pass_stdio(const char *path, pass_result *res){
+
+    FILE *fp = fopen(path, "r");
+
+    if(!fp){
+        return -1;
+    }
+
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t len;
+    size_t line_no = 0;
+
+    while((len = getline(&line, &cap, fp)) != -1){
+
+        // Sequence is the second line of every record
+        if(line_no++ % 4 == 1){
+            while(len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')){
+                len--;
+            }
+            res->reads++;
+            res->bases += (size_t)len;
+            res->GCcount += gc_count(line, (size_t)len);
+        }
+
+    }
+
+    free(line);
+    fclose(fp);
+
+    return 0;
+}
+
+/* Parse with fq_open, reading plain files the way io asks */
+static int pass_reader(const char *path, const char *io, pass_result *res){
+
+    setenv("SEQLIB_IO", io, 1);
+
+    fq_reader *reader = fq_open(path);
+
+    if(!reader){
+        return -1;
+    }
+
+    fq_record rec;
+    int status;
+
+    while((status = fq_next(reader, &rec)) == 1){
+        res->reads++;
+        res->bases += rec.seq_len;
+        res->GCcount += gc_count(rec.seq, rec.seq_len);
+        fq_recycle(reader);
+    }
+
+    fq_close(reader);
+
+    return status == 0 ? 0 : -1;
+}
+
+
+int main(int argc, char *argv[]){
+
+    int warm = 0;
+
+    int c;
+    while((c = getopt(argc, argv, "w")) != -1){
+        switch(c) {
+            case 'w': warm = 1; break;
+            default : print_usage_and_exit(argv[0]);
+        }
+    }
+
+    if (argc - optind != 1 && argc - optind != 2){
+        print_usage_and_exit(argv[0]);
+    }
+
+    const char *path = argv[optind];
+
+    int runs = DEFAULT_RUNS;
+
+    if(argc - optind == 2){
+        runs = atoi(argv[optind + 1]);
+        if(runs <= 0){
+            fprintf(stderr, "Error: [runs] must be a positive integer\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    struct stat st;
+
+    if(stat(path, &st) != 0){
+        perror("stat");
+        fprintf(stderr, "x Failed to open '%s'\n", path);
+        return EXIT_FAILURE;
+    }
+
+    double MB = st.st_size / 1e6;
+
+    /* Time every input path */
+
+    const char *paths[] = {"stdio", "mmap", "pread", "uring"};
+    int npaths = sizeof paths / sizeof paths[0];
+
+    pass_result first = {0, 0, 0};
+
+    printf("%s: %.1f MB, %s cache, %d run(s) per path\n",
+           path, MB, warm ? "warm" : "cold", runs);
+    printf("%-8s %-9s %10s %10s\n", "path", "backend", "best MB/s", "mean MB/s");
+
+    for(int p = 0; p < npaths; p++){
+
+        double best = 0.0;
+        double total = 0.0;
+        const char *backend = "getline";
+
+        for(int r = 0; r < runs; r++){
+
+            if(!warm && evict(path) != 0){
+                perror("posix_fadvise");
+                return EXIT_FAILURE;
+            }
+
+            pass_result res = {0, 0, 0};
+
+            double start = now();
+            int status = p == 0 ? pass_stdio(path, &res) : pass_reader(path, paths[p], &res);
+            double secs = now() - start;
+
+            if(status != 0){
+                fprintf(stderr, "x Failed to read '%s' through %s\n", path, paths[p]);
+                return EXIT_FAILURE;
+            }
+
+            // Every path must see the same reads
+            if(p == 0 && r == 0){
+                first = res;
+            }else if(res.reads != first.reads || res.bases != first.bases ||
+                     res.GCcount != first.GCcount){
+                fprintf(stderr, "x %s disagrees with stdio on '%s'\n", paths[p], path);
+                return EXIT_FAILURE;
+            }
+
+            double rate = MB / secs;
+            total += rate;
+            if(rate > best){
+                best = rate;
+            }
+
+        }
+
+        // Ask the reader which backend it really used (uring may fall back)
+        if(p > 0){
+            setenv("SEQLIB_IO", paths[p], 1);
+            fq_reader *reader = fq_open(path);
+            if(reader){
+                backend = fq_backend(reader);
+                fq_close(reader);
+            }
+        }
+
+        printf("%-8s %-9s %10.1f %10.1f\n", paths[p], backend, best, total / runs);
+
+    }
+
+    printf("%zu reads, %zu bases, GC fraction %.4f\n", first.reads, first.bases,
+           first.bases ? (double)first.GCcount / first.bases : 0.0);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "../Seq_Lib/cpu.h"
+#include "../Seq_Lib/nucleotide.h"
+
+#define DEFAULT_MB 256
+#define CHECK_LEN 300   // every length up to this is checked at every offset
+#define CHECK_OFFSETS 64
+#define REPEATS 5
+
+
+static void print_usage_and_exit(const char *progname){
+    fprintf(stderr,
+        "Usage: %s [MB] \n"
+        " [MB] : size of the buffer each kernel is timed on (default %d)\n"
+        "Checks every validation and packing kernel this CPU can run against\n"
+        "the scalar references, exiting with an error on any disagreement,\n"
+        "then times each one.\n",
+        progname, DEFAULT_MB);
+
+    exit(EXIT_FAILURE);
+}
+
+static double now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Fill buf with bases, mostly upper case ACGT, and every so often N, a
+lower case base or any byte at all */
+static void fill_bases(char *buf, size_t len, int odd_in){
+
+    const char bases[] = "ACGTNacgt";
+
+    for(size_t i = 0; i < len; i++){
+        buf[i] = rand() % odd_in ? bases[rand() % 4] :
+                 rand() % 4 ? bases[rand() % 9] : (char)(rand() % 256);
+    }
+
+}
+
+/* Return 1 if fn packs seq[0, len) as the scalar reference does */
+static int pack_agrees(nt_pack_fn fn, const char *seq, size_t len,
+                       uint8_t *packed, uint64_t *nmask, uint8_t *ref_packed, uint64_t *ref_nmask){
+
+    size_t nbytes = (len + 3) / 4;
+    size_t nwords = (len + 63) / 64;
+
+    // Bytes past the output must be left alone
+    memset(packed, 0xa5, nbytes + 16);
+    memset(nmask, 0xa5, (nwords + 1) * sizeof(uint64_t));
+
+    size_t flagged = fn(seq, len, packed, nmask);
+    size_t ref_flagged = nt_pack_scalar(seq, len, ref_packed, ref_nmask);
+
+    for(size_t j = nbytes; j < nbytes + 16; j++){
+        if(packed[j] != 0xa5){
+            return 0;
+        }
+    }
+
+    return flagged == ref_flagged && memcmp(packed, ref_packed, nbytes) == 0 &&
+           memcmp(nmask, ref_nmask, nwords * sizeof(uint64_t)) == 0;
+
+}
+
+
+int main(int argc, char *argv[]){
+
+    if(argc > 2){
+        print_usage_and_exit(argv[0]);
+    }
+
+    size_t MB = DEFAULT_MB;
+
+    if(argc == 2){
+        long tmp = atol(argv[1]);
+        if(tmp <= 0){
+            print_usage_and_exit(argv[0]);
+        }
+        MB = (size_t)tmp;
+    }
+
+    size_t len = MB << 20;
+    char *buf = malloc(len);
+    uint8_t *packed = malloc(len / 4 + 32);
+    uint8_t *ref_packed = malloc(len / 4 + 32);
+    uint64_t *nmask = malloc((len / 64 + 2) * sizeof(uint64_t));
+    uint64_t *ref_nmask = malloc((len / 64 + 2) * sizeof(uint64_t));
+
+    if(!buf || !packed || !ref_packed || !nmask || !ref_nmask){
+        fprintf(stderr, "out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    cpu_level top = cpu_detect();
+
+    /* Check kernels against the scalar references */
+
+    srand(1);
+
+    // Odd bytes often enough that spans end inside every check
+    fill_bases(buf, CHECK_OFFSETS + CHECK_LEN, 40);
+
+    for(int level = CPU_SSE2; level <= (int)top; level++){
+
+        nt_span_fn span = nt_valid_span_kernel((cpu_level)level);
+        nt_pack_fn pack = nt_pack_kernel((cpu_level)level);
+
+        for(size_t off = 0; off < CHECK_OFFSETS; off++){
+            for(size_t n = 0; n <= CHECK_LEN; n++){
+
+                for(int a = NT_ACGT; span && a <= NT_ACGTN; a++){
+                    if(span(buf + off, n, (nt_alphabet)a) != nt_valid_span_scalar(buf + off, n, (nt_alphabet)a)){
+                        fprintf(stderr, "x %s validation kernel disagrees with scalar at offset %zu, length %zu\n",
+                                cpu_level_name((cpu_level)level), off, n);
+                        return EXIT_FAILURE;
+                    }
+                }
+
+                if(pack && !pack_agrees(pack, buf + off, n, packed, nmask, ref_packed, ref_nmask)){
+                    fprintf(stderr, "x %s packing kernel disagrees with scalar at offset %zu, length %zu\n",
+                            cpu_level_name((cpu_level)level), off, n);
+                    return EXIT_FAILURE;
+                }
+
+            }
+        }
+
+    }
+
+    // Reads rarely hold anything but ACGT, so time on that
+    fill_bases(buf, len, 1000);
+
+    for(int level = CPU_SSE2; level <= (int)top; level++){
+
+        nt_pack_fn pack = nt_pack_kernel((cpu_level)level);
+
+        if(pack && !pack_agrees(pack, buf, len, packed, nmask, ref_packed, ref_nmask)){
+            fprintf(stderr, "x %s packing kernel disagrees with scalar on %zu MB\n",
+                    cpu_level_name((cpu_level)level), MB);
+            return EXIT_FAILURE;
+        }
+
+    }
+
+    printf("All kernels up to %s agree with scalar\n", cpu_level_name(top));
+
+    /* Time kernels */
+
+    // Only N and odd bytes stop ACGTN validation, so make the buffer
+    // valid to time a full pass
+    for(size_t i = 0; i < len; i++){
+        if(!(nt_class[(unsigned char)buf[i]] & NT_ACGTN)){
+            buf[i] = 'N';
+        }
+    }
+
+    printf("%-8s %12s %12s\n", "kernel", "valid GB/s", "pack GB/s");
+
+    size_t sink = 0;
+
+    for(int level = CPU_SCALAR; level <= (int)top; level++){
+
+        nt_span_fn span = nt_valid_span_kernel((cpu_level)level);
+        nt_pack_fn pack = nt_pack_kernel((cpu_level)level);
+        double best_span = 0.0;
+        double best_pack = 0.0;
+
+        for(int r = 0; r < REPEATS; r++){
+
+            double start = now();
+            sink += span ? span(buf, len, NT_ACGTN) : 0;
+            double rate = len / (now() - start) / 1e9;
+            if(rate > best_span){
+                best_span = rate;
+            }
+
+            start = now();
+            sink += pack ? pack(buf, len, packed, nmask) : 0;
+            rate = len / (now() - start) / 1e9;
+            if(rate > best_pack){
+                best_pack = rate;
+            }
+
+        }
+
+        // Levels without a packing kernel use the one below them
+        printf("%-8s %12.2f", cpu_level_name((cpu_level)level), best_span);
+        if(pack){
+            printf(" %12.2f\n", best_pack);
+        }else{
+            printf(" %12s\n", "-");
+        }
+
+    }
+
+    printf("nt_valid_span uses %s, nt_pack uses %s (checksum %zx)\n",
+           nt_valid_span_impl(), nt_pack_impl(), sink);
+
+    free(buf);
+    free(packed);
+    free(ref_packed);
+    free(nmask);
+    free(ref_nmask);
+
+    return EXIT_SUCCESS;
+}
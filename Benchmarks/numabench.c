@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <omp.h>
+
+#include "../Seq_Lib/gccount.h"
+#include "../Seq_Lib/topology.h"
+
+#define DEFAULT_MB 32
+#define REPEATS 5
+
+
+static void print_usage_and_exit(const char *progname){
+    fprintf(stderr,
+        "Usage: %s [MB] \n"
+        " [MB] : size of each thread's buffer of bases (default %d)\n"
+        "For the first 1, 2, ... NUMA nodes and 1, 2, 4, ... threads per node,\n"
+        "pins the threads and times them GC counting their own buffers twice:\n"
+        "once with every buffer allocated and filled by thread 0 (as when one\n"
+        "thread parses all batches) and once with each thread filling its own\n"
+        "(first touch, as multiGC_optim -n does). Prints total GB/s of both.\n",
+        progname, DEFAULT_MB);
+
+    exit(EXIT_FAILURE);
+}
+
+/* Allocate a buffer of len bases; the calling thread touches every page */
+static char *fill_buffer(size_t len, unsigned seed){
+
+    const char bases[] = "ACGT";
+    char *buf = malloc(len);
+
+    if(buf){
+        for(size_t i = 0; i < len; i++){
+            seed = seed * 1103515245 + 12345;
+            buf[i] = bases[seed >> 16 & 3];
+        }
+    }
+
+    return buf;
+}
+
+/*
+GC count every buffer on its own pinned thread, best of REPEATS, and
+return the total rate in GB/s. With local set each thread allocates its
+own buffer first, otherwise they must already be in bufs.
+*/
+static double run(char **bufs, size_t len, int nt, int nodes, int local, size_t *sink){
+
+    double best = 0.0;
+    int failed = 0;
+
+    #pragma omp parallel num_threads(nt) reduction(+:failed)
+    {
+        int t = omp_get_thread_num();
+        topo_pin_worker(t, nt, nodes);
+
+        if(local){
+            bufs[t] = fill_buffer(len, (unsigned)t + 1);
+            failed += bufs[t] == NULL;
+        }
+    }
+
+    if(failed){
+        return -1.0;
+    }
+
+    for(int r = 0; r < REPEATS; r++){
+
+        size_t gc = 0;
+        double start = omp_get_wtime();
+
+        #pragma omp parallel num_threads(nt) reduction(+:gc)
+        {
+            gc += gc_count(bufs[omp_get_thread_num()], len);
+        }
+
+        double rate = (double)len * nt / (omp_get_wtime() - start) / 1e9;
+        if(rate > best){
+            best = rate;
+        }
+        *sink += gc;
+
+    }
+
+    return best;
+}
+
+
+int main(int argc, char *argv[]){
+
+    if(argc > 2){
+        print_usage_and_exit(argv[0]);
+    }
+
+    size_t MB = DEFAULT_MB;
+
+    if(argc == 2){
+        long tmp = atol(argv[1]);
+        if(tmp <= 0){
+            print_usage_and_exit(argv[0]);
+        }
+        MB = (size_t)tmp;
+    }
+
+    size_t len = MB << 20;
+    int nodes = topo_nodes();
+    int max_threads = 0;
+
+    for(int n = 0; n < nodes; n++){
+        max_threads += topo_node_cpus(n);
+    }
+
+    char **bufs = calloc(max_threads, sizeof(char *));
+
+    if(!bufs){
+        fprintf(stderr, "out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("%d node(s), gc_count uses %s, %zu MB per thread\n", nodes, gc_count_impl(), MB);
+    printf("%5s %8s %13s %13s %7s\n", "nodes", "threads", "remote GB/s", "local GB/s", "ratio");
+
+    size_t sink = 0;
+
+    for(int k = 1; k <= nodes; k++){
+
+        // Threads per node double up to the smallest node used
+        int per_node = topo_node_cpus(0);
+        for(int n = 1; n < k; n++){
+            if(topo_node_cpus(n) < per_node){
+                per_node = topo_node_cpus(n);
+            }
+        }
+
+        // Always finish on full nodes
+        for(int p = 1; ; p = p * 2 < per_node ? p * 2 : per_node){
+
+            int nt = p * k;
+
+            // Thread 0 fills every buffer, so all of them sit on its node
+            topo_pin_worker(0, nt, k);
+            int failed = 0;
+            for(int t = 0; t < nt; t++){
+                bufs[t] = fill_buffer(len, (unsigned)t + 1);
+                failed |= bufs[t] == NULL;
+            }
+
+            double remote = failed ? -1.0 : run(bufs, len, nt, k, 0, &sink);
+
+            for(int t = 0; t < nt; t++){
+                free(bufs[t]);
+                bufs[t] = NULL;
+            }
+
+            double local = failed ? -1.0 : run(bufs, len, nt, k, 1, &sink);
+
+            for(int t = 0; t < nt; t++){
+                free(bufs[t]);
+                bufs[t] = NULL;
+            }
+
+            if(remote < 0 || local < 0){
+                fprintf(stderr, "out of memory\n");
+                return EXIT_FAILURE;
+            }
+
+            printf("%5d %8d %13.2f %13.2f %7.2f\n", k, nt, remote, local, local / remote);
+
+            if(p == per_node){
+                break;
+            }
+
+        }
+
+    }
+
+    printf("checksum %zx\n", sink);
+
+    free(bufs);
+
+    return EXIT_SUCCESS;
+}
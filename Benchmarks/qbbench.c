@@ -0,0 +1,194 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "../Seq_Lib/cpu.h"
+#include "../Seq_Lib/qualbin.h"
+
+#define DEFAULT_MB 256
+#define CHECK_LEN 300   // every length up to this is checked at every offset
+#define CHECK_OFFSETS 64
+#define REPEATS 5
+
+static const char *SCHEMES[] = {"illumina8", "novaseq", "none", "0-9:5,10-29:20,30-60:40"};
+
+
+static void print_usage_and_exit(const char *progname){
+    fprintf(stderr,
+        "Usage: %s [MB] \n"
+        " [MB] : size of the buffer each binning kernel is timed on (default %d)\n"
+        "Checks every quality binning kernel this CPU can run against the\n"
+        "scalar reference for several schemes and offsets, exiting with an\n"
+        "error on any disagreement, then times each one next to memcpy.\n",
+        progname, DEFAULT_MB);
+
+    exit(EXIT_FAILURE);
+}
+
+static double now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Return 0 if fn gives what the scalar reference gives on buf for every
+length and offset checked, else -1 after reporting where */
+static int check_kernel(qb_apply_fn fn, const qb_table *t, const char *buf, size_t len,
+                        char *out, char *ref, const char *what){
+
+    for(size_t off = 0; off < CHECK_OFFSETS; off++){
+        for(size_t n = 0; n <= CHECK_LEN; n++){
+
+            // Bytes past n must be left alone
+            memset(out, 0, n + 1);
+            memset(ref, 0, n + 1);
+            fn(t, buf + off, n, out);
+            qb_apply_scalar(t, buf + off, n, ref);
+
+            if(memcmp(out, ref, n + 1) != 0){
+                fprintf(stderr, "x %s disagrees with scalar at offset %zu, length %zu\n",
+                        what, off, n);
+                return -1;
+            }
+        }
+    }
+
+    fn(t, buf, len, out);
+    qb_apply_scalar(t, buf, len, ref);
+
+    if(memcmp(out, ref, len) != 0){
+        fprintf(stderr, "x %s disagrees with scalar on the whole buffer\n", what);
+        return -1;
+    }
+
+    // In place, as callers may do
+    memcpy(out, buf, len);
+    fn(t, out, len, out);
+
+    if(memcmp(out, ref, len) != 0){
+        fprintf(stderr, "x %s disagrees with scalar in place\n", what);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+int main(int argc, char *argv[]){
+
+    if(argc > 2){
+        print_usage_and_exit(argv[0]);
+    }
+
+    size_t MB = DEFAULT_MB;
+
+    if(argc == 2){
+        long tmp = atol(argv[1]);
+        if(tmp <= 0){
+            print_usage_and_exit(argv[0]);
+        }
+        MB = (size_t)tmp;
+    }
+
+    size_t len = MB << 20;
+    char *buf = malloc(len);
+    char *out = malloc(len);
+    char *ref = malloc(len);
+
+    if(!buf || !out || !ref){
+        fprintf(stderr, "out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    // Mostly Phred+33 qualities, with every other byte value mixed in
+    srand(1);
+    for(size_t i = 0; i < len; i++){
+        buf[i] = rand() % 8 ? (char)('!' + rand() % 42) : (char)(rand() % 256);
+    }
+
+    cpu_level top = cpu_detect();
+
+    /* Check kernels against the scalar reference */
+
+    for(size_t s = 0; s < sizeof SCHEMES / sizeof SCHEMES[0]; s++){
+        for(int in = 33; in <= 64; in += 31){
+            for(int enc = 33; enc <= 64; enc += 31){
+
+                qb_table t;
+
+                if(qb_table_init(&t, SCHEMES[s], in, enc) != 0){
+                    fprintf(stderr, "x Scheme '%s' was not accepted\n", SCHEMES[s]);
+                    return EXIT_FAILURE;
+                }
+
+                for(int level = CPU_SSE2; level <= (int)top; level++){
+
+                    qb_apply_fn fn = qb_apply_kernel((cpu_level)level);
+                    char what[96];
+
+                    if(!fn){
+                        continue;
+                    }
+
+                    snprintf(what, sizeof what, "%s kernel (%s, %d to %d)",
+                             cpu_level_name((cpu_level)level), SCHEMES[s], in, enc);
+
+                    if(check_kernel(fn, &t, buf, len, out, ref, what) != 0){
+                        return EXIT_FAILURE;
+                    }
+                }
+            }
+        }
+    }
+
+    printf("All kernels up to %s agree with scalar\n", cpu_level_name(top));
+
+    /* Time kernels */
+
+    qb_table t;
+    qb_table_init(&t, "illumina8", 33, 33);
+
+    printf("%-8s %8s\n", "kernel", "GB/s");
+
+    double best = 0.0;
+    for(int r = 0; r < REPEATS; r++){
+        double start = now();
+        memcpy(out, buf, len);
+        double rate = len / (now() - start) / 1e9;
+        if(rate > best){
+            best = rate;
+        }
+    }
+    printf("%-8s %8.2f\n", "memcpy", best);
+
+    for(int level = CPU_SCALAR; level <= (int)top; level++){
+
+        qb_apply_fn fn = qb_apply_kernel((cpu_level)level);
+
+        if(!fn){
+            continue;
+        }
+
+        best = 0.0;
+        for(int r = 0; r < REPEATS; r++){
+            double start = now();
+            fn(&t, buf, len, out);
+            double rate = len / (now() - start) / 1e9;
+            if(rate > best){
+                best = rate;
+            }
+        }
+        printf("%-8s %8.2f\n", cpu_level_name((cpu_level)level), best);
+
+    }
+
+    printf("qb_apply uses %s (checksum %02x)\n", qb_apply_impl(), (unsigned char)out[len / 2]);
+
+    free(buf);
+    free(out);
+    free(ref);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define NUM_READS 100
+#define READ_LEN 50
+
+
+// One run of qc: its options (each %s is the scratch directory), the file
+// it reads and the read (or pair) count it should report
+typedef struct{
+    const char *name;
+    const char *args;
+    int empty;              // read the empty file rather than the reads
+    size_t reads;
+} qc_case;
+
+static const qc_case CASES[] = {
+    {"empty input", "-s gc,qual,kmer", 1, 0},
+    {"empty input, tables", "-s gc,qual,kmer -o %s/empty", 1, 0},
+    {"reads", "-s gc,qual,kmer", 0, NUM_READS},
+    {"reads as both mates", "-s gc,qual,kmer -p %s/reads.fq -o %s/pair", 0, NUM_READS},
+    {"empty input as both mates", "-s gc,qual,kmer -p %s/empty.fq", 1, 0},
+    {"every read trimmed away", "-s gc,qual,kmer -M 1000", 0, NUM_READS},
+    {"every read trimmed, -T", "-s gc,qual,kmer -M 1000 -T %s/trimmed.fq", 0, NUM_READS},
+    {"every read trimmed, none", "-s none -M 1000 -T %s/trimmed.fq", 0, NUM_READS},
+};
+#define NUM_CASES (sizeof CASES / sizeof CASES[0])
+
+// Files the runs above write to the scratch directory
+static const char *TABLES[] = {"empty.gc_hist.tsv", "empty.cycles.tsv", "empty.kmers.txt",
+                               "trimmed.fq", "pair.R1.gc_hist.tsv", "pair.R1.cycles.tsv",
+                               "pair.R1.kmers.txt", "pair.R2.gc_hist.tsv",
+                               "pair.R2.cycles.tsv", "pair.R2.kmers.txt"};
+#define NUM_TABLES (sizeof TABLES / sizeof TABLES[0])
+
+
+static void print_usage_and_exit(const char *progname){
+    fprintf(stderr,
+        "Usage: %s <qc> \n"
+        " <qc> : path to a built QC/qc\n"
+        "Runs qc over an empty FASTQ file and a small one with several sets\n"
+        "of options, trimming every read away in some and reading the files\n"
+        "as both mates of a pair in others, exiting with an error\n"
+        "if any run fails or reports the wrong read count.\n",
+        progname);
+
+    exit(EXIT_FAILURE);
+}
+
+/* Write NUM_READS reads of READ_LEN bases to path. Return 0, or -1 on failure */
+static int write_reads(const char *path){
+
+    FILE *out = fopen(path, "w");
+
+    if(!out){
+        return -1;
+    }
+
+    const char bases[4] = {'A', 'C', 'G', 'T'};
+    char seq[READ_LEN + 1], qual[READ_LEN + 1];
+
+    for(size_t i = 0; i < NUM_READS; i++){
+
+        for(size_t j = 0; j < READ_LEN; j++){
+            seq[j] = bases[(i + j * 7) % 4];
+            qual[j] = (char)('#' + (i + j) % 38);
+        }
+
+        seq[READ_LEN] = qual[READ_LEN] = '\0';
+        fprintf(out, "@r%zu\n%s\n+\n%s\n", i, seq, qual);
+    }
+
+    return fclose(out) == 0 ? 0 : -1;
+}
+
+/* Run qc as c says on path, with dir as the scratch directory, and check
+its exit status and read count */
+static int check(const char *qc, const qc_case *c, const char *dir, const char *path){
+
+    char args[1024], cmd[4096];
+    snprintf(args, sizeof args, c->args, dir, dir);
+    snprintf(cmd, sizeof cmd, "'%s' %s '%s' 2>&1", qc, args, path);
+
+    FILE *run = popen(cmd, "r");
+
+    if(!run){
+        return -1;
+    }
+
+    char line[1024];
+    size_t reads = 0;
+    int counted = 0;
+
+    while(fgets(line, sizeof line, run)){
+        counted |= sscanf(line, "Reads: %zu", &reads) == 1 ||
+                   sscanf(line, "Read pairs: %zu", &reads) == 1;
+    }
+
+    int status = pclose(run);
+    int exited = status != -1 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    int ok = exited && counted && reads == c->reads;
+
+    printf("%-28s %s (%zu of %zu reads%s)\n", c->name, ok ? "ok" : "FAILED",
+           reads, c->reads, exited ? "" : ", qc failed");
+
+    return ok ? 0 : -1;
+}
+
+
+int main(int argc, char *argv[]){
+
+    if(argc != 2){
+        print_usage_and_exit(argv[0]);
+    }
+
+    char dir[] = "/tmp/qccheck.XXXXXX";
+
+    if(!mkdtemp(dir)){
+        perror("mkdtemp");
+        fprintf(stderr, "x Failed to make a scratch directory\n");
+        return EXIT_FAILURE;
+    }
+
+    char empty[sizeof dir + 16], reads[sizeof dir + 16];
+    snprintf(empty, sizeof empty, "%s/empty.fq", dir);
+    snprintf(reads, sizeof reads, "%s/reads.fq", dir);
+
+    FILE *fp = fopen(empty, "w");
+
+    if(!fp || fclose(fp) != 0 || write_reads(reads) != 0){
+        perror("fopen");
+        fprintf(stderr, "x Failed to write test files in '%s'\n", dir);
+        return EXIT_FAILURE;
+    }
+
+    int failures = 0;
+
+    for(size_t i = 0; i < NUM_CASES; i++){
+        failures += check(argv[1], &CASES[i], dir, CASES[i].empty ? empty : reads) != 0;
+    }
+
+    for(size_t i = 0; i < NUM_TABLES; i++){
+        char table[sizeof dir + 32];
+        snprintf(table, sizeof table, "%s/%s", dir, TABLES[i]);
+        unlink(table);
+    }
+
+    unlink(empty);
+    unlink(reads);
+    rmdir(dir);
+
+    if(failures){
+        fprintf(stderr, "x %d qc runs failed\n", failures);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
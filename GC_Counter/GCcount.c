@@ -1,44 +1,440 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <omp.h>
+#include <pthread.h>
+#include <unistd.h>
 
-#define MAX_NAME_LEN 30
-#define MAX_SEQ_LEN 200
+#include "../Seq_Lib/fareader.h"
+#include "../Seq_Lib/nucleotide.h"
 
-typedef struct {
-    size_t len;
-    char name[MAX_NAME_LEN + 1];
-    char seq[MAX_SEQ_LEN + 1];
-} FastaSeq;
+#define DEFAULT_WINDOW 1000
+#define OUT_BUFFER (4u << 20) // bytes of bedGraph a record buffers before waiting for its turn
+#define FEED_SLICE (64u << 10) // sequence bytes windowed between buffer checks
 
+// Classes of sequence bytes. Line ends and other non-letters are not
+// bases at all; letters other than ACGT (N and ambiguity codes) take up
+// a position but are not called. Bit 0 marks G/C and bit 1 a called
+// base, so counts are updated by adding bits instead of branching.
+#define SKIP 0
+#define CALLED 2 // A or T
+#define CALLED_GC 3 // G or C
+#define UNCALLED 4
 
-int main(int argc, char *argv[]){
 
+// Sliding GC count over the last window bases of one record. Each step
+// adds the new base and drops the one falling out of the window, so the
+// cost per base is the same whatever the window size.
+typedef struct{
+    size_t window;
+    size_t step;
+    unsigned char *ring; // classes of the last window bases, position p at p % window
+    size_t pos;          // bases of the record seen so far
+    size_t next_start;   // start of the next window to write
+    size_t gc;           // G and C in the last min(pos, window) bases
+    size_t called;       // ACGT in the last min(pos, window) bases
+} gc_window;
+
+
+static unsigned char base_class[256];
+
+static void print_usage_and_exit(const char *progname){
+    fprintf(stderr,
+        "Usage: %s [-w WINDOW] [-s STEP] <fasta file> \n"
+        " <fasta file> : path to a .fa or .fasta file (optionally gzipped); any\n"
+        "                number of records, sequence lines of any length\n"
+        " -w WINDOW : window size in bases (default %d)\n"
+        " -s STEP : distance between window starts (default WINDOW)\n"
+        "Writes bedGraph to stdout: record, window start, window end (0-based,\n"
+        "half open) and the GC fraction of the window's A, C, G and T bases.\n"
+        "Windows with no A, C, G or T (e.g. all N) are left out. The last window\n"
+        "of a record is cut short at its end. Uncompressed files are split\n"
+        "between threads by record.\n",
+        progname, DEFAULT_WINDOW);
+
+    exit(EXIT_FAILURE);
+}
+
+static size_t parse_size(const char *arg, const char *what){
+
+    char *endptr = NULL;
+    errno = 0;
+    unsigned long long tmp = strtoull(arg, &endptr, 10);
+
+    if (errno == ERANGE ||           /* out of range for unsigned long long */
+        *endptr != '\0' ||           /* trailing junk like "123abc"         */
+        tmp == 0) {                  /* 0 is not a sensible size            */
+        fprintf(stderr,
+                "Error: %s must be a positive integer between 1 and %zu\n",
+                what, SIZE_MAX);
+        exit(EXIT_FAILURE);
+    }
+
+    return (size_t)tmp;
+}
+
+static void window_start(gc_window *w){
+
+    // An empty slot counts as neither G/C nor called, so it can be
+    // dropped like any other while the first window fills
+    memset(w->ring, SKIP, w->window);
+    w->pos = 0;
+    w->next_start = 0;
+    w->gc = 0;
+    w->called = 0;
+
+}
+
+static void write_window(FILE *out, const char *name, size_t name_len,
+                         size_t start, size_t end, size_t gc, size_t called){
+
+    if(called > 0){
+        fprintf(out, "%.*s\t%zu\t%zu\t%.4f\n", (int)name_len, name, start, end,
+                (double)gc / (double)called);
+    }
+
+}
+
+/* Slide the window over n raw sequence bytes, writing each window as it fills */
+static void window_feed(gc_window *w, const char *bytes, size_t n, FILE *out,
+                        const char *name, size_t name_len){
 
-    FastaSeq seq = {
-        strlen(argv[2]),
-        "",
-        "",
-    };
+    // Work on locals so the loop keeps its state in registers
+    size_t pos = w->pos;
+    size_t slot = pos % w->window;
+    size_t gc = w->gc;
+    size_t called = w->called;
+    size_t next_end = w->next_start + w->window;
 
-    strncpy(seq.name, argv[1], MAX_NAME_LEN - 1);
-    strncpy(seq.seq, argv[2], MAX_SEQ_LEN - 1);
+    for(size_t i = 0; i < n; i++){
 
+        unsigned char cls = base_class[(unsigned char)bytes[i]];
+
+        if(cls == SKIP){
+            continue;
+        }
 
-    
-    double GCcount = 0;
+        // Swap the base leaving the window for the new one
+        unsigned char old = w->ring[slot];
+        w->ring[slot] = cls;
+        if(++slot == w->window){
+            slot = 0;
+        }
 
-    for(int i = 0; i < seq.len; i++){
+        gc += (size_t)(cls & 1) - (old & 1);
+        called += (size_t)(cls >> 1 & 1) - (old >> 1 & 1);
 
-        if(seq.seq[i] == 'G' | seq.seq[i] == 'C'){
-            GCcount = GCcount + 1;
+        if(++pos == next_end){
+            write_window(out, name, name_len, next_end - w->window, pos, gc, called);
+            next_end += w->step;
         }
 
     }
 
+    w->pos = pos;
+    w->gc = gc;
+    w->called = called;
+    w->next_start = next_end - w->window;
+
+}
+
+/* Write the short window covering the end of the record, if any base is left out */
+static void window_finish(gc_window *w, FILE *out, const char *name, size_t name_len){
+
+    // Once a window reaches past the next start, all later bases are
+    // covered; otherwise the bases from next_start on are still in the ring
+    if(w->next_start >= w->pos || (w->next_start > 0 && w->next_start - w->step + w->window >= w->pos)){
+        return;
+    }
+
+    size_t gc = 0;
+    size_t called = 0;
+
+    for(size_t p = w->next_start; p < w->pos; p++){
+        unsigned char cls = w->ring[p % w->window];
+        gc += cls & 1;
+        called += cls >> 1 & 1;
+    }
+
+    write_window(out, name, name_len, w->next_start, w->pos, gc, called);
+
+}
+
+/* Window one record, reading its sequence from r */
+static void window_record(gc_window *w, fa_reader *r, FILE *out, const char *name, size_t name_len){
+
+    const char *bytes;
+    size_t n;
+
+    window_start(w);
+
+    while((n = fa_read_seq(r, &bytes)) > 0){
+        window_feed(w, bytes, n, out, name, name_len);
+    }
+
+    window_finish(w, out, name, name_len);
+
+}
+
+
+// One record of a mapped file: its name and sequence bytes are views
+// into the mapping, so threads can window records independently.
+typedef struct{
+    const char *name;
+    size_t name_len;
+    const char *seq;
+    size_t seq_len;
+} fasta_span;
+
+// Records of a mapped file are windowed in parallel but written in file
+// order: record i may write to stdout once turn reaches i.
+typedef struct{
+    pthread_mutex_t lock;
+    pthread_cond_t passed;
+    size_t turn;
+} output_order;
+
+static void wait_turn(output_order *order, size_t i){
+
+    pthread_mutex_lock(&order->lock);
+
+    while(order->turn != i){
+        pthread_cond_wait(&order->passed, &order->lock);
+    }
+
+    pthread_mutex_unlock(&order->lock);
+
+}
+
+static void pass_turn(output_order *order){
+
+    pthread_mutex_lock(&order->lock);
+    order->turn++;
+    pthread_cond_broadcast(&order->passed);
+    pthread_mutex_unlock(&order->lock);
 
-    printf("GC content is %f \n", GCcount / seq.len);
+}
+
+/*
+Window record i of a mapped file and write it in its turn. Its windows go
+to memory until the turn comes or OUT_BUFFER bytes of them pile up; then
+the thread waits for the turn, writes them out and sends the rest of the
+record straight to stdout, so a small step over a long record never holds
+more than about OUT_BUFFER bytes. The turn is passed on whatever happens.
+Return 0, or -1 if out of memory.
+*/
+static int window_span(gc_window *w, const fasta_span *span, size_t i, output_order *order,
+                       fa_reader *reader, const char *map){
+
+    char *text = NULL;
+    size_t text_len = 0;
+    FILE *buffered = w->ring ? open_memstream(&text, &text_len) : NULL;
+    FILE *out = buffered;
+    int failed = !buffered;
+
+    if(!failed){
+
+        window_start(w);
+
+        for(size_t done = 0; done < span->seq_len; ){
+
+            size_t n = span->seq_len - done < FEED_SLICE ? span->seq_len - done : FEED_SLICE;
+            window_feed(w, span->seq + done, n, out, span->name, span->name_len);
+            done += n;
+
+            if(out != buffered){
+                continue;
+            }
+
+            if(fflush(buffered) != 0){
+                failed = 1;
+                break;
+            }
+
+            if(text_len >= OUT_BUFFER){
+                wait_turn(order, i);
+                fwrite(text, 1, text_len, stdout);
+                out = stdout;
+            }
+
+        }
+
+        if(!failed){
+            window_finish(w, out, span->name, span->name_len);
+        }
+
+        size_t written = out == stdout ? text_len : 0;
+        failed |= fclose(buffered) != 0;
+
+        if(out == buffered){
+            wait_turn(order, i);
+        }
 
+        if(!failed && text_len > written){
+            fwrite(text + written, 1, text_len - written, stdout);
+        }
+
+    }else{
+
+        wait_turn(order, i);
+
+    }
+
+    free(text);
+    fa_drop(reader, (size_t)(span->seq - map), (size_t)(span->seq - map) + span->seq_len);
+    pass_turn(order);
+
+    return failed ? -1 : 0;
+
+}
+
+
+int main(int argc, char *argv[]){
+
+    size_t window = DEFAULT_WINDOW;
+    size_t step = 0;
+
+    int c;
+    while((c = getopt(argc, argv, "w:s:")) != -1){
+        switch(c) {
+            case 'w': window = parse_size(optarg, "WINDOW"); break;
+            case 's': step = parse_size(optarg, "STEP"); break;
+            default : print_usage_and_exit(argv[0]);
+        }
+    }
+
+    if (argc - optind != 1){
+        print_usage_and_exit(argv[0]);
+    }
+
+    if(step == 0){
+        step = window;
+    }
+
+    for(int b = 0; b < 256; b++){
+        if(nt_code[b] != NT_N){
+            base_class[b] = nt_code[b] == NT_C || nt_code[b] == NT_G ? CALLED_GC : CALLED;
+        }else if((b >= 'A' && b <= 'Z') || (b >= 'a' && b <= 'z') || b == '-' || b == '*'){
+            base_class[b] = UNCALLED;
+        }
+    }
+
+
+    /* Open file */
+
+    const char *path = argv[optind];
+
+    fa_reader *reader = fa_open(path);
+
+    if (!reader){
+        perror("fa_open");
+        fprintf(stderr, "x Failed to open '%s'\n", path);
+        return EXIT_FAILURE;
+    }
+
+    size_t map_len = 0;
+    const char *map = fa_mapped(reader, &map_len);
+
+    const char *name;
+    size_t name_len;
+    int status;
+
+    if(map){
+
+        /* Window records in parallel as they are found */
+
+        int failed = 0;
+        size_t next = 0;
+        status = 1;
+        output_order order = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0};
+
+        // Records are found and handed out in file order, one at a time, so
+        // the scan for the next record's end runs just ahead of windowing
+        // instead of over the whole mapping first, and a thread waiting for
+        // its turn only waits for records other threads already hold
+        #pragma omp parallel
+        {
+            gc_window w = {window, step, malloc(window), 0, 0, 0, 0};
+
+            for(;;){
+
+                fasta_span span;
+                size_t i = 0;
+                int got;
+
+                #pragma omp critical(gc_next_record)
+                {
+                    got = status == 1 ? fa_next_record(reader, &span.name, &span.name_len) : status;
+
+                    if(got == 1){
+                        // A mapped record's sequence comes back as one stretch
+                        span.seq_len = fa_read_seq(reader, &span.seq);
+                        i = next++;
+                    }else{
+                        status = got;
+                    }
+                }
+
+                if(got != 1){
+                    break;
+                }
+
+                if(window_span(&w, &span, i, &order, reader, map) != 0){
+                    #pragma omp atomic write
+                    failed = 1;
+                }
+
+            }
+
+            free(w.ring);
+        }
+
+        if(status == -1){
+            fprintf(stderr, "x Malformed FASTA after record %zu in '%s'\n", next, path);
+            return EXIT_FAILURE;
+        }
+
+        if(failed){
+            fprintf(stderr, "out of memory\n");
+            return EXIT_FAILURE;
+        }
+
+    }else{
+
+        /* Stream records one after another (gzip input) */
+
+        gc_window w = {window, step, malloc(window), 0, 0, 0, 0};
+
+        if(!w.ring){
+            fprintf(stderr, "out of memory\n");
+            return EXIT_FAILURE;
+        }
+
+        size_t nrecords = 0;
+
+        while((status = fa_next_record(reader, &name, &name_len)) == 1){
+            window_record(&w, reader, stdout, name, name_len);
+            nrecords++;
+        }
+
+        free(w.ring);
+
+        if(status == -1){
+            fprintf(stderr, "x Malformed FASTA after record %zu in '%s'\n", nrecords, path);
+            return EXIT_FAILURE;
+        }
+
+    }
+
+    fa_close(reader);
+
+    if(fflush(stdout) != 0){
+        perror("stdout");
+        return EXIT_FAILURE;
+    }
 
+    return EXIT_SUCCESS;
 
-}
\ No newline at end of file
+}
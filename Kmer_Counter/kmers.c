@@ -6,8 +6,7 @@
 #include <stdint.h>
 #include <math.h>
 
-
-static const char ALPHABET[4] = {'A', 'C', 'G', 'T'};
+#include "../Seq_Lib/nucleotide.h"
 
 typedef struct {
     size_t count;
@@ -34,27 +33,15 @@ int main(int argc, char *argv[]){
     /* Parse input sequence */
 
     const char *seq = argv[1];
-    const char *seqcheck = argv[1];
-
-    /* Check validity of input sequence */
-
-    while(*seqcheck != '\0'){
-
-        for(size_t i = 0; i < 4; i++){
-
-            if(ALPHABET[i] == *seqcheck){
-                seqcheck++;
-                break;
-            }else if(i == 3){
 
-                fprintf(stderr,
-                "Error: <read sequence> must be a sequence of As, Gs, Ts, and Cs\n");
-                return EXIT_FAILURE;
+    size_t seqlen = strlen(seq);
 
-            }
-
-        }
+    /* Check validity of input sequence */
 
+    if(nt_valid_span(seq, seqlen, NT_ACGT) != seqlen){
+        fprintf(stderr,
+        "Error: <read sequence> must be a sequence of As, Gs, Ts, and Cs\n");
+        return EXIT_FAILURE;
     }
     
     /* Parse k */
@@ -93,7 +80,7 @@ int main(int argc, char *argv[]){
         for(int pos = k -1; pos >=0; --pos){
 
             /* Cutsey trick to output in lexicographical order */
-            s[pos] = ALPHABET[tmp & 3];
+            s[pos] = nt_base[tmp & 3];
             tmp >>= 2;
 
         }
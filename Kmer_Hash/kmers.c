@@ -7,6 +7,8 @@
 #include <math.h>
 #include <stdbool.h>
 
+#include "../Seq_Lib/nucleotide.h"
+
 
 /*
 Strategy: Iterate over each kmer in a given read and
@@ -30,8 +32,6 @@ static uint64_t hash_key(const char* key) {
     return hash;
 }
 
-static const char ALPHABET[4] = {'A', 'C', 'G', 'T'};
-
 typedef struct{
     const char* key;
     void* value;
@@ -109,29 +109,15 @@ int main(int argc, char *argv[]){
     /* Parse input sequence */
 
     const char *seq = argv[1];
-    const char *seqcheck = argv[1];
 
     size_t seqlen = strlen(seq);
 
     /* Check validity of input sequence */
 
-    while(*seqcheck != '\0'){
-
-        for(size_t i = 0; i < 4; i++){
-
-            if(ALPHABET[i] == *seqcheck){
-                seqcheck++;
-                break;
-            }else if(i == 3){
-
-                fprintf(stderr,
-                "Error: <read sequence> must be a sequence of As, Gs, Ts, and Cs\n");
-                return EXIT_FAILURE;
-
-            }
-
-        }
-
+    if(nt_valid_span(seq, seqlen, NT_ACGT) != seqlen){
+        fprintf(stderr,
+        "Error: <read sequence> must be a sequence of As, Gs, Ts, and Cs\n");
+        return EXIT_FAILURE;
     }
     
     /* Parse k */
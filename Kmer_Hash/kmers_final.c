@@ -1,6 +1,7 @@
 // Simple hash table implemented in C.
 
 #include "ht.h"
+#include "../Seq_Lib/nucleotide.h"
 
 #include <assert.h>
 #include <stdint.h>
@@ -36,8 +37,6 @@ struct ht {
 #define FNV_PRIME 1099511628211UL
 #define INITIAL_CAPACITY 65536
 
-static const char ALPHABET[4] = {'A', 'C', 'G', 'T'};
-
 int main(int argc, char *argv[]){
 
 
@@ -55,29 +54,15 @@ int main(int argc, char *argv[]){
     /* Parse input sequence */
 
     const char *seq = argv[1];
-    const char *seqcheck = argv[1];
 
     size_t seqlen = strlen(seq);
 
     /* Check validity of input sequence */
 
-    while(*seqcheck != '\0'){
-
-        for(size_t i = 0; i < 4; i++){
-
-            if(ALPHABET[i] == *seqcheck){
-                seqcheck++;
-                break;
-            }else if(i == 3){
-
-                fprintf(stderr,
-                "Error: <read sequence> must be a sequence of As, Gs, Ts, and Cs\n");
-                return EXIT_FAILURE;
-
-            }
-
-        }
-
+    if(nt_valid_span(seq, seqlen, NT_ACGT) != seqlen){
+        fprintf(stderr,
+        "Error: <read sequence> must be a sequence of As, Gs, Ts, and Cs\n");
+        return EXIT_FAILURE;
     }
     
     /* Parse k */
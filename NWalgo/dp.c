@@ -10,12 +10,13 @@
 #include <unistd.h>
 #include <ctype.h>
 
+#include "../Seq_Lib/nucleotide.h"
+#include "nw.h"
+
 #define MATCH_SCORE_DEFAULT 2
 #define MISMATCH_SCORE_DEFAULT -1
 #define GAP_SCORE_DEFAULT -2
 
-static const char ALPHABET[4] = {'A', 'C', 'G', 'T'};
-
 typedef struct{
     char* align1;
     char* align2;
@@ -51,7 +52,6 @@ static void print_usage_and_exit(const char *progname){
 
 
 int* get_score_matrix(const char* s1, const char* s2, int match, int mismatch, int gap);
-int find_max3(int a, int b, int c);
 size_t which_max2(int a, int b);
 alignment* get_best_alignment(int *S, const char* s1, const char* s2, int mismatch);
 
@@ -81,8 +81,8 @@ int main(int argc, char *argv[]){
 
     /* Check validity of 1st input sequence */
 
-    size_t match1 = strspn(seq1, ALPHABET);
-    if(match1 != strlen(seq1)){
+    size_t len1 = strlen(seq1);
+    if(nt_valid_span(seq1, len1, NT_ACGT) != len1){
         fprintf(stderr,
         "Error: <sequence 1> must be a sequence of As, Gs, Ts, and Cs\n");
         return EXIT_FAILURE;
@@ -94,8 +94,8 @@ int main(int argc, char *argv[]){
 
     /* Check validity of input sequence */
 
-    size_t match2 = strspn(seq2, ALPHABET);
-    if(match2 != strlen(seq2)){
+    size_t len2 = strlen(seq2);
+    if(nt_valid_span(seq2, len2, NT_ACGT) != len2){
         fprintf(stderr,
         "Error: <sequence 2> must be a sequence of As, Gs, Ts, and Cs\n");
         return EXIT_FAILURE;
@@ -280,102 +280,12 @@ int* get_score_matrix(const char* s1, const char* s2, int match, int mismatch, i
         exit_nomem();
     }
 
-    // Lots of variables used throughout
-    size_t element = 0;
-    size_t last_col = 0;
-    size_t last_row = 0;
-    size_t diagnoal_above_element;
-    size_t above_element;
-    size_t beside_element;
-    int score_diag;
-    int score_abov;
-    int score_besi;
-    int double_include_score;
-
-    for(size_t i = 0; i<=N; i++){
-
-        for(size_t j = 0; j<=M; j++){
-
-            if(i == 0 && j == 0){
-                // Initial score = 0
-
-                DP_array[0] = 0;
-
-            } else if(i == 0){
-                // Only gap penalities at this point
-
-                last_col = element-1;
-                DP_array[element] = DP_array[last_col] + gap;
-
-            } else if(j == 0){
-                // Only gap penalties at this point
-
-                last_row = element-(M+1);
-                DP_array[element] = DP_array[last_row] + gap;
-
-            } else{
-
-                // Three possible paths:
-                diagnoal_above_element = element - (M+2);
-                above_element = element - (M+1);
-                beside_element = element - 1;
-
-                // Is inclusion of both a match?
-                if(s1[i-1] == s2[j-1]){
-
-                    double_include_score = match;
-
-                }else{
-
-                    double_include_score = mismatch;
-
-                }
-
-                // Calc scores for each
-                score_diag = DP_array[diagnoal_above_element] + double_include_score;
-                score_abov = DP_array[above_element] + gap;
-                score_besi = DP_array[beside_element] + gap;
-
-                DP_array[element] = find_max3(score_diag, score_abov, score_besi);
-
-
-
-            }
-
-
-            element++;
-
-        }
-
-    }
+    nw_fill(s1, N, s2, M, match, mismatch, gap, DP_array);
 
     return DP_array;
 
 }
 
-int find_max3(int a, int b, int c){
-
-    if(a >= b){
-
-        if(a >= c){
-
-            return a;
-
-        }else{
-            return c;
-        }
-
-    }else if(b >= c){
-
-        return b;
-
-    }else{
-
-        return c;
-    }
-
-}
-
 
 size_t which_max2(int a, int b){
 
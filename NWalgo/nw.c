@@ -0,0 +1,34 @@
+// Needleman-Wunsch score matrix fill.
+
+#include "nw.h"
+
+static int find_max3(int a, int b, int c) {
+    if (a >= b) {
+        return a >= c ? a : c;
+    }
+    return b >= c ? b : c;
+}
+
+void nw_fill(const char* s1, size_t n, const char* s2, size_t m,
+             int match, int mismatch, int gap, int* S) {
+    size_t cols = m + 1;
+
+    // Only gap penalties along the first row and column.
+    S[0] = 0;
+    for (size_t j = 1; j <= m; j++) {
+        S[j] = S[j - 1] + gap;
+    }
+
+    for (size_t i = 1; i <= n; i++) {
+        int* row = S + i * cols;
+        const int* above = row - cols;
+        row[0] = above[0] + gap;
+
+        // Three possible paths: both included (diagonal), or a gap in
+        // either sequence (above, beside).
+        for (size_t j = 1; j <= m; j++) {
+            int both = s1[i - 1] == s2[j - 1] ? match : mismatch;
+            row[j] = find_max3(above[j - 1] + both, above[j] + gap, row[j - 1] + gap);
+        }
+    }
+}
@@ -0,0 +1,15 @@
+// Needleman-Wunsch score matrix fill, shared by dp and the benchmarks.
+
+#ifndef _NW_H
+#define _NW_H
+
+#include <stddef.h>
+
+// Fill S, (n + 1) * (m + 1) ints laid out row by row, with the best global
+// alignment scores of every prefix of s1[0, n) (rows) against every prefix
+// of s2[0, m) (columns). S[(n + 1) * (m + 1) - 1] is the score of the
+// whole alignment.
+void nw_fill(const char* s1, size_t n, const char* s2, size_t m,
+             int match, int mismatch, int gap, int* S);
+
+#endif // _NW_H
@@ -5,27 +5,61 @@
 #include <errno.h>
 #include <stdint.h>
 #include <omp.h>
-#include <time.h>
 
+#include "../Seq_Lib/fqreader.h"
+#include "../Seq_Lib/gccount.h"
+#include "../Seq_Lib/wsteal.h"
 
+#define BATCH_SIZE 65536 // reads held in memory at a time
+#define PIECE_LEN 16384  // bases per stolen piece of work; longer reads are split
+
+
+// Fields are views into the reader's buffers (not NUL-terminated), valid
+// until the batch they belong to is recycled
 typedef struct{
     size_t read_len;
-    char *seq;
-    char *qualities;
-    char *name;
+    size_t name_len;
+    const char *seq;
+    const char *qualities;
+    const char *name;
 } fastq_entry;
 
 
+// GC counts of a batch's reads, built up piece by piece
+typedef struct{
+    const fastq_entry *fastqs;
+    size_t *gc;
+} gc_job;
+
+
+/* GC count bases [from, to) of one read; other threads may be counting
+other parts of it */
+static void count_part(void *ctx, size_t read, size_t from, size_t to, int whole){
+
+    gc_job *job = ctx;
+
+    // Vector kernel picked for this CPU, counts either case
+    size_t GCcount = gc_count(job->fastqs[read].seq + from, to - from);
+
+    if(whole){
+        job->gc[read] = GCcount;
+    }else{
+        __atomic_fetch_add(&job->gc[read], GCcount, __ATOMIC_RELAXED);
+    }
+
+}
+
+
 int main(int argc, char *argv[]){
 
-    clock_t start_time = clock();
+    double start_time = omp_get_wtime();
 
     /* Make sure correct number of arguments */
-    if (argc != 3){
+    if (argc != 2 && argc != 3){
         fprintf(stderr,
-        "Usage: %s <fastq file> <num_reads> \n"
-        " <fastq file> : path to a .fastq or .fq file\n"
-        " <num_reads> : positive integer (how many reads to parse)\n",
+        "Usage: %s <fastq file> [num_reads] \n"
+        " <fastq file> : path to a .fastq or .fq file (optionally gzipped)\n"
+        " [num_reads] : positive integer (how many reads to parse, default all)\n",
         argv[0]
         );
         return EXIT_FAILURE;
@@ -35,10 +69,10 @@ int main(int argc, char *argv[]){
 
     const char *path = argv[1];
 
-    FILE *file = fopen(path, "r");
+    fq_reader *reader = fq_open(path);
 
-    if (!file){
-        perror("fopen");
+    if (!reader){
+        perror("fq_open");
         fprintf(stderr, "x Failed to open '%s'\n", path);
         return EXIT_FAILURE;
     }
@@ -46,67 +80,92 @@ int main(int argc, char *argv[]){
 
     /* How many reads to read? */
 
-    char *endptr = NULL;
-    unsigned long long tmp = strtoull(argv[2], &endptr, 10);
+    size_t num_reads = SIZE_MAX; // whole file
 
-    errno = 0;
+    if(argc == 3){
 
-    if (errno == ERANGE ||           /* out of range for unsigned long long */
-        *endptr != '\0' ||           /* trailing junk like "123abc"         */
-        tmp == 0) {                  /* 0 is not a sensible read count      */
-        fprintf(stderr,
-                "Error: <num_reads> must be a positive integer between 1 and %zu\n",
-                SIZE_MAX);
-        return EXIT_FAILURE;
-    }
+        char *endptr = NULL;
+        errno = 0;
+        unsigned long long tmp = strtoull(argv[2], &endptr, 10);
+
+        if (errno == ERANGE ||           /* out of range for unsigned long long */
+            *endptr != '\0' ||           /* trailing junk like "123abc"         */
+            tmp == 0) {                  /* 0 is not a sensible read count      */
+            fprintf(stderr,
+                    "Error: <num_reads> must be a positive integer between 1 and %zu\n",
+                    SIZE_MAX);
+            return EXIT_FAILURE;
+        }
 
+        num_reads = (size_t)tmp;
 
-    size_t num_reads = (size_t)tmp;
+    }
 
-    /* Parse fastq entries */
+    /* Parse fastq entries and count GC one batch at a time */
 
+    // The batch array is reused and the reader's buffers recycled after
+    // every batch, so memory stays the same whatever the file size
     fastq_entry *fastqs;
 
-    fastqs = malloc(num_reads * sizeof(fastq_entry));
+    fastqs = malloc(BATCH_SIZE * sizeof(fastq_entry));
 
-    char *line = NULL;
-    size_t n = 0;
-    size_t lineno = 0;
-    size_t entry_cnt = 0;
+    // Read i of a batch is bases [off[i], off[i + 1]) of the batch as a
+    // whole, which is how its bases are shared out
+    size_t *off = malloc((BATCH_SIZE + 1) * sizeof(size_t));
+    size_t *gc = malloc(BATCH_SIZE * sizeof(size_t));
 
-    for(int i = 0; i < (num_reads*4); i++){
+    if(!fastqs || !off || !gc){
+        fprintf(stderr, "out of memory\n");
+        return EXIT_FAILURE;
+    }
 
-        if(getline(&line, &n, file)){
+    size_t entry_cnt = 0;
 
-            line[strcspn(line, "\r\n")] = '\0';
-        
-            size_t mem_to_allocate = strlen(line) + 1;
+    fq_record rec;
+    int status = 1;
 
-            if(lineno % 4 == 0){
+    uint64_t GC_sum = 0;
 
-                fastqs[entry_cnt].name = malloc(mem_to_allocate);
-                strcpy(fastqs[entry_cnt].name, line);
+    while(entry_cnt < num_reads && status == 1){
 
-            }else if(lineno % 4 == 1){
+        size_t batch_n = 0;
 
-                fastqs[entry_cnt].seq = malloc(mem_to_allocate);
-                strcpy(fastqs[entry_cnt].seq, line);
-                fastqs[entry_cnt].read_len = mem_to_allocate - 1;
+        while(batch_n < BATCH_SIZE && entry_cnt + batch_n < num_reads &&
+              (status = fq_next(reader, &rec)) == 1){
 
-            }else if(lineno % 4 == 3){
+            fastqs[batch_n].name = rec.name;
+            fastqs[batch_n].name_len = rec.name_len;
+            fastqs[batch_n].seq = rec.seq;
+            fastqs[batch_n].read_len = rec.seq_len;
+            fastqs[batch_n].qualities = rec.qual;
+            batch_n++;
 
-                fastqs[entry_cnt].qualities = malloc(mem_to_allocate);
-                strcpy(fastqs[entry_cnt].qualities, line);
-                entry_cnt++;
+        }
 
-            }
-            
-            lineno++;
-            n = 0;
+        if(status == -1){
+            fprintf(stderr, "x Malformed FASTQ record after read %zu in '%s'\n",
+                    entry_cnt + batch_n, path);
+            return EXIT_FAILURE;
+        }
 
+        // Threads steal pieces of PIECE_LEN bases rather than whole
+        // reads, so a batch with a few very long reads still keeps
+        // every thread busy
+        off[0] = 0;
+        for(size_t i = 0; i<batch_n; i++){
+            off[i + 1] = off[i] + fastqs[i].read_len;
+            gc[i] = 0;
         }
 
+        gc_job job = {fastqs, gc};
+        ws_for_bases(off, batch_n, PIECE_LEN, count_part, &job);
+
+        for(size_t i = 0; i<batch_n; i++){
+            GC_sum += gc_frac(gc[i], fastqs[i].read_len);
+        }
 
+        entry_cnt += batch_n;
+        fq_recycle(reader);
 
     }
 
@@ -115,63 +174,17 @@ int main(int argc, char *argv[]){
         num_reads = entry_cnt;
     }
 
-    /* Free stuff */
-    free(line);
-
-    /* Print some stats */
-    size_t readlen;
-    //float *GCconts;
-    //GCconts = malloc(num_reads * sizeof(float));
-
-    double avg_GC = 0;
-    double GCcont_track = 0;
-
-    #pragma omp parallel for    \
-     reduction(+:avg_GC)
-    for(size_t i = 0; i<num_reads; i++){
-
-        size_t GCcount = 0;
-
-        readlen = fastqs[i].read_len;
-
-        for(size_t j = 0; j < readlen; j++){
-
-            if(toupper(fastqs[i].seq[j]) == 'G' || toupper(fastqs[i].seq[j]) == 'C'){
-                GCcount = GCcount + 1;
-            }
-
-        }
+    double avg_GC = gc_frac_mean(GC_sum, num_reads);
 
-        //GCconts[i] = (double)GCcount / (double)readlen;
-
-        GCcont_track = ((double)GCcount / (double)readlen)/((double)num_reads);
-
-        avg_GC += GCcont_track;
-
-        //free(fastqs[i].seq);
-        //free(fastqs[i].name);
-        //free(fastqs[i].qualities);
-
-    }
-
-    //free(fastqs);
-
-
-    for(size_t i = 0; i <num_reads; i++){
-
-        //avg_GC = avg_GC + (GCconts[i] / ((double)num_reads));
-        free(fastqs[i].seq);
-        free(fastqs[i].name);
-        free(fastqs[i].qualities);
-
-    }
     free(fastqs);
+    free(off);
+    free(gc);
+    fq_close(reader);
 
 
-    clock_t end_time = clock();
+    double end_time = omp_get_wtime();
 
     printf("Average GC fraction is %.4f\n", avg_GC);
 
-    double run_time = (double)(end_time - start_time)/CLOCKS_PER_SEC;
-    printf("Run time is: %f\n", run_time);
+    printf("Run time is: %.3f s\n", end_time - start_time);
 }
@@ -6,87 +6,414 @@
 #include <stdint.h>
 #include <omp.h>
 #include <time.h>
+#include <unistd.h>
+
+#include "../Seq_Lib/fqreader.h"
+#include "../Seq_Lib/fqcache.h"
+#include "../Seq_Lib/gccount.h"
+#include "../Seq_Lib/fqpair.h"
+#include "../Seq_Lib/readbatch.h"
+#include "../Seq_Lib/nucleotide.h"
+#include "../Seq_Lib/topology.h"
+#include "../Seq_Lib/wsteal.h"
+#include "../Seq_Lib/partial.h"
+#include "../Seq_Lib/qctables.h"
+
+#define BATCH_SIZE 65536 // reads counted per parallel loop
+#define SPLIT_BATCH 256  // records split off at a time when parsing a range
+#define RANGE_BATCH 16384 // reads a range thread buffers before counting
+#define GC_BINS QT_GC_BINS // whole GC percentages 0 to 100
+#define NUM_CODES QT_CODES // nt_code values: A, C, G, T and anything else (N)
+#define PIECE_LEN 16384  // bases per stolen piece of work; longer reads are split
+
+
+// Progress of one thread through its byte range of a mapped file.
+typedef struct{
+    size_t n;     // reads parsed from the range
+    size_t first; // index of this range's first read in the whole file
+    int status;   // 0 when the range parsed cleanly, -1 otherwise
+} range_reads;
+
+
+// Per-read GC histogram and per-cycle base composition. Every thread
+// fills its own (see thread_profile) and they are summed once at the end.
+typedef struct{
+    uint64_t hist[GC_BINS]; // reads by GC percentage, rounded
+    uint64_t *cycle;        // ncycles rows of NUM_CODES base counts
+    size_t ncycles;
+} gc_profile;
+
+
+// A batch being GC counted in pieces: the GC count of each read is built
+// up in gc, from several threads if the read was split
+typedef struct{
+    const read_batch *b;  // reads from a batch, or
+    fq_cache *cache;      // from a read cache, read i at off[i] of it
+    const size_t *off;
+    size_t *gc;
+    gc_profile **prof;
+} gc_job;
+
+
+static void print_usage_and_exit(const char *progname){
+    fprintf(stderr,
+        "Usage: %s [-p MATE2] [-o PREFIX] [-b FILE] [-n] <fastq file> [num_reads] \n"
+        " <fastq file> : path to a .fastq or .fq file (optionally gzipped), or a\n"
+        "                read cache written by fq2cache\n"
+        " [num_reads] : positive integer (how many reads to parse, default all)\n"
+        " -p MATE2 : R2 file of a paired-end run; <fastq file> is then R1\n"
+        " -o PREFIX : also write the per-read GC histogram to PREFIX.gc_hist.tsv\n"
+        "             and the base composition of each cycle to PREFIX.cycles.tsv\n"
+        "             (PREFIX.R1.* and PREFIX.R2.* for paired input)\n"
+        " -b FILE : also save the counts behind every number and table above\n"
+        "           as partial results in FILE, for qcmerge to combine with\n"
+        "           those of other runs\n"
+        " -n : pin each thread to a CPU, spreading threads over NUMA nodes, and\n"
+        "      have every thread parse the batches it counts, so read buffers\n"
+        "      stay on the node that uses them\n",
+        progname);
+
+    exit(EXIT_FAILURE);
+}
 
+static uint64_t GC_sum_batch(const read_batch *b, size_t n, gc_profile **prof);
+static uint64_t scan_range(fq_reader *reader, const char *buf, size_t size, size_t start,
+                         size_t stop, size_t max_reads, range_reads *out, read_batch *batch,
+                         gc_profile **prof);
+static int first_failure(range_reads *parts, int nt, size_t num_reads);
+static int stream_local(fq_reader *reader, fq_pair *pair, size_t num_reads, size_t *entry_cnt,
+                        uint64_t *GC_sum, uint64_t *GC_sum2, gc_profile **prof, gc_profile **prof2,
+                        const char *path, const char *mate2_path);
+static uint64_t GC_sum_job(gc_job *job, size_t n);
+static void count_part(void *ctx, size_t read, size_t from, size_t to, int whole);
+static gc_profile **profiles_new(void);
+static gc_profile *thread_profile(gc_profile **prof);
+static void profile_read(gc_profile **prof, const char *seq, size_t readlen, size_t GCcount);
+static void profile_cycles(gc_profile **prof, const char *seq, size_t first, size_t len);
+static void profile_hist(gc_profile **prof, size_t readlen, size_t GCcount);
+static void profile_reset(gc_profile **prof);
+static int profiles_total(gc_profile **prof, gc_profile *total);
+static int profiles_write(const gc_profile *total, const char *prefix, const char *mate);
+static int partial_add(partial *pt, const char *mate, const gc_profile *total, size_t reads,
+                       uint64_t GC_sum);
+static void profiles_free(gc_profile **prof);
 
 int main(int argc, char *argv[]){
 
     double start_time = omp_get_wtime();
 
+    const char *mate2_path = NULL;
+    const char *profile_prefix = NULL;
+    const char *partial_path = NULL;
+    int numa = 0;
+
+    int c;
+    while((c = getopt(argc, argv, "p:o:b:n")) != -1){
+        switch(c) {
+            case 'p': mate2_path = optarg; break;
+            case 'o': profile_prefix = optarg; break;
+            case 'b': partial_path = optarg; break;
+            case 'n': numa = 1; break;
+            default : print_usage_and_exit(argv[0]);
+        }
+    }
+
     /* Make sure correct number of arguments */
-    if (argc != 3){
-        fprintf(stderr,
-        "Usage: %s <fastq file> <num_reads> \n"
-        " <fastq file> : path to a .fastq or .fq file\n"
-        " <num_reads> : positive integer (how many reads to parse)\n",
-        argv[0]
-        );
-        return EXIT_FAILURE;
+    if (argc - optind != 1 && argc - optind != 2){
+        print_usage_and_exit(argv[0]);
     }
 
-    /* Open file */
+    // OpenMP keeps the same threads from one parallel region to the next,
+    // so pinning them once holds for every loop below
+    if(numa){
+        #pragma omp parallel
+        {
+            topo_pin_worker(omp_get_thread_num(), omp_get_num_threads(), 0);
+        }
+    }
 
-    const char *path = argv[1];
+    /* Open file(s) */
 
-    FILE *file = fopen(path, "r");
+    const char *path = argv[optind];
 
-    if (!file){
-        perror("fopen");
-        fprintf(stderr, "x Failed to open '%s'\n", path);
+    fq_reader *reader = NULL;
+    fq_pair *pair = NULL;
+
+    if(mate2_path){
+        pair = fq_pair_open(path, mate2_path);
+    }else{
+        reader = fq_open(path);
+    }
+
+    if (!reader && !pair){
+        perror("fq_open");
+        fprintf(stderr, "x Failed to open '%s'\n", mate2_path ? mate2_path : path);
         return EXIT_FAILURE;
     }
 
 
     /* How many reads to read? */
 
-    char *endptr = NULL;
-    unsigned long long tmp = strtoull(argv[2], &endptr, 10);
+    // Reads are streamed in fixed-size batches either way, so leaving the
+    // count out simply means the whole file
+    size_t num_reads = SIZE_MAX;
+    int limited = argc - optind == 2;
 
-    errno = 0;
+    if(limited){
 
-    if (errno == ERANGE ||           /* out of range for unsigned long long */
-        *endptr != '\0' ||           /* trailing junk like "123abc"         */
-        tmp == 0) {                  /* 0 is not a sensible read count      */
-        fprintf(stderr,
-                "Error: <num_reads> must be a positive integer between 1 and %zu\n",
-                SIZE_MAX);
-        return EXIT_FAILURE;
-    }
+        char *endptr = NULL;
+        errno = 0;
+        unsigned long long tmp = strtoull(argv[optind + 1], &endptr, 10);
 
+        if (errno == ERANGE ||           /* out of range for unsigned long long */
+            *endptr != '\0' ||           /* trailing junk like "123abc"         */
+            tmp == 0) {                  /* 0 is not a sensible read count      */
+            fprintf(stderr,
+                    "Error: <num_reads> must be a positive integer between 1 and %zu\n",
+                    SIZE_MAX);
+            return EXIT_FAILURE;
+        }
 
-    size_t num_reads = (size_t)tmp;
+        num_reads = (size_t)tmp;
 
-    /* Parse fastq entries */
+    }
 
-    char *line = NULL;
-    size_t n = 0;
-    size_t lineno = 0;
     size_t entry_cnt = 0;
 
-    double avg_GC = 0.0;
-    size_t GCcount = 0;
-    size_t readlen;
+    // Sums of per-read GC fractions in gc_frac units, which add up the
+    // same whatever the order
+    uint64_t GC_sum = 0;
+    uint64_t GC_sum2 = 0; // mate 2 of paired input
+
+    // Thread-local profiles, one set per mate, or NULL when not asked for
+    gc_profile **prof = NULL;
+    gc_profile **prof2 = NULL;
+
+    if(profile_prefix || partial_path){
+        prof = profiles_new();
+        prof2 = pair ? profiles_new() : NULL;
+        if(!prof || (pair && !prof2)){
+            fprintf(stderr, "out of memory\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    size_t map_len = 0;
+    const char *map = reader ? fq_mapped(reader, &map_len) : NULL;
+
+    // Per-cycle composition needs the bases themselves, so a cache is
+    // then read through fq_next like any other input
+    fq_cache *cache = reader && !prof ? fq_cached(reader) : NULL;
+
+    if(numa && (pair || (!cache && !map))){
+
+        /* Every thread parses the batches it counts (-n) */
+
+        // Streams can only be parsed in order, so threads take turns
+        // parsing and count while the others parse. Each batch is filled
+        // by the thread that counts it, so its pages are on that thread's
+        // node. Mapped files and caches are split by position already.
+        if(stream_local(reader, pair, num_reads, &entry_cnt, &GC_sum, &GC_sum2,
+                        prof, prof2, path, mate2_path) != 0){
+            return EXIT_FAILURE;
+        }
+
+    }else if(pair){
+
+        /* GC count paired batches, both mates in the same pass */
+
+        read_batch batch1, batch2;
+        rb_init(&batch1);
+        rb_init(&batch2);
+
+        int status = 1;
+
+        while(entry_cnt < num_reads && status == 1){
+
+            size_t want = num_reads - entry_cnt;
+            size_t batch_n = rb_fill_pair(&batch1, &batch2, pair,
+                                          want < BATCH_SIZE ? want : BATCH_SIZE, &status);
+
+            if(status == -2){
+                fprintf(stderr, "out of memory\n");
+                return EXIT_FAILURE;
+            }
+
+            if(status == -1 || status == FQ_PAIR_MISMATCH || status == FQ_PAIR_UNEVEN){
+                fprintf(stderr, "x %s after read %zu of '%s' and '%s'\n",
+                        status == -1 ? "Malformed FASTQ record" :
+                        status == FQ_PAIR_MISMATCH ? "Mate names differ" : "One mate file ended early",
+                        entry_cnt + batch_n, path, mate2_path);
+                return EXIT_FAILURE;
+            }
+
+            GC_sum += GC_sum_batch(&batch1, batch_n, prof);
+            GC_sum2 += GC_sum_batch(&batch2, batch_n, prof2);
+
+            entry_cnt += batch_n;
+
+        }
+
+        rb_free(&batch1);
+        rb_free(&batch2);
+
+    }else if(cache){
+
+        /* GC count straight from the packed bases of a read cache */
+
+        // The record index gives every read's position, so each batch is
+        // shared out between threads directly and nothing is unpacked
+
+        size_t total = fqc_count(cache) < num_reads ? fqc_count(cache) : num_reads;
+        size_t *off = malloc((BATCH_SIZE + 1) * sizeof(size_t));
+
+        if(!off){
+            fprintf(stderr, "out of memory\n");
+            return EXIT_FAILURE;
+        }
+
+        while(entry_cnt < total){
+
+            size_t batch_end = total - entry_cnt < BATCH_SIZE ? total : entry_cnt + BATCH_SIZE;
+            size_t batch_n = batch_end - entry_cnt;
+
+            // Reads are packed back to back, so their starts are offsets
+            // into one run of bases just like a read_batch's
+            fqc_read rd;
+            for(size_t i = 0; i < batch_n; i++){
+                fqc_get(cache, entry_cnt + i, &rd);
+                off[i] = rd.start;
+            }
+            off[batch_n] = rd.start + rd.len;
+
+            gc_job job = {NULL, cache, off, NULL, NULL};
+            GC_sum += GC_sum_job(&job, batch_n);
+
+            entry_cnt = batch_end;
+            fqc_drop(cache, entry_cnt);
+
+        }
+
+        free(off);
+
+    }else if(map){
+
+        /* Parse byte ranges of the mapped file in parallel */
+
+        // Every thread resyncs to the first record in its range and streams
+        // through it in fixed-size batches, dropping mapped pages behind it,
+        // so memory stays flat however big the file.
+
+        int max_threads = omp_get_max_threads();
+        range_reads *parts = calloc(max_threads, sizeof *parts);
+        int used_threads = 0;
+        int failed = -1;
+
+        if(!parts){
+            fprintf(stderr, "out of memory\n");
+            return EXIT_FAILURE;
+        }
+
+        #pragma omp parallel reduction(+:GC_sum)
+        {
+            int t = omp_get_thread_num();
+            int nt = omp_get_num_threads();
+
+            size_t start = fq_sync(map, map_len, map_len / nt * t);
+            size_t stop = t == nt - 1 ? map_len : fq_sync(map, map_len, map_len / nt * (t + 1));
+
+            read_batch batch;
+            rb_init(&batch);
+
+            // With a read limit every range is counted as if it came first,
+            // up to num_reads reads. Once each knows where its reads fall in
+            // the file, ranges wholly within the limit keep their counts,
+            // those past it throw theirs away, and only the one the limit
+            // falls in counts its share again.
+            uint64_t range_sum = scan_range(reader, map, map_len, start, stop,
+                                            limited ? num_reads : SIZE_MAX, &parts[t], &batch, prof);
+
+            #pragma omp barrier
+
+            #pragma omp single
+            {
+                used_threads = nt;
+                if(limited){
+                    failed = first_failure(parts, nt, num_reads);
+                }
+            }
+
+            if(limited && failed == -1 && parts[t].first + parts[t].n > num_reads){
+
+                range_sum = 0;
+
+                if(prof){
+                    profile_reset(prof);
+                }
+
+                if(parts[t].first < num_reads){
+                    range_sum = scan_range(reader, map, map_len, start, stop,
+                                           num_reads - parts[t].first, &parts[t], &batch, prof);
+                }else{
+                    parts[t].n = 0;
+                }
+
+            }
+
+            GC_sum += range_sum;
+            rb_free(&batch);
+        }
+
+        if(!limited){
+            failed = first_failure(parts, used_threads, num_reads);
+        }
 
-    char **seq = malloc(num_reads * sizeof *seq);
-    size_t *len = malloc(num_reads * sizeof *len);
+        if(failed != -1){
+            fprintf(stderr, "x Malformed FASTQ record after read %zu in '%s'\n",
+                    parts[failed].first + parts[failed].n, path);
+            return EXIT_FAILURE;
+        }
+
+        for(int i = 0; i < used_threads; i++){
+            entry_cnt += parts[i].n;
+        }
+        free(parts);
 
-    ssize_t l;
+    }else{
 
-    for(size_t i = 0; i < num_reads; i++){
+        /* Parse and GC count in batches */
 
-        getline(&line, &n, file); // Read name
+        // Each batch is counted while the reader (for gzip input) inflates
+        // the next stretch of the file on its own thread.
 
-        l = getline(&line, &n, file); // Sequence
+        read_batch batch;
+        rb_init(&batch);
 
-        line[strcspn(line, "\r\n")] = '\0';
+        int status = 1;
 
-        seq[i] = strdup(line);
-        len[i] = l - 1;
+        while(entry_cnt < num_reads && status == 1){
 
-        entry_cnt++;
-        lineno++;
+            size_t want = num_reads - entry_cnt;
+            size_t batch_n = rb_fill(&batch, reader, want < BATCH_SIZE ? want : BATCH_SIZE, &status);
+
+            if(status == -2){
+                fprintf(stderr, "out of memory\n");
+                return EXIT_FAILURE;
+            }
+
+            if(status == -1){
+                fprintf(stderr, "x Malformed FASTQ record after read %zu in '%s'\n",
+                        entry_cnt + batch_n, path);
+                return EXIT_FAILURE;
+            }
 
-        getline(&line, &n, file); // '+'
-        getline(&line, &n, file); // Qualities
+            GC_sum += GC_sum_batch(&batch, batch_n, prof);
+
+            entry_cnt += batch_n;
+
+        }
+
+        rb_free(&batch);
 
     }
 
@@ -95,27 +422,534 @@ int main(int argc, char *argv[]){
         num_reads = entry_cnt;
     }
 
-    /* GC counting */
-    #pragma omp parallel for reduction(+:avg_GC)
-    for(size_t i = 0; i < num_reads; i++){
+    double avg_GC = gc_frac_mean(GC_sum, num_reads);
+
+    fq_close(reader);
+    fq_pair_close(pair);
+
+    if(prof){
+
+        gc_profile total, total2;
+        memset(&total2, 0, sizeof total2);
+
+        if(profiles_total(prof, &total) != 0 || (pair && profiles_total(prof2, &total2) != 0)){
+            fprintf(stderr, "out of memory\n");
+            return EXIT_FAILURE;
+        }
+
+        if(profile_prefix &&
+           (profiles_write(&total, profile_prefix, pair ? "R1." : "") != 0 ||
+            (pair && profiles_write(&total2, profile_prefix, "R2.") != 0))){
+            return EXIT_FAILURE;
+        }
 
-        GCcount = 0;
-        readlen = len[i];
-        for(size_t j = 0; j < readlen; j++){
+        if(partial_path){
 
-            if(seq[i][j] == 'G' || seq[i][j] == 'C' || seq[i][j] == 'g' || seq[i][j] == 'c'){
-                GCcount++;
+            partial *pt = pt_new();
+
+            if(!pt || partial_add(pt, pair ? "R1." : "", &total, num_reads, GC_sum) != 0 ||
+               (pair && partial_add(pt, "R2.", &total2, num_reads, GC_sum2) != 0)){
+                fprintf(stderr, "out of memory\n");
+                return EXIT_FAILURE;
             }
 
+            if(pt_write(pt, partial_path) != 0){
+                perror("pt_write");
+                fprintf(stderr, "x Failed to write '%s'\n", partial_path);
+                return EXIT_FAILURE;
+            }
+
+            pt_free(pt);
+
         }
 
-        avg_GC += ((double)GCcount / (double)readlen)/((double)num_reads);
+        free(total.cycle);
+        free(total2.cycle);
+        profiles_free(prof);
+        profiles_free(prof2);
 
     }
 
     double end_time = omp_get_wtime();
 
-    printf("Average GC fraction is %.4f\n", avg_GC);
+    if(pair){
+        printf("R1 average GC fraction is %.4f\n", avg_GC);
+        printf("R2 average GC fraction is %.4f\n", gc_frac_mean(GC_sum2, num_reads));
+    }else{
+        printf("Average GC fraction is %.4f\n", avg_GC);
+    }
 
     printf("Run time is: %.3f s\n", end_time - start_time);
 }
+
+
+/* Sum of per-read GC fractions (see gc_frac) over the first n reads of
+b, adding each read to the calling thread's profile when prof is given */
+static uint64_t GC_sum_batch(const read_batch *b, size_t n, gc_profile **prof){
+
+    // Already on one of several threads each counting its own batch
+    if(omp_in_parallel()){
+
+        uint64_t GC_sum = 0;
+
+        for(size_t i = 0; i < n; i++){
+
+            // Reads are back to back in b->seq, so this walks memory linearly
+            size_t readlen = rb_len(b, i);
+            size_t GCcount = gc_count(b->seq + b->off[i], readlen);
+
+            if(prof){
+                profile_read(prof, b->seq + b->off[i], readlen, GCcount);
+            }
+
+            GC_sum += gc_frac(GCcount, readlen);
+
+        }
+
+        return GC_sum;
+    }
+
+    gc_job job = {b, NULL, b->off, NULL, prof};
+    return GC_sum_job(&job, n);
+
+}
+
+/*
+Sum of per-read GC fractions over the first n reads of a job. Threads
+steal PIECE_LEN base pieces of the reads rather than whole reads, so a
+few very long reads are shared out like many short ones; the fractions
+are then summed in read order.
+*/
+static uint64_t GC_sum_job(gc_job *job, size_t n){
+
+    uint64_t GC_sum = 0;
+
+    job->gc = calloc(n ? n : 1, sizeof(size_t));
+
+    if(!job->gc){
+        fprintf(stderr, "out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    ws_for_bases(job->off, n, PIECE_LEN, count_part, job);
+
+    for(size_t i = 0; i < n; i++){
+
+        size_t readlen = job->off[i + 1] - job->off[i];
+
+        if(job->prof){
+            profile_hist(job->prof, readlen, job->gc[i]);
+        }
+
+        GC_sum += gc_frac(job->gc[i], readlen);
+
+    }
+
+    free(job->gc);
+    job->gc = NULL;
+
+    return GC_sum;
+
+}
+
+/* GC count bases [from, to) of a job's read, and their cycles */
+static void count_part(void *ctx, size_t read, size_t from, size_t to, int whole){
+
+    gc_job *job = ctx;
+    size_t GCcount;
+
+    if(job->cache){
+        GCcount = fqc_gc(job->cache, job->off[read] + from, to - from);
+    }else{
+        const char *seq = job->b->seq + job->off[read] + from;
+        GCcount = gc_count(seq, to - from);
+        if(job->prof){
+            profile_cycles(job->prof, seq, from, to - from);
+        }
+    }
+
+    // Other threads may be counting other parts of a split read
+    if(whole){
+        job->gc[read] = GCcount;
+    }else{
+        __atomic_fetch_add(&job->gc[read], GCcount, __ATOMIC_RELAXED);
+    }
+
+}
+
+/*
+Parse reads starting in buf[start, stop), at most max_reads of them,
+copying them into batch and GC counting it every RANGE_BATCH reads, and
+return their summed GC fractions. out->n and out->status record how it
+went.
+*/
+static uint64_t scan_range(fq_reader *reader, const char *buf, size_t size, size_t start,
+                         size_t stop, size_t max_reads, range_reads *out, read_batch *batch,
+                         gc_profile **prof){
+
+    const char *p = buf + start;
+    const char *range_end = buf + stop;
+    const char *end = buf + size;
+    fq_record recs[SPLIT_BATCH];
+    uint64_t GC_sum = 0;
+    size_t dropped = start;
+
+    out->n = 0;
+    out->status = 0;
+
+    // A record belongs to the range its header starts in, so it may
+    // run past range_end.
+    while(p < range_end && out->n < max_reads){
+
+        size_t nrecs, used;
+        int status = fq_split(p, (size_t)(end - p), 1, recs, SPLIT_BATCH, &nrecs, &used);
+
+        size_t i = 0;
+        for(; i < nrecs && recs[i].name - 1 < range_end && out->n < max_reads; i++){
+
+            if(!rb_push(batch, &recs[i])){
+                fprintf(stderr, "out of memory\n");
+                exit(EXIT_FAILURE);
+            }
+
+            if(batch->n == RANGE_BATCH){
+                GC_sum += GC_sum_batch(batch, batch->n, prof);
+                rb_clear(batch);
+            }
+
+            out->n++;
+
+        }
+
+        // Remaining records start in the next range
+        if(i < nrecs){
+            break;
+        }
+
+        p += used;
+
+        // Everything parsed so far was counted or copied
+        fq_drop(reader, dropped, (size_t)(p - buf));
+        dropped = (size_t)(p - buf);
+
+        // Bad input past range_end is the next range's to report
+        if(status == -1){
+            if(p < range_end){
+                out->status = -1;
+            }
+            break;
+        }
+
+        if(nrecs == 0){
+            break;
+        }
+
+    }
+
+    if(batch->n > 0){
+        GC_sum += GC_sum_batch(batch, batch->n, prof);
+        rb_clear(batch);
+    }
+
+    return GC_sum;
+
+}
+
+/*
+Parse batches of RANGE_BATCH reads (pairs with a pair reader), each into
+the parsing thread's own buffers, and GC count each batch on the thread
+that parsed it. Return 0, or -1 after reporting bad input.
+*/
+static int stream_local(fq_reader *reader, fq_pair *pair, size_t num_reads, size_t *entry_cnt,
+                        uint64_t *GC_sum, uint64_t *GC_sum2, gc_profile **prof, gc_profile **prof2,
+                        const char *path, const char *mate2_path){
+
+    int status = 1;
+    size_t parsed = 0;
+    uint64_t sum = 0;
+    uint64_t sum2 = 0;
+
+    #pragma omp parallel reduction(+:sum, sum2)
+    {
+        read_batch batch1, batch2;
+        rb_init(&batch1);
+        rb_init(&batch2);
+
+        for(;;){
+
+            size_t batch_n = 0;
+            int more;
+            int batch_status = 1;
+
+            #pragma omp critical(stream_local)
+            {
+                more = status == 1 && parsed < num_reads;
+                if(more){
+                    size_t want = num_reads - parsed < RANGE_BATCH ? num_reads - parsed : RANGE_BATCH;
+                    batch_n = pair ? rb_fill_pair(&batch1, &batch2, pair, want, &status)
+                                   : rb_fill(&batch1, reader, want, &status);
+                    parsed += batch_n;
+                    batch_status = status;
+                }
+            }
+
+            // A batch that hit bad input is not counted; the run fails
+            if(!more || batch_status < 0){
+                break;
+            }
+
+            sum += GC_sum_batch(&batch1, batch_n, prof);
+            if(pair){
+                sum2 += GC_sum_batch(&batch2, batch_n, prof2);
+            }
+
+        }
+
+        rb_free(&batch1);
+        rb_free(&batch2);
+    }
+
+    if(status == -2){
+        fprintf(stderr, "out of memory\n");
+        return -1;
+    }
+
+    if(status < 0 && pair){
+        fprintf(stderr, "x %s after read %zu of '%s' and '%s'\n",
+                status == -1 ? "Malformed FASTQ record" :
+                status == FQ_PAIR_MISMATCH ? "Mate names differ" : "One mate file ended early",
+                parsed, path, mate2_path);
+        return -1;
+    }
+
+    if(status == -1){
+        fprintf(stderr, "x Malformed FASTQ record after read %zu in '%s'\n", parsed, path);
+        return -1;
+    }
+
+    *entry_cnt = parsed;
+    *GC_sum += sum;
+    *GC_sum2 += sum2;
+
+    return 0;
+
+}
+
+/*
+Set each range's global index of its first read, in file order, and
+return the first range with a bad record that the serial parse would
+have reached within num_reads reads, or -1 if there is none.
+*/
+static int first_failure(range_reads *parts, int nt, size_t num_reads){
+
+    int failed = -1;
+    size_t first = 0;
+
+    for(int i = 0; i < nt; i++){
+        parts[i].first = first;
+        first += parts[i].n;
+        if(parts[i].status == -1 && failed == -1 && first < num_reads){
+            failed = i;
+        }
+    }
+
+    return failed;
+
+}
+
+/* One slot per thread that may run, each filled in by its own thread */
+static gc_profile **profiles_new(void){
+    return calloc(omp_get_max_threads(), sizeof(gc_profile *));
+
+}
+
+/*
+The calling thread's profile, allocated on first use so it lands in
+memory near that thread. Only the owning thread ever writes to it, so no
+counter is shared.
+*/
+static gc_profile *thread_profile(gc_profile **prof){
+
+    gc_profile *gp = prof[omp_get_thread_num()];
+
+    if(!gp){
+        gp = calloc(1, sizeof(gc_profile));
+        if(!gp){
+            fprintf(stderr, "out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+        prof[omp_get_thread_num()] = gp;
+    }
+
+    return gp;
+
+}
+
+/* Add a read to the calling thread's profile */
+static void profile_read(gc_profile **prof, const char *seq, size_t readlen, size_t GCcount){
+
+    profile_hist(prof, readlen, GCcount);
+    profile_cycles(prof, seq, 0, readlen);
+
+}
+
+/* Add the bases of cycles [first, first + len) of a read to the calling
+thread's profile, growing its cycle rows on first need */
+static void profile_cycles(gc_profile **prof, const char *seq, size_t first, size_t len){
+
+    gc_profile *gp = thread_profile(prof);
+    size_t last = first + len;
+
+    if(last > gp->ncycles){
+        uint64_t *grown = realloc(gp->cycle, last * NUM_CODES * sizeof(uint64_t));
+        if(!grown){
+            fprintf(stderr, "out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+        memset(grown + gp->ncycles * NUM_CODES, 0,
+               (last - gp->ncycles) * NUM_CODES * sizeof(uint64_t));
+        gp->cycle = grown;
+        gp->ncycles = last;
+    }
+
+    uint64_t *row = gp->cycle + first * NUM_CODES;
+
+    for(size_t j = 0; j < len; j++, row += NUM_CODES){
+        row[nt_code[(unsigned char)seq[j]]]++;
+    }
+
+}
+
+/* Add a read's GC percentage to the calling thread's histogram */
+static void profile_hist(gc_profile **prof, size_t readlen, size_t GCcount){
+
+    gc_profile *gp = thread_profile(prof);
+
+    if(readlen == 0){
+        return;
+    }
+
+    // Round to the nearest whole percentage, halves up
+    gp->hist[(200 * GCcount + readlen) / (2 * readlen)]++;
+
+}
+
+/* Empty the calling thread's profile; its cycle rows go too, since reads
+that are thrown away must not lengthen the cycles table */
+static void profile_reset(gc_profile **prof){
+
+    gc_profile *gp = thread_profile(prof);
+
+    memset(gp->hist, 0, sizeof gp->hist);
+    free(gp->cycle);
+    gp->cycle = NULL;
+    gp->ncycles = 0;
+
+}
+
+/* Sum the threads' profiles into total, allocating its cycle rows.
+Return 0, or -1 if out of memory */
+static int profiles_total(gc_profile **prof, gc_profile *total){
+
+    int nt = omp_get_max_threads();
+
+    memset(total, 0, sizeof *total);
+
+    for(int t = 0; t < nt; t++){
+        if(prof[t] && prof[t]->ncycles > total->ncycles){
+            total->ncycles = prof[t]->ncycles;
+        }
+    }
+
+    total->cycle = calloc(total->ncycles * NUM_CODES + 1, sizeof(uint64_t));
+
+    if(!total->cycle){
+        return -1;
+    }
+
+    for(int t = 0; t < nt; t++){
+
+        if(!prof[t]){
+            continue;
+        }
+
+        for(size_t b = 0; b < GC_BINS; b++){
+            total->hist[b] += prof[t]->hist[b];
+        }
+
+        for(size_t k = 0; k < prof[t]->ncycles * NUM_CODES; k++){
+            total->cycle[k] += prof[t]->cycle[k];
+        }
+
+    }
+
+    return 0;
+
+}
+
+/* Write PREFIX.<mate>gc_hist.tsv and PREFIX.<mate>cycles.tsv. Return 0,
+or -1 after reporting a failure */
+static int profiles_write(const gc_profile *total, const char *prefix, const char *mate){
+
+    FILE *fp = qt_open(prefix, mate, "gc_hist.tsv");
+
+    if(!fp){
+        return -1;
+    }
+
+    qt_gc_hist(fp, total->hist);
+
+    if(qt_close(fp, prefix, mate, "gc_hist.tsv") != 0){
+        return -1;
+    }
+
+    fp = qt_open(prefix, mate, "cycles.tsv");
+
+    if(!fp){
+        return -1;
+    }
+
+    qt_gc_cycles(fp, total->cycle, total->ncycles);
+
+    return qt_close(fp, prefix, mate, "cycles.tsv");
+
+}
+
+/* Add a mate's read count, GC sum and summed profile to partial results,
+as sections named <mate>reads and so on. Return 0, or -1 if out of
+memory */
+static int partial_add(partial *pt, const char *mate, const gc_profile *total, size_t reads,
+                       uint64_t GC_sum){
+
+    char name[PT_NAME_MAX + 1];
+    int failed = 0;
+
+    snprintf(name, sizeof name, "%sreads", mate);
+    failed |= pt_add1(pt, name, reads);
+    snprintf(name, sizeof name, "%sgc_sum", mate);
+    failed |= pt_add1(pt, name, GC_sum);
+    snprintf(name, sizeof name, "%sgc_hist", mate);
+    failed |= pt_add(pt, name, total->hist, GC_BINS);
+    snprintf(name, sizeof name, "%sgc_cycles", mate);
+    failed |= pt_add(pt, name, total->cycle, total->ncycles * NUM_CODES);
+
+    return failed ? -1 : 0;
+
+}
+
+static void profiles_free(gc_profile **prof){
+
+    if(!prof){
+        return;
+    }
+
+    for(int t = 0; t < omp_get_max_threads(); t++){
+        if(prof[t]){
+            free(prof[t]->cycle);
+            free(prof[t]);
+        }
+    }
+
+    free(prof);
+
+}
@@ -0,0 +1,595 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <omp.h>
+#include <unistd.h>
+
+#include "../Seq_Lib/fqreader.h"
+#include "../Seq_Lib/fqpair.h"
+#include "../Seq_Lib/readbatch.h"
+#include "../Seq_Lib/phred.h"
+#include "../Seq_Lib/trim.h"
+#include "../Seq_Lib/fqwriter.h"
+#include "stage.h"
+
+#define BATCH_SIZE 65536 // reads parsed at a time and shared out between threads
+#define DEFAULT_K 21
+#define DEFAULT_STAGES "gc,qual"
+#define MAX_SCORE 93 // highest score printable with offset 33
+
+
+// Every stage the driver knows, in the order they report
+static const qc_stage *STAGES[] = {&gc_stage, &qual_stage, &kmer_stage};
+#define NUM_STAGES (sizeof STAGES / sizeof STAGES[0])
+
+
+static void print_usage_and_exit(const char *progname){
+    fprintf(stderr,
+        "Usage: %s [-s STAGES] [-k K] [-o PREFIX] [-P OFFSET] [-p MATE2] [-T OUT]\n"
+        "          [-W WINDOW:Q] [-L Q] [-R Q] [-M LEN] <fastq file> [num_reads] \n"
+        " <fastq file> : path to a .fastq or .fq file (optionally gzipped), or a\n"
+        "                read cache written by fq2cache\n"
+        " [num_reads] : positive integer (how many reads to parse, default all)\n"
+        " -s STAGES : comma-separated analyses to run (default %s):\n"
+        "             gc   : average GC fraction; with -o, PREFIX.gc_hist.tsv and\n"
+        "                    PREFIX.cycles.tsv as written by multiGC_optim\n"
+        "             qual : mean base quality\n"
+        "             kmer : number of distinct k-mers; with -o, PREFIX.kmers.txt\n"
+        "                    holds the counts as printed by kmers_fastq\n"
+        "             none : no analysis, only trimming\n"
+        " -k K : k-mer length for the kmer stage (default %d)\n"
+        " -o PREFIX : write each stage's tables to PREFIX.*\n"
+        " -P OFFSET : quality encoding, 33, 64 or auto (default auto: guessed\n"
+        "             from the first %d reads)\n"
+        " -p MATE2 : R2 file of a paired-end run; <fastq file> is then R1 and\n"
+        "            each mate gets its own stats, and tables PREFIX.R1.* and\n"
+        "            PREFIX.R2.*, from the same pass (no trimming)\n"
+        "Trimming (any of these turns it on; the stages then see trimmed reads):\n"
+        " -T OUT : write the trimmed reads to OUT as FASTQ (- for standard output,\n"
+        "          which sends the report to standard error)\n"
+        " -W WINDOW:Q : cut at the first WINDOW bases whose mean score is below Q,\n"
+        "               keeping those of them scoring at least Q\n"
+        " -L Q : cut bases scoring below Q from the start of each read\n"
+        " -R Q : cut bases scoring below Q from the end of each read\n"
+        " -M LEN : drop reads shorter than LEN after trimming (default 1; 0 keeps\n"
+        "          reads trimmed to nothing as empty records)\n"
+        "Leading and trailing bases are cut before the window is applied.\n"
+        "The file is read once whatever the stages: each batch of reads is\n"
+        "parsed and trimmed once and every stage runs on it.\n",
+        progname, DEFAULT_STAGES, DEFAULT_K, PHRED_SAMPLE_READS);
+
+    exit(EXIT_FAILURE);
+}
+
+static size_t parse_size(const char *arg, const char *what){
+
+    char *endptr = NULL;
+    errno = 0;
+    unsigned long long tmp = strtoull(arg, &endptr, 10);
+
+    if (errno == ERANGE ||           /* out of range for unsigned long long */
+        *endptr != '\0' ||           /* trailing junk like "123abc"         */
+        tmp == 0) {                  /* 0 is not a sensible size            */
+        fprintf(stderr,
+                "Error: %s must be a positive integer between 1 and %zu\n",
+                what, SIZE_MAX);
+        exit(EXIT_FAILURE);
+    }
+
+    return (size_t)tmp;
+}
+
+/* Phred score between 0 and MAX_SCORE */
+static int parse_score(const char *arg){
+
+    char *endptr = NULL;
+    long q = strtol(arg, &endptr, 10);
+
+    if(endptr == arg || *endptr != '\0' || q < 0 || q > MAX_SCORE){
+        fprintf(stderr, "Error: quality score must be between 0 and %d\n", MAX_SCORE);
+        exit(EXIT_FAILURE);
+    }
+
+    return (int)q;
+}
+
+/* -M LEN, where 0 keeps even reads trimmed away entirely */
+static size_t parse_min_len(const char *arg){
+
+    return strcmp(arg, "0") == 0 ? 0 : parse_size(arg, "LEN");
+}
+
+/* WINDOW:Q for -W */
+static void parse_window(const char *arg, trim_opts *trim){
+
+    char *endptr = NULL;
+    long w = strtol(arg, &endptr, 10);
+
+    if(endptr == arg || *endptr != ':' || w < 1 || w > 1000000){
+        fprintf(stderr, "Error: -W takes WINDOW:Q, WINDOW being a positive number of bases\n");
+        exit(EXIT_FAILURE);
+    }
+
+    trim->window = (int)w;
+    trim->window_qual = parse_score(endptr + 1);
+}
+
+/* Mark the stages named in the comma-separated list ("none" for none) */
+static void parse_stages(const char *list, int *enabled){
+
+    const char *p = list;
+
+    if(strcmp(list, "none") == 0){
+        return;
+    }
+
+    while(*p){
+
+        size_t len = strcspn(p, ",");
+        size_t s = 0;
+
+        while(s < NUM_STAGES && (strlen(STAGES[s]->name) != len || strncmp(STAGES[s]->name, p, len) != 0)){
+            s++;
+        }
+
+        if(s == NUM_STAGES){
+            fprintf(stderr, "Error: unknown stage '%.*s' (choose from gc, qual, kmer or none)\n", (int)len, p);
+            exit(EXIT_FAILURE);
+        }
+
+        enabled[s] = 1;
+        p += len + (p[len] == ',');
+
+    }
+
+}
+
+
+/* Counts kept by fill_trimmed and trim_batch */
+typedef struct {
+    size_t reads_in, reads_kept;
+    size_t bases_in, bases_kept;
+} trim_counts;
+
+/* Trim one read. Trimming only narrows the record's views; what is left
+   is then copied into out's buffer (if any) and, if keep is set, into
+   batch, the same copy rb_fill makes of every read so the stages can walk
+   seq and qual linearly. Reads left shorter than the minimum length are
+   dropped. Returns 0, -2 if out of memory or -3 if writing out failed */
+static int trim_record(fq_record *rec, read_batch *batch, const trim_opts *trim,
+                       fq_writer *out, int keep, trim_counts *counts){
+
+    size_t from, to;
+    counts->reads_in++;
+    counts->bases_in += rec->seq_len;
+
+    if(!trim_read(trim, rec->qual, rec->seq_len, &from, &to)){
+        return 0;
+    }
+
+    rec->seq += from;
+    rec->qual += from;
+    rec->seq_len = rec->qual_len = to - from;
+    counts->reads_kept++;
+    counts->bases_kept += rec->seq_len;
+
+    if(out && fq_wrecord(out, rec) != 0){
+        return -3;
+    }
+
+    if(keep && !rb_push(batch, rec)){
+        return -2;
+    }
+
+    return 0;
+}
+
+/* Like rb_fill, but trims each of the up to max reads taken from reader
+   with trim_record, straight from the reader's buffer. Returns the number
+   of reads taken, which batch->n may fall short of, and sets *status as
+   rb_fill does, or to -3 if writing out failed */
+static size_t fill_trimmed(read_batch *batch, fq_reader *reader, size_t max, const trim_opts *trim,
+                           fq_writer *out, int keep, trim_counts *counts, int *status){
+
+    fq_record rec;
+    size_t taken = 0;
+    int got = 1;
+
+    rb_clear(batch);
+
+    while(taken < max && (got = fq_next(reader, &rec)) == 1){
+
+        taken++;
+        int result = trim_record(&rec, batch, trim, out, keep, counts);
+
+        if(result != 0){
+            got = result;
+            break;
+        }
+
+    }
+
+    fq_recycle(reader);
+
+    *status = got;
+    return taken;
+}
+
+/* Trim every read of raw, a batch filled before the offset was known,
+   into batch with trim_record. Returns 0, -2 or -3 as trim_record does */
+static int trim_batch(read_batch *batch, const read_batch *raw, const trim_opts *trim,
+                      fq_writer *out, int keep, trim_counts *counts){
+
+    rb_clear(batch);
+
+    for(size_t i = 0; i < raw->n; i++){
+
+        fq_record rec = {raw->name + raw->name_off[i], raw->name_off[i + 1] - raw->name_off[i],
+                         raw->seq + raw->off[i], rb_len(raw, i),
+                         raw->qual + raw->off[i], rb_len(raw, i)};
+        int result = trim_record(&rec, batch, trim, out, keep, counts);
+
+        if(result != 0){
+            return result;
+        }
+
+    }
+
+    return 0;
+}
+
+/* Offset guessed from the first PHRED_SAMPLE_READS reads of each of the
+   n batches, as phred_detect would from the start of the files */
+static int batch_offset(const read_batch *b, int n){
+
+    int min = 256, max = -1;
+
+    for(int m = 0; m < n; m++){
+
+        size_t reads = b[m].n < PHRED_SAMPLE_READS ? b[m].n : PHRED_SAMPLE_READS;
+
+        if(reads > 0){
+            phred_range(b[m].qual, b[m].off[reads], &min, &max);
+        }
+
+    }
+
+    return phred_guess(min, max);
+}
+
+
+int main(int argc, char *argv[]){
+
+    double start_time = omp_get_wtime();
+
+    qc_options opt = {DEFAULT_K, NULL, 0, ""};
+    const char *stage_list = DEFAULT_STAGES;
+    const char *mate2_path = NULL;
+
+    trim_opts trim;
+    trim_defaults(&trim, 0);
+    trim.min_len = 1;
+    const char *trim_path = NULL;
+    int trimming = 0;
+
+    int c;
+    while((c = getopt(argc, argv, "s:k:o:P:p:T:W:L:R:M:")) != -1){
+        switch(c) {
+            case 's': stage_list = optarg; break;
+            case 'k': opt.k = parse_size(optarg, "K"); break;
+            case 'o': opt.prefix = optarg; break;
+            case 'P':
+                if((opt.phred = phred_parse(optarg)) < 0){
+                    print_usage_and_exit(argv[0]);
+                }
+                break;
+            case 'p': mate2_path = optarg; break;
+            case 'T': trim_path = optarg; trimming = 1; break;
+            case 'W': parse_window(optarg, &trim); trimming = 1; break;
+            case 'L': trim.leading = parse_score(optarg); trimming = 1; break;
+            case 'R': trim.trailing = parse_score(optarg); trimming = 1; break;
+            case 'M': trim.min_len = parse_min_len(optarg); trimming = 1; break;
+            default : print_usage_and_exit(argv[0]);
+        }
+    }
+
+    /* Make sure correct number of arguments */
+    if (argc - optind != 1 && argc - optind != 2){
+        print_usage_and_exit(argv[0]);
+    }
+
+    int enabled[NUM_STAGES] = {0};
+    parse_stages(stage_list, enabled);
+
+    // Only the enabled stages, so the per-read loop never skips any
+    const qc_stage *stages[NUM_STAGES];
+    size_t nstages = 0;
+
+    for(size_t s = 0; s < NUM_STAGES; s++){
+        if(enabled[s]){
+            stages[nstages++] = STAGES[s];
+        }
+    }
+
+    // Nothing to do without a stage or somewhere to put trimmed reads
+    if(nstages == 0 && !trim_path){
+        print_usage_and_exit(argv[0]);
+    }
+
+    if(mate2_path && trimming){
+        fprintf(stderr, "Error: -p cannot be combined with trimming\n");
+        return EXIT_FAILURE;
+    }
+
+    size_t num_reads = SIZE_MAX;
+
+    if(argc - optind == 2){
+        num_reads = parse_size(argv[optind + 1], "<num_reads>");
+    }
+
+    /* Open file */
+
+    const char *path = argv[optind];
+
+    fq_reader *reader = NULL;
+    fq_pair *pair = NULL;
+
+    if(mate2_path){
+
+        // Both mates are read in lockstep and their names checked
+        if(!(pair = fq_pair_open(path, mate2_path))){
+            perror("fq_pair_open");
+            fprintf(stderr, "x Failed to open '%s' and '%s'\n", path, mate2_path);
+            return EXIT_FAILURE;
+        }
+
+    }else if(!(reader = fq_open(path))){
+        perror("fq_open");
+        fprintf(stderr, "x Failed to open '%s'\n", path);
+        return EXIT_FAILURE;
+    }
+
+    trim.phred = opt.phred;
+
+    // Each mate has its own states, which write their own tables
+    int nmates = pair ? 2 : 1;
+    const char *mate_paths[2] = {path, mate2_path};
+    qc_options opts[2] = {opt, opt};
+    opts[0].mate = pair ? "R1." : "";
+    opts[1].mate = "R2.";
+
+    fq_writer *trimmed = NULL;
+
+    if(trim_path && !(trimmed = fq_wopen(trim_path))){
+        perror("fq_wopen");
+        fprintf(stderr, "x Failed to write '%s'\n", trim_path);
+        return EXIT_FAILURE;
+    }
+
+    // Trimmed reads on standard output leave the report to standard error
+    FILE *report = trim_path && strcmp(trim_path, "-") == 0 ? stderr : stdout;
+
+    /* Parse (and trim) each batch once and run every stage on it */
+
+    // states[(t * nmates + m) * nstages + s] belongs to thread t, mate m
+    // and stage s. Threads set up their own on first use, so each state
+    // lands near its thread
+    int max_threads = omp_get_max_threads();
+    size_t per_thread = (size_t)nmates * nstages;
+    void **states = calloc((size_t)max_threads * per_thread, sizeof(void *));
+
+    if(!states && nstages > 0){
+        fprintf(stderr, "out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    read_batch batch[2];
+    rb_init(&batch[0]);
+    rb_init(&batch[1]);
+
+    // With -P auto the first batch is read untrimmed, into raw if it is
+    // to be trimmed, and its qualities decide the offset
+    int detect = opt.phred == 0;
+    read_batch raw;
+    rb_init(&raw);
+
+    size_t entry_cnt = 0;
+    int status = 1;
+    trim_counts counts = {0, 0, 0, 0};
+
+    while(entry_cnt < num_reads && status == 1){
+
+        size_t want = num_reads - entry_cnt;
+        size_t max = want < BATCH_SIZE ? want : BATCH_SIZE;
+        size_t batch_n;
+
+        if(pair){
+            batch_n = rb_fill_pair(&batch[0], &batch[1], pair, max, &status);
+        }else if(trimming && !detect){
+            batch_n = fill_trimmed(&batch[0], reader, max, &trim, trimmed, nstages > 0, &counts, &status);
+        }else{
+            batch_n = rb_fill(trimming ? &raw : &batch[0], reader, max, &status);
+        }
+
+        // The offset is known before anything is trimmed or counted, and
+        // the input is still read only once
+        if(detect && status >= 0){
+
+            trim.phred = opts[0].phred = opts[1].phred =
+                batch_offset(trimming ? &raw : batch, trimming ? 1 : nmates);
+            detect = 0;
+
+            if(trimming){
+                int result = trim_batch(&batch[0], &raw, &trim, trimmed, nstages > 0, &counts);
+                status = result != 0 ? result : status;
+                rb_free(&raw);
+            }
+
+        }
+
+        // FQ_PAIR_MISMATCH shares -3 with fill_trimmed's write failure
+        if(pair && (status == -1 || status == FQ_PAIR_MISMATCH || status == FQ_PAIR_UNEVEN)){
+            fprintf(stderr, "x %s after read %zu of '%s' and '%s'\n",
+                    status == -1 ? "Malformed FASTQ record" :
+                    status == FQ_PAIR_MISMATCH ? "Mate names differ" : "One mate file ended early",
+                    entry_cnt + batch_n, path, mate2_path);
+            return EXIT_FAILURE;
+        }
+
+        if(status == -3){
+            perror("fq_wrecord");
+            fprintf(stderr, "x Failed to write '%s'\n", trim_path);
+            return EXIT_FAILURE;
+        }
+
+        if(status == -2){
+            fprintf(stderr, "out of memory\n");
+            return EXIT_FAILURE;
+        }
+
+        if(status == -1){
+            fprintf(stderr, "x Malformed FASTQ record after read %zu in '%s'\n",
+                    entry_cnt + batch_n, path);
+            return EXIT_FAILURE;
+        }
+
+        // Nothing for the stages to see: the input is empty, trimming
+        // dropped every read of the batch, or only trimming was asked for
+        if(batch[0].n == 0 || nstages == 0){
+            entry_cnt += batch_n;
+            continue;
+        }
+
+        int failure = 0;
+        size_t failed_stage = 0;
+        int failed_mate = 0;
+
+        // Each thread takes an even slice of the batch (the same slice of
+        // both mates) through all stages
+        #pragma omp parallel
+        {
+            int t = omp_get_thread_num();
+            int nt = omp_get_num_threads();
+            size_t from = batch[0].n * t / nt;
+            size_t to = batch[0].n * (t + 1) / nt;
+            int result = 0;
+
+            for(int m = 0; m < nmates && result == 0; m++){
+
+                void **mine = states + ((size_t)t * nmates + m) * nstages;
+
+                for(size_t s = 0; s < nstages; s++){
+
+                    if(!mine[s]){
+                        mine[s] = stages[s]->init(&opts[m]);
+                    }
+
+                    result = mine[s] ? stages[s]->process(mine[s], &batch[m], from, to) : QC_NOMEM;
+
+                    if(result != 0){
+                        #pragma omp critical(qc_failure)
+                        {
+                            if(!failure){
+                                failure = result;
+                                failed_stage = s;
+                                failed_mate = m;
+                            }
+                        }
+                        break;
+                    }
+
+                }
+            }
+        }
+
+        if(failure == QC_NOMEM){
+            fprintf(stderr, "out of memory\n");
+            return EXIT_FAILURE;
+        }
+
+        if(failure == QC_INVALID){
+            fprintf(stderr, "x %s stage: %s (reads %zu to %zu of '%s')\n",
+                    stages[failed_stage]->name, stages[failed_stage]->invalid,
+                    entry_cnt + 1, entry_cnt + batch_n, mate_paths[failed_mate]);
+            return EXIT_FAILURE;
+        }
+
+        entry_cnt += batch_n;
+
+    }
+
+    rb_free(&batch[0]);
+    rb_free(&batch[1]);
+    rb_free(&raw);
+
+    if(pair){
+        fq_pair_close(pair);
+    }else{
+        fq_close(reader);
+    }
+
+    if(trimmed && fq_wclose(trimmed) != 0){
+        perror("fq_wclose");
+        fprintf(stderr, "x Failed to write '%s'\n", trim_path);
+        return EXIT_FAILURE;
+    }
+
+    /* Merge every thread's states into thread 0's and report */
+
+    fprintf(report, pair ? "Read pairs: %zu\n" : "Reads: %zu\n", entry_cnt);
+
+    if(trimming){
+        fprintf(report, "Trimming kept %zu reads (%zu dropped) and %zu of %zu bases\n",
+                counts.reads_kept, counts.reads_in - counts.reads_kept,
+                counts.bases_kept, counts.bases_in);
+    }
+
+    for(int m = 0; m < nmates; m++){
+
+        if(pair){
+            fprintf(report, "%s '%s':\n", m == 0 ? "R1" : "R2", mate_paths[m]);
+        }
+
+        for(size_t s = 0; s < nstages; s++){
+
+            void **total = &states[(size_t)m * nstages + s];
+
+            // Thread 0 has none if the file had no reads
+            if(!*total && !(*total = stages[s]->init(&opts[m]))){
+                fprintf(stderr, "out of memory\n");
+                return EXIT_FAILURE;
+            }
+
+            for(int t = 1; t < max_threads; t++){
+
+                void *other = states[((size_t)t * nmates + m) * nstages + s];
+
+                if(other && stages[s]->merge(*total, other) != 0){
+                    fprintf(stderr, "out of memory\n");
+                    return EXIT_FAILURE;
+                }
+
+                stages[s]->destroy(other);
+
+            }
+
+            if(stages[s]->report(*total, &opts[m], report) != 0){
+                return EXIT_FAILURE;
+            }
+
+            stages[s]->destroy(*total);
+
+        }
+    }
+
+    free(states);
+
+    double end_time = omp_get_wtime();
+
+    fprintf(report, "Run time is: %.3f s\n", end_time - start_time);
+
+    return EXIT_SUCCESS;
+}
+
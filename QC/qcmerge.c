@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "../Seq_Lib/partial.h"
+#include "../Seq_Lib/qctables.h"
+#include "../Seq_Lib/qualstat.h"
+#include "../Seq_Lib/gccount.h"
+
+// Mates a partial may hold counts for: single-end input, then R1 and R2
+static const char *MATES[] = {"", "R1.", "R2."};
+#define NUM_MATES (sizeof MATES / sizeof MATES[0])
+
+
+static void print_usage_and_exit(const char *progname){
+    fprintf(stderr,
+        "Usage: %s [-o PREFIX] [-b FILE] <partial> [partial ...] \n"
+        " <partial> : partial results saved with -b by multiGC_optim or qhist\n"
+        " -o PREFIX : write the tables the partials hold (gc_hist.tsv, cycles.tsv,\n"
+        "             qual_cycles.tsv, read_qual.tsv) to PREFIX.*, with R1. and\n"
+        "             R2. in front for paired runs\n"
+        " -b FILE : save the merged counts as partial results again, so merges\n"
+        "           can be merged in turn\n"
+        "Counts are added up exactly, so averages and tables are those a single\n"
+        "run over all the input would give.\n",
+        progname);
+
+    exit(EXIT_FAILURE);
+}
+
+/* Return section <mate><what> of pt and set *n to its length */
+static const uint64_t *section(const partial *pt, const char *mate, const char *what, size_t *n){
+
+    char name[PT_NAME_MAX + 1];
+    snprintf(name, sizeof name, "%s%s", mate, what);
+
+    return pt_get(pt, name, n);
+}
+
+/*
+Print averages of one mate's counts and write its tables to PREFIX.<mate>*
+when prefix is given. Return 0, or -1 after reporting a failure.
+*/
+static int report_mate(const partial *pt, const char *mate, const char *prefix){
+
+    size_t n_reads, n_gc, n_hist, n_cycles, n_bases, n_qsum, n_qcycles, n_rqual;
+
+    const uint64_t *reads = section(pt, mate, "reads", &n_reads);
+    const uint64_t *gc_sum = section(pt, mate, "gc_sum", &n_gc);
+    const uint64_t *hist = section(pt, mate, "gc_hist", &n_hist);
+    const uint64_t *cycles = section(pt, mate, "gc_cycles", &n_cycles);
+    const uint64_t *bases = section(pt, mate, "qual_bases", &n_bases);
+    const uint64_t *qsum = section(pt, mate, "qual_sum", &n_qsum);
+    const uint64_t *qcycles = section(pt, mate, "qual_cycles", &n_qcycles);
+    const uint64_t *rqual = section(pt, mate, "read_qual", &n_rqual);
+
+    if(!reads){
+        return 0;
+    }
+
+    if((hist && n_hist != QT_GC_BINS) || n_cycles % QT_CODES != 0 ||
+       (rqual && n_rqual != QS_SCORES) || n_qcycles % QS_SCORES != 0){
+        fprintf(stderr, "x Partial results for %s have tables of the wrong size\n",
+                *mate ? mate : "single-end reads");
+        return -1;
+    }
+
+    // Lines as multiGC_optim and qhist print them; "R1." becomes "R1"
+    if(gc_sum){
+        double avg_GC = gc_frac_mean(*gc_sum, *reads);
+        if(*mate){
+            printf("%.2s average GC fraction is %.4f\n", mate, avg_GC);
+        }else{
+            printf("Average GC fraction is %.4f\n", avg_GC);
+        }
+    }
+
+    if(bases && qsum){
+        double mean_q = *bases ? (double)*qsum / (double)*bases : 0.0;
+        if(*mate){
+            printf("%.2s mean base quality is %.2f\n", mate, mean_q);
+        }else{
+            printf("Mean base quality is %.2f\n", mean_q);
+        }
+    }
+
+    if(!prefix){
+        return 0;
+    }
+
+    FILE *fp;
+
+    if(hist){
+        if(!(fp = qt_open(prefix, mate, "gc_hist.tsv"))){
+            return -1;
+        }
+        qt_gc_hist(fp, hist);
+        if(qt_close(fp, prefix, mate, "gc_hist.tsv") != 0){
+            return -1;
+        }
+    }
+
+    if(cycles){
+        if(!(fp = qt_open(prefix, mate, "cycles.tsv"))){
+            return -1;
+        }
+        qt_gc_cycles(fp, cycles, n_cycles / QT_CODES);
+        if(qt_close(fp, prefix, mate, "cycles.tsv") != 0){
+            return -1;
+        }
+    }
+
+    if(qcycles){
+        if(!(fp = qt_open(prefix, mate, "qual_cycles.tsv"))){
+            return -1;
+        }
+        qt_qual_cycles(fp, qcycles, n_qcycles / QS_SCORES);
+        if(qt_close(fp, prefix, mate, "qual_cycles.tsv") != 0){
+            return -1;
+        }
+    }
+
+    if(rqual){
+        if(!(fp = qt_open(prefix, mate, "read_qual.tsv"))){
+            return -1;
+        }
+        qt_read_qual(fp, rqual);
+        if(qt_close(fp, prefix, mate, "read_qual.tsv") != 0){
+            return -1;
+        }
+    }
+
+    return 0;
+
+}
+
+
+int main(int argc, char *argv[]){
+
+    const char *prefix = NULL;
+    const char *out_path = NULL;
+
+    int c;
+    while((c = getopt(argc, argv, "o:b:")) != -1){
+        switch(c){
+            case 'o': prefix = optarg; break;
+            case 'b': out_path = optarg; break;
+            default : print_usage_and_exit(argv[0]);
+        }
+    }
+
+    if(optind == argc){
+        print_usage_and_exit(argv[0]);
+    }
+
+    /* Add up every partial */
+
+    partial *total = pt_new();
+
+    if(!total){
+        fprintf(stderr, "out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    for(int i = optind; i < argc; i++){
+
+        partial *pt = pt_read(argv[i]);
+
+        if(!pt){
+            perror("pt_read");
+            fprintf(stderr, "x Failed to read partial results from '%s'\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+
+        if(pt_merge(total, pt) != 0){
+            fprintf(stderr, "out of memory\n");
+            return EXIT_FAILURE;
+        }
+
+        pt_free(pt);
+
+    }
+
+    /* Report */
+
+    for(size_t m = 0; m < NUM_MATES; m++){
+        if(report_mate(total, MATES[m], prefix) != 0){
+            return EXIT_FAILURE;
+        }
+    }
+
+    if(out_path && pt_write(total, out_path) != 0){
+        perror("pt_write");
+        fprintf(stderr, "x Failed to write '%s'\n", out_path);
+        return EXIT_FAILURE;
+    }
+
+    pt_free(total);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,54 @@
+// Analysis stages of the qc driver. The driver parses each batch of reads
+// once and hands every thread a slice of it; each enabled stage then runs
+// on that slice with the thread's own state, so stages never share
+// counters. Once the input is finished the states are merged into one
+// and reported.
+//
+// A new analysis only needs a qc_stage and an entry in the driver's
+// STAGES table.
+
+#ifndef _STAGE_H
+#define _STAGE_H
+
+#include <stdio.h>
+
+#include "../Seq_Lib/readbatch.h"
+
+// process results besides 0.
+#define QC_NOMEM -1    // out of memory
+#define QC_INVALID -2  // a read is not valid input for this stage
+
+// Settings shared by all stages.
+typedef struct {
+    size_t k;            // k-mer length
+    const char* prefix;  // write detailed tables to PREFIX.*, or NULL
+    int phred;           // quality offset, 33 or 64
+    const char* mate;    // tables are PREFIX.<mate>*: "", or "R1." / "R2."
+} qc_options;
+
+typedef struct {
+    const char* name;     // as given to -s
+    const char* invalid;  // what QC_INVALID means, for the error message
+
+    // Return new empty state, or NULL if out of memory.
+    void* (*init)(const qc_options* opt);
+
+    // Add reads [from, to) of b to state. Return 0, QC_NOMEM or QC_INVALID.
+    int (*process)(void* state, const read_batch* b, size_t from, size_t to);
+
+    // Add everything counted in from to into. Return 0, or QC_NOMEM.
+    int (*merge)(void* into, const void* from);
+
+    // Print a summary of state to out and write any tables asked for in
+    // opt. Return 0, or -1 after reporting a failure.
+    int (*report)(const void* state, const qc_options* opt, FILE* out);
+
+    // Free state.
+    void (*destroy)(void* state);
+} qc_stage;
+
+extern const qc_stage gc_stage;    // average GC, GC histogram, per-cycle composition
+extern const qc_stage qual_stage;  // mean base quality
+extern const qc_stage kmer_stage;  // k-mer counts
+
+#endif // _STAGE_H
@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "stage.h"
+#include "../Seq_Lib/gccount.h"
+#include "../Seq_Lib/nucleotide.h"
+#include "../Seq_Lib/qctables.h"
+
+#define GC_BINS QT_GC_BINS // whole GC percentages 0 to 100
+#define NUM_CODES QT_CODES // nt_code values: A, C, G, T and anything else (N)
+
+
+// What the GC stage has seen so far. Per-read fractions are summed so the
+// average matches multiGC_optim; the histogram and cycle rows are the
+// tables of its -o option.
+typedef struct{
+    size_t reads;
+    uint64_t GC_sum;        // sum of per-read GC fractions, see gc_frac
+    uint64_t hist[GC_BINS]; // reads by GC percentage, rounded
+    uint64_t *cycle;        // ncycles rows of NUM_CODES base counts, if tables are wanted
+    size_t ncycles;
+    int tables;
+} gc_state;
+
+
+static void *gc_init(const qc_options *opt){
+
+    gc_state *st = calloc(1, sizeof(gc_state));
+
+    if(st){
+        st->tables = opt->prefix != NULL;
+    }
+
+    return st;
+
+}
+
+/* Make room for cycles up to n, zeroing the new rows */
+static int grow_cycles(gc_state *st, size_t n){
+
+    uint64_t *grown = realloc(st->cycle, n * NUM_CODES * sizeof(uint64_t));
+
+    if(!grown){
+        return QC_NOMEM;
+    }
+
+    memset(grown + st->ncycles * NUM_CODES, 0, (n - st->ncycles) * NUM_CODES * sizeof(uint64_t));
+    st->cycle = grown;
+    st->ncycles = n;
+
+    return 0;
+
+}
+
+static int gc_process(void *state, const read_batch *b, size_t from, size_t to){
+
+    gc_state *st = state;
+
+    for(size_t i = from; i < to; i++){
+
+        const char *seq = b->seq + b->off[i];
+        size_t readlen = rb_len(b, i);
+        size_t GCcount = gc_count(seq, readlen);
+
+        st->reads++;
+
+        // An empty read has no fraction to add
+        if(readlen == 0){
+            continue;
+        }
+
+        st->GC_sum += gc_frac(GCcount, readlen);
+
+        if(!st->tables){
+            continue;
+        }
+
+        // Round to the nearest whole percentage, halves up
+        st->hist[(200 * GCcount + readlen) / (2 * readlen)]++;
+
+        if(readlen > st->ncycles && grow_cycles(st, readlen) != 0){
+            return QC_NOMEM;
+        }
+
+        uint64_t *row = st->cycle;
+
+        for(size_t j = 0; j < readlen; j++, row += NUM_CODES){
+            row[nt_code[(unsigned char)seq[j]]]++;
+        }
+
+    }
+
+    return 0;
+
+}
+
+static int gc_merge(void *into, const void *from){
+
+    gc_state *st = into;
+    const gc_state *other = from;
+
+    st->reads += other->reads;
+    st->GC_sum += other->GC_sum;
+
+    for(size_t b = 0; b < GC_BINS; b++){
+        st->hist[b] += other->hist[b];
+    }
+
+    if(other->ncycles > st->ncycles && grow_cycles(st, other->ncycles) != 0){
+        return QC_NOMEM;
+    }
+
+    for(size_t k = 0; k < other->ncycles * NUM_CODES; k++){
+        st->cycle[k] += other->cycle[k];
+    }
+
+    return 0;
+
+}
+
+static int gc_report(const void *state, const qc_options *opt, FILE *out){
+
+    const gc_state *st = state;
+
+    fprintf(out, "Average GC fraction is %.4f\n", gc_frac_mean(st->GC_sum, st->reads));
+
+    if(!st->tables){
+        return 0;
+    }
+
+    FILE *fp = qt_open(opt->prefix, opt->mate, "gc_hist.tsv");
+
+    if(!fp){
+        return -1;
+    }
+
+    qt_gc_hist(fp, st->hist);
+
+    if(qt_close(fp, opt->prefix, opt->mate, "gc_hist.tsv") != 0){
+        return -1;
+    }
+
+    fp = qt_open(opt->prefix, opt->mate, "cycles.tsv");
+
+    if(!fp){
+        return -1;
+    }
+
+    qt_gc_cycles(fp, st->cycle, st->ncycles);
+
+    return qt_close(fp, opt->prefix, opt->mate, "cycles.tsv");
+
+}
+
+static void gc_destroy(void *state){
+
+    gc_state *st = state;
+
+    if(st){
+        free(st->cycle);
+        free(st);
+    }
+
+}
+
+const qc_stage gc_stage = {
+    "gc", "", gc_init, gc_process, gc_merge, gc_report, gc_destroy
+};
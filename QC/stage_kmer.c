@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stage.h"
+#include "../Kmer_Hash/ht.h"
+#include "../Seq_Lib/nucleotide.h"
+#include "../Seq_Lib/qctables.h"
+
+
+// k-mer counts of the reads seen so far, kept the way kmers_fastq keeps
+// them: NUL-terminated k-mers mapped to malloc'd int counts.
+typedef struct{
+    ht *kcounts;
+    size_t k;
+    char *kmer; // k + 1 bytes of scratch for building keys
+} kmer_state;
+
+
+static void kmer_destroy(void *state);
+
+static void *kmer_init(const qc_options *opt){
+
+    kmer_state *st = calloc(1, sizeof(kmer_state));
+
+    if(!st){
+        return NULL;
+    }
+
+    st->k = opt->k;
+    st->kcounts = ht_create();
+    st->kmer = malloc(opt->k + 1);
+
+    if(!st->kcounts || !st->kmer){
+        kmer_destroy(st);
+        return NULL;
+    }
+
+    st->kmer[opt->k] = '\0';
+
+    return st;
+
+}
+
+/* Add n to the count of key. Return 0, or QC_NOMEM. */
+static int add_count(ht *kcounts, const char *key, int n){
+
+    int *pcount = ht_get(kcounts, key);
+
+    if(pcount){
+        *pcount += n;
+        return 0;
+    }
+
+    pcount = malloc(sizeof(int));
+
+    if(!pcount){
+        return QC_NOMEM;
+    }
+
+    *pcount = n;
+
+    if(ht_set(kcounts, key, pcount) == NULL){
+        free(pcount);
+        return QC_NOMEM;
+    }
+
+    return 0;
+
+}
+
+static int kmer_process(void *state, const read_batch *b, size_t from, size_t to){
+
+    kmer_state *st = state;
+    size_t k = st->k;
+
+    for(size_t r = from; r < to; r++){
+
+        const char *seq = b->seq + b->off[r];
+        size_t seqlen = rb_len(b, r);
+
+        /* Check validity of input sequence */
+
+        if(nt_valid_span(seq, seqlen, NT_ACGTN) != seqlen){
+            return QC_INVALID;
+        }
+
+        /* Reads no longer than k have no k-mers to count */
+        if(seqlen <= k){
+            continue;
+        }
+
+        /* Count kmers, stopping where kmers_fastq does */
+
+        for(size_t i = 0; i < seqlen - k; i++){
+
+            memcpy(st->kmer, seq + i, k);
+
+            if(add_count(st->kcounts, st->kmer, 1) != 0){
+                return QC_NOMEM;
+            }
+
+        }
+
+    }
+
+    return 0;
+
+}
+
+static int kmer_merge(void *into, const void *from){
+
+    kmer_state *st = into;
+    const kmer_state *other = from;
+
+    hti it = ht_iterator(other->kcounts);
+
+    while(ht_next(&it)){
+        if(add_count(st->kcounts, it.key, *(int *)it.value) != 0){
+            return QC_NOMEM;
+        }
+    }
+
+    return 0;
+
+}
+
+static int kmer_report(const void *state, const qc_options *opt, FILE *out){
+
+    const kmer_state *st = state;
+
+    fprintf(out, "Distinct %zu-mers: %zu\n", st->k, ht_length(st->kcounts));
+
+    if(!opt->prefix){
+        return 0;
+    }
+
+    FILE *fp = qt_open(opt->prefix, opt->mate, "kmers.txt");
+
+    if(!fp){
+        return -1;
+    }
+
+    hti it = ht_iterator(st->kcounts);
+
+    while(ht_next(&it)){
+        fprintf(fp, "%s %d\n", it.key, *(int *)it.value);
+    }
+
+    return qt_close(fp, opt->prefix, opt->mate, "kmers.txt");
+
+}
+
+static void kmer_destroy(void *state){
+
+    kmer_state *st = state;
+
+    if(!st){
+        return;
+    }
+
+    if(st->kcounts){
+
+        hti it = ht_iterator(st->kcounts);
+
+        while(ht_next(&it)){
+            free(it.value);
+        }
+
+        ht_destroy(st->kcounts);
+
+    }
+
+    free(st->kmer);
+    free(st);
+
+}
+
+const qc_stage kmer_stage = {
+    "kmer", "reads must be sequences of As, Gs, Ts, Cs, and Ns",
+    kmer_init, kmer_process, kmer_merge, kmer_report, kmer_destroy
+};
@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "stage.h"
+#include "../Seq_Lib/qualstat.h"
+
+
+// Sum of Phred scores over all bases seen
+typedef struct{
+    uint64_t qsum;
+    uint64_t nbases;
+    int phred;
+} qual_state;
+
+
+static void *qual_init(const qc_options *opt){
+
+    qual_state *st = calloc(1, sizeof(qual_state));
+
+    if(st){
+        st->phred = opt->phred;
+    }
+
+    return st;
+
+}
+
+static int qual_process(void *state, const read_batch *b, size_t from, size_t to){
+
+    qual_state *st = state;
+
+    // An empty batch has no offsets
+    if(from == to){
+        return 0;
+    }
+
+    size_t nbases = b->off[to] - b->off[from];
+
+    // Qualities of a slice of reads sit back to back, so sum them in one
+    // vector sweep and take the offset off once (bytes below it are not
+    // valid qualities, only kept from taking the sum below zero)
+    uint64_t raw = qs_sum(b->qual + b->off[from], nbases);
+    uint64_t base = (uint64_t)st->phred * nbases;
+
+    st->qsum += raw > base ? raw - base : 0;
+    st->nbases += nbases;
+
+    return 0;
+
+}
+
+static int qual_merge(void *into, const void *from){
+
+    qual_state *st = into;
+    const qual_state *other = from;
+
+    st->qsum += other->qsum;
+    st->nbases += other->nbases;
+
+    return 0;
+
+}
+
+static int qual_report(const void *state, const qc_options *opt, FILE *out){
+
+    // No tables to write
+    (void)opt;
+
+    const qual_state *st = state;
+
+    fprintf(out, "Mean base quality is %.2f\n",
+            st->nbases ? (double)st->qsum / (double)st->nbases : 0.0);
+
+    return 0;
+
+}
+
+static void qual_destroy(void *state){
+    free(state);
+}
+
+const qc_stage qual_stage = {
+    "qual", "", qual_init, qual_process, qual_merge, qual_report, qual_destroy
+};
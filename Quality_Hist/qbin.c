@@ -0,0 +1,194 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <omp.h>
+
+#include "../Seq_Lib/fqreader.h"
+#include "../Seq_Lib/fqwriter.h"
+#include "../Seq_Lib/qualbin.h"
+#include "../Seq_Lib/phred.h"
+
+#define RECYCLE_EVERY 65536 // records between fq_recycle calls
+
+
+static void print_usage_and_exit(const char *progname){
+    fprintf(stderr,
+        "Usage: %s [-b SCHEME] [-i OFFSET] [-e OFFSET] <fastq file> <out> \n"
+        " <fastq file> : path to a .fastq, .fq or .fq.gz file\n"
+        " <out> : FASTQ file to write, or - for standard output\n"
+        " -b SCHEME : illumina8 (default), novaseq, none, or ranges of scores\n"
+        "             and the score each becomes, e.g. 0-19:10,20-41:30\n"
+        " -i OFFSET : quality offset of the input, 33, 64 or auto (default auto:\n"
+        "             guessed from the first %d reads)\n"
+        " -e OFFSET : quality offset to write, 33 or 64 (default: the input's)\n"
+        "Every quality is binned through a 256-entry table applied with SIMD\n"
+        "shuffles; names and sequences are copied unchanged.\n",
+        progname, PHRED_SAMPLE_READS);
+
+    exit(EXIT_FAILURE);
+}
+
+/* Write rec with its qualities binned through table, straight from the
+reader's view into the writer's buffer. Return 0, or -1 on a write error */
+static int write_binned(fq_writer *w, const qb_table *table, const fq_record *rec){
+
+    size_t head = rec->name_len + rec->seq_len + 5; // "@name\nseq\n+\n"
+    size_t n = head + rec->qual_len + 1;
+
+    if(n <= FQW_BUFFER){
+
+        char *p = fq_wreserve(w, n);
+
+        if(!p){
+            return -1;
+        }
+
+        *p++ = '@';
+        memcpy(p, rec->name, rec->name_len);
+        p += rec->name_len;
+        *p++ = '\n';
+        memcpy(p, rec->seq, rec->seq_len);
+        p += rec->seq_len;
+        memcpy(p, "\n+\n", 3);
+        p += 3;
+        qb_apply(table, rec->qual, rec->qual_len, p);
+        p[rec->qual_len] = '\n';
+        fq_wcommit(w, n);
+
+        return 0;
+    }
+
+    // Records longer than the buffer go out a buffer at a time
+    if(fq_wwrite(w, "@", 1) || fq_wwrite(w, rec->name, rec->name_len) ||
+       fq_wwrite(w, "\n", 1) || fq_wwrite(w, rec->seq, rec->seq_len) ||
+       fq_wwrite(w, "\n+\n", 3)){
+        return -1;
+    }
+
+    for(size_t i = 0; i < rec->qual_len; i += FQW_BUFFER){
+
+        size_t part = rec->qual_len - i < FQW_BUFFER ? rec->qual_len - i : FQW_BUFFER;
+        char *p = fq_wreserve(w, part);
+
+        if(!p){
+            return -1;
+        }
+
+        qb_apply(table, rec->qual + i, part, p);
+        fq_wcommit(w, part);
+
+    }
+
+    return fq_wwrite(w, "\n", 1);
+}
+
+
+int main(int argc, char *argv[]){
+
+    double start_time = omp_get_wtime();
+
+    const char *scheme = "illumina8";
+    int in_offset = 0;
+    int out_offset = 0;
+
+    int c;
+    while((c = getopt(argc, argv, "b:i:e:")) != -1){
+        switch(c){
+            case 'b': scheme = optarg; break;
+            case 'i':
+                if((in_offset = phred_parse(optarg)) < 0){
+                    print_usage_and_exit(argv[0]);
+                }
+                break;
+            case 'e':
+                if((out_offset = phred_parse(optarg)) <= 0){
+                    print_usage_and_exit(argv[0]);
+                }
+                break;
+            default : print_usage_and_exit(argv[0]);
+        }
+    }
+
+    if(argc - optind != 2){
+        print_usage_and_exit(argv[0]);
+    }
+
+    const char *path = argv[optind];
+    const char *out_path = argv[optind + 1];
+
+    if(in_offset == 0 && (in_offset = phred_detect(path, PHRED_SAMPLE_READS)) < 0){
+        perror("phred_detect");
+        fprintf(stderr, "x Failed to read qualities of '%s'\n", path);
+        return EXIT_FAILURE;
+    }
+
+    if(out_offset == 0){
+        out_offset = in_offset;
+    }
+
+    qb_table table;
+
+    if(qb_table_init(&table, scheme, in_offset, out_offset) != 0){
+        fprintf(stderr, "x Invalid binning scheme '%s'\n", scheme);
+        return EXIT_FAILURE;
+    }
+
+    fq_reader *reader = fq_open(path);
+
+    if(!reader){
+        perror("fq_open");
+        fprintf(stderr, "x Failed to open '%s'\n", path);
+        return EXIT_FAILURE;
+    }
+
+    fq_writer *writer = fq_wopen(out_path);
+
+    if(!writer){
+        perror("fq_wopen");
+        fprintf(stderr, "x Failed to open '%s'\n", out_path);
+        return EXIT_FAILURE;
+    }
+
+    /* Rewrite records */
+
+    fq_record rec;
+    size_t num_reads = 0;
+    int status;
+    int failed = 0;
+
+    while((status = fq_next(reader, &rec)) == 1){
+
+        if(write_binned(writer, &table, &rec) != 0){
+            failed = 1;
+            break;
+        }
+
+        if(++num_reads % RECYCLE_EVERY == 0){
+            fq_recycle(reader);
+        }
+
+    }
+
+    fq_close(reader);
+
+    if(fq_wclose(writer) != 0){
+        failed = 1;
+    }
+
+    if(status == -1){
+        fprintf(stderr, "x Malformed FASTQ record after read %zu in '%s'\n", num_reads, path);
+        return EXIT_FAILURE;
+    }
+
+    if(failed){
+        perror("write");
+        fprintf(stderr, "x Failed to write '%s'\n", out_path);
+        return EXIT_FAILURE;
+    }
+
+    fprintf(stderr, "Binned %zu reads (%s, Phred+%d to Phred+%d, %s kernel) in %.3f s\n",
+            num_reads, scheme, in_offset, out_offset, qb_apply_impl(), omp_get_wtime() - start_time);
+
+    return EXIT_SUCCESS;
+}
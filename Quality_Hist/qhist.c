@@ -4,47 +4,94 @@
 #include <ctype.h>
 #include <errno.h>
 #include <stdint.h>
-
-
-typedef struct{
-    size_t read_len;
-    char *seq;
-    char *qualities;
-    char *name;
-} fastq_entry;
+#include <unistd.h>
+#include <omp.h>
+
+#include "../Seq_Lib/fqreader.h"
+#include "../Seq_Lib/fqpair.h"
+#include "../Seq_Lib/readbatch.h"
+#include "../Seq_Lib/gccount.h"
+#include "../Seq_Lib/qualstat.h"
+#include "../Seq_Lib/phred.h"
+#include "../Seq_Lib/partial.h"
+#include "../Seq_Lib/qctables.h"
+#include "../Seq_Lib/tilestat.h"
+
+
+static void print_usage_and_exit(const char *progname){
+    fprintf(stderr,
+        "Usage: %s [-p MATE2] [-o PREFIX] [-b FILE] [-P OFFSET] [-t] <fastq file> <num_reads> \n"
+        " <fastq file> : path to a .fastq or .fq file\n"
+        " <num_reads> : positive integer (how many reads to parse)\n"
+        " -p MATE2 : R2 file of a paired-end run; <fastq file> is then R1\n"
+        "            and each mate gets its own stats from the same pass\n"
+        " -o PREFIX : also write the count of every Phred score at every cycle\n"
+        "             to PREFIX.qual_cycles.tsv and reads by mean quality to\n"
+        "             PREFIX.read_qual.tsv (PREFIX.R1.* and PREFIX.R2.* for\n"
+        "             paired input)\n"
+        " -b FILE : also save the counts behind the numbers and tables above as\n"
+        "           partial results in FILE, for qcmerge to combine with those\n"
+        "           of other runs\n"
+        " -P OFFSET : quality encoding, 33, 64 or auto (default auto: guessed\n"
+        "             from the first %d reads)\n"
+        " -t : break reads down by the lane and tile in their Illumina names and\n"
+        "      print the tile with the lowest mean base quality; with -o, write\n"
+        "      the reads, mean base quality and average GC fraction of every\n"
+        "      tile to PREFIX.tiles.tsv\n",
+        progname, PHRED_SAMPLE_READS);
+
+    exit(EXIT_FAILURE);
+}
+
+static uint64_t GC_sum(const read_batch *reads, size_t num_reads);
+static size_t total_bases(const read_batch *reads, size_t num_reads);
+static uint64_t quality_sum(const read_batch *reads, size_t num_reads, int offset);
+static double mean_quality(const read_batch *reads, size_t num_reads, int offset);
+static int quality_stats(const read_batch *reads, size_t num_reads, int offset, qual_stats *qs);
+static int quality_report(const qual_stats *qs, const char *prefix, const char *mate);
+static int partial_add(partial *pt, const char *mate, const read_batch *reads, size_t num_reads,
+                       int offset, const qual_stats *qs);
+static int tile_breakdown(const read_batch *reads, size_t num_reads, int offset, tile_stats *ts);
+static void tile_summary(const tile_stats *ts, const char *mate);
+static int tile_report(const tile_stats *ts, const char *prefix, const char *mate);
 
 
 int main(int argc, char *argv[]){
 
+    const char *mate2_path = NULL;
+    const char *report_prefix = NULL;
+    const char *partial_path = NULL;
+    int offset = 0;
+    int by_tile = 0;
+
+    int c;
+    while((c = getopt(argc, argv, "p:o:b:P:t")) != -1){
+        switch(c) {
+            case 'p': mate2_path = optarg; break;
+            case 'o': report_prefix = optarg; break;
+            case 'b': partial_path = optarg; break;
+            case 'P':
+                if((offset = phred_parse(optarg)) < 0){
+                    print_usage_and_exit(argv[0]);
+                }
+                break;
+            case 't': by_tile = 1; break;
+            default : print_usage_and_exit(argv[0]);
+        }
+    }
 
     /* Make sure correct number of arguments */
-    if (argc != 3){
-        fprintf(stderr,
-        "Usage: %s <fastq file> <num_reads> \n"
-        " <fastq file> : path to a .fastq or .fq file\n"
-        " <num_reads> : positive integer (how many reads to parse)\n",
-        argv[0]
-        );
-        return EXIT_FAILURE;
+    if (argc - optind != 2){
+        print_usage_and_exit(argv[0]);
     }
 
-    /* Open file */
-
-    const char *path = argv[1];
-
-    FILE *file = fopen(path, "r");
-
-    if (!file){
-        perror("fopen");
-        fprintf(stderr, "x Failed to open '%s'\n", path);
-        return EXIT_FAILURE;
-    }
+    const char *path = argv[optind];
 
 
     /* How many reads to read? */
 
     char *endptr = NULL;
-    unsigned long long tmp = strtoull(argv[2], &endptr, 10);
+    unsigned long long tmp = strtoull(argv[optind + 1], &endptr, 10);
 
     errno = 0;
 
@@ -60,87 +107,454 @@ int main(int argc, char *argv[]){
 
     size_t num_reads = (size_t)tmp;
 
+
+    /* Quality encoding */
+
+    // Mates share an encoding, so R1 alone is sampled
+    if(offset == 0 && (offset = phred_detect(path, PHRED_SAMPLE_READS)) < 0){
+        perror("phred_detect");
+        fprintf(stderr, "x Failed to read qualities of '%s'\n", path);
+        return EXIT_FAILURE;
+    }
+
     /* Parse fastq entries */
-    fastq_entry *fastqs;
 
-    fastqs = malloc(num_reads * sizeof(fastq_entry));
+    // Reads are copied into one struct-of-arrays batch: sequences,
+    // qualities and names each sit back to back in their own buffer
+    read_batch reads;
+    read_batch mates;
+    rb_init(&reads);
+    rb_init(&mates);
 
-    char *line = NULL;
-    size_t n = 0;
-    size_t lineno = 0;
-    size_t entry_cnt = 0;
+    int status;
+    size_t entry_cnt;
 
-    while(getline(&line, &n, file) && lineno < (num_reads * 4)){
-        
-        line[strcspn(line, "\r\n")] = '\0';
-        
-        size_t mem_to_allocate = strlen(line) + 1;
+    if(mate2_path){
 
-        if(lineno % 4 == 0){
+        // Both mates are read in lockstep and their names checked
+        fq_pair *pair = fq_pair_open(path, mate2_path);
 
-            fastqs[entry_cnt].name = malloc(mem_to_allocate);
-            strcpy(fastqs[entry_cnt].name, line);
+        if (!pair){
+            perror("fq_pair_open");
+            fprintf(stderr, "x Failed to open '%s' and '%s'\n", path, mate2_path);
+            return EXIT_FAILURE;
+        }
 
-        }else if(lineno % 4 == 1){
+        entry_cnt = rb_fill_pair(&reads, &mates, pair, num_reads, &status);
 
-            fastqs[entry_cnt].seq = malloc(mem_to_allocate);
-            strcpy(fastqs[entry_cnt].seq, line);
-            fastqs[entry_cnt].read_len = mem_to_allocate - 1;
+        fq_pair_close(pair);
 
-        }else if(lineno % 4 == 3){
+    }else{
 
-            fastqs[entry_cnt].qualities = malloc(mem_to_allocate);
-            strcpy(fastqs[entry_cnt].qualities, line);
-            entry_cnt++;
+        fq_reader *reader = fq_open(path);
 
+        if (!reader){
+            perror("fq_open");
+            fprintf(stderr, "x Failed to open '%s'\n", path);
+            return EXIT_FAILURE;
         }
-        
-        lineno++;
-        n = 0;
+
+        entry_cnt = rb_fill(&reads, reader, num_reads, &status);
+
+        fq_close(reader);
 
     }
 
-    /* Free stuff */
-    free(line);
+    if(status == -2){
+        fprintf(stderr, "out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    if(status == -1){
+        fprintf(stderr, "x Malformed FASTQ record after read %zu in '%s'\n", entry_cnt, path);
+        return EXIT_FAILURE;
+    }
+
+    if(status == FQ_PAIR_MISMATCH){
+        fprintf(stderr, "x Read %zu has different names in '%s' and '%s'\n",
+                entry_cnt + 1, path, mate2_path);
+        return EXIT_FAILURE;
+    }
+
+    if(status == FQ_PAIR_UNEVEN){
+        fprintf(stderr, "x '%s' and '%s' hold different numbers of reads\n",
+                path, mate2_path);
+        return EXIT_FAILURE;
+    }
+
+    /* There were less than the requested number of reads*/
+    if(entry_cnt < num_reads){
+        num_reads = entry_cnt;
+    }
 
     /* Print some stats */
-    size_t readlen;
-    float *GCconts;
-    GCconts = malloc(num_reads * sizeof(float));
 
+    if(mate2_path){
+
+        printf("R1 '%s': average GC fraction is %.4f, mean base quality is %.2f\n",
+               path, gc_frac_mean(GC_sum(&reads, num_reads), num_reads),
+               mean_quality(&reads, num_reads, offset));
+        printf("R2 '%s': average GC fraction is %.4f, mean base quality is %.2f\n",
+               mate2_path, gc_frac_mean(GC_sum(&mates, num_reads), num_reads),
+               mean_quality(&mates, num_reads, offset));
+
+    }else{
+
+        printf("Average GC fraction is %.4f\n", gc_frac_mean(GC_sum(&reads, num_reads), num_reads));
+
+    }
+
+    /* Quality tables and partial results */
+
+    const read_batch *batches[2] = {&reads, &mates};
+    const char *mates_tag[2] = {mate2_path ? "R1." : "", "R2."};
+    int nmates = mate2_path ? 2 : 1;
+    qual_stats qs[2];
 
-    for(size_t i = 0; i<num_reads; i++){
+    if(report_prefix || partial_path){
+        for(int m = 0; m < nmates; m++){
+            if(quality_stats(batches[m], num_reads, offset, &qs[m]) != 0){
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    if(report_prefix){
+        for(int m = 0; m < nmates; m++){
+            if(quality_report(&qs[m], report_prefix, mates_tag[m]) != 0){
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    if(partial_path){
+
+        partial *pt = pt_new();
+        int failed = !pt;
+
+        for(int m = 0; m < nmates && !failed; m++){
+            failed = partial_add(pt, mates_tag[m], batches[m], num_reads, offset, &qs[m]) != 0;
+        }
+
+        if(failed){
+            fprintf(stderr, "out of memory\n");
+            return EXIT_FAILURE;
+        }
+
+        if(pt_write(pt, partial_path) != 0){
+            perror("pt_write");
+            fprintf(stderr, "x Failed to write '%s'\n", partial_path);
+            return EXIT_FAILURE;
+        }
+
+        pt_free(pt);
+
+    }
+
+    if(report_prefix || partial_path){
+        for(int m = 0; m < nmates; m++){
+            qs_free(&qs[m]);
+        }
+    }
 
-        size_t GCcount = 0;
+    /* Lanes and tiles */
 
-        readlen = fastqs[i].read_len;
+    if(by_tile){
+        for(int m = 0; m < nmates; m++){
 
-        for(size_t j = 0; j < readlen; j++){
+            tile_stats ts;
 
-            if(toupper(fastqs[i].seq[j]) == 'G' || toupper(fastqs[i].seq[j]) == 'C'){
-                GCcount = GCcount + 1;
+            if(tile_breakdown(batches[m], num_reads, offset, &ts) != 0){
+                return EXIT_FAILURE;
             }
 
+            tile_summary(&ts, mate2_path ? (m == 0 ? "R1 " : "R2 ") : "");
+
+            if(report_prefix && tile_report(&ts, report_prefix, mates_tag[m]) != 0){
+                return EXIT_FAILURE;
+            }
+
+            ts_free(&ts);
+
         }
+    }
+
+    rb_free(&reads);
+    rb_free(&mates);
+}
+
+
+/* Sum of per-read GC fractions, in gc_frac units, so it is exact */
+static uint64_t GC_sum(const read_batch *reads, size_t num_reads){
+
+    uint64_t sum = 0;
+
+    for(size_t i = 0; i < num_reads; i++){
+
+        size_t readlen = rb_len(reads, i);
+        sum += gc_frac(gc_count(reads->seq + reads->off[i], readlen), readlen);
+
+    }
+
+    return sum;
+
+}
+
+/* Bases of the first num_reads reads (an empty batch has no offsets) */
+static size_t total_bases(const read_batch *reads, size_t num_reads){
+    return num_reads ? reads->off[num_reads] : 0;
+}
+
+/* Sum of Phred scores over all bases (Phred+offset encoding) */
+static uint64_t quality_sum(const read_batch *reads, size_t num_reads, int offset){
+
+    size_t nbases = total_bases(reads, num_reads);
+
+    // Qualities of all reads sit back to back, so sum them in one sweep and
+    // take the offset off once (bytes below it are not valid qualities, as
+    // when -P 64 is given for Phred+33 input, only kept from taking the
+    // sum below zero)
+    uint64_t raw = qs_sum(reads->qual, nbases);
+    uint64_t base = (uint64_t)offset * nbases;
+
+    return raw > base ? raw - base : 0;
+
+}
+
+/* Mean Phred score over all bases */
+static double mean_quality(const read_batch *reads, size_t num_reads, int offset){
+
+    size_t nbases = total_bases(reads, num_reads);
+
+    return nbases ? (double)quality_sum(reads, num_reads, offset) / (double)nbases : 0.0;
+
+}
+
+/*
+Count every Phred score at every cycle and reads by mean quality into qs,
+each thread over its own slice of the reads. Return 0, or -1 after
+reporting a failure.
+*/
+static int quality_stats(const read_batch *reads, size_t num_reads, int offset, qual_stats *qs){
+
+    int nt = omp_get_max_threads();
+    qual_stats *parts = malloc(nt * sizeof(qual_stats));
+    int failed = 0;
+
+    if(!parts){
+        fprintf(stderr, "out of memory\n");
+        return -1;
+    }
+
+    for(int t = 0; t < nt; t++){
+        qs_init(&parts[t], offset);
+    }
+
+    #pragma omp parallel reduction(+:failed)
+    {
+        int t = omp_get_thread_num();
+        int team = omp_get_num_threads();
+
+        for(size_t i = num_reads * t / team; i < num_reads * (t + 1) / team; i++){
+            if(qs_add(&parts[t], reads->qual + reads->off[i], rb_len(reads, i)) != 0){
+                failed++;
+                break;
+            }
+        }
+    }
+
+    for(int t = 1; t < nt && !failed; t++){
+        failed += qs_merge(&parts[0], &parts[t]) != 0;
+    }
+
+    failed += !failed && qs_flush(&parts[0]) != 0;
+
+    for(int t = 1; t < nt; t++){
+        qs_free(&parts[t]);
+    }
+
+    *qs = parts[0];
+    free(parts);
+
+    if(failed){
+        fprintf(stderr, "out of memory\n");
+        qs_free(qs);
+        return -1;
+    }
+
+    return 0;
+
+}
+
+/* Write PREFIX.<mate>qual_cycles.tsv and PREFIX.<mate>read_qual.tsv.
+Return 0, or -1 after reporting a failure */
+static int quality_report(const qual_stats *qs, const char *prefix, const char *mate){
+
+    FILE *fp = qt_open(prefix, mate, "qual_cycles.tsv");
+
+    if(!fp){
+        return -1;
+    }
+
+    qt_qual_cycles(fp, qs->cycle, qs->ncycles);
+
+    if(qt_close(fp, prefix, mate, "qual_cycles.tsv") != 0){
+        return -1;
+    }
+
+    fp = qt_open(prefix, mate, "read_qual.tsv");
+
+    if(!fp){
+        return -1;
+    }
+
+    qt_read_qual(fp, qs->read_mean);
+
+    return qt_close(fp, prefix, mate, "read_qual.tsv");
+
+}
+
+/* Add a mate's counts to partial results, as sections named <mate>reads
+and so on. Return 0, or -1 if out of memory */
+static int partial_add(partial *pt, const char *mate, const read_batch *reads, size_t num_reads,
+                       int offset, const qual_stats *qs){
+
+    char name[PT_NAME_MAX + 1];
+    int failed = 0;
+
+    snprintf(name, sizeof name, "%sreads", mate);
+    failed |= pt_add1(pt, name, num_reads);
+    snprintf(name, sizeof name, "%sgc_sum", mate);
+    failed |= pt_add1(pt, name, GC_sum(reads, num_reads));
+    snprintf(name, sizeof name, "%squal_bases", mate);
+    failed |= pt_add1(pt, name, total_bases(reads, num_reads));
+    snprintf(name, sizeof name, "%squal_sum", mate);
+    failed |= pt_add1(pt, name, quality_sum(reads, num_reads, offset));
+    snprintf(name, sizeof name, "%squal_cycles", mate);
+    failed |= pt_add(pt, name, qs->cycle, qs->ncycles * QS_SCORES);
+    snprintf(name, sizeof name, "%sread_qual", mate);
+    failed |= pt_add(pt, name, qs->read_mean, QS_SCORES);
+
+    return failed ? -1 : 0;
+
+}
+
+/*
+Sum reads, bases, quality and GC by the lane and tile in each read's name
+into ts (sorted by lane and tile), each thread over its own slice of the
+reads. Return 0, or -1 after reporting a failure.
+*/
+static int tile_breakdown(const read_batch *reads, size_t num_reads, int offset, tile_stats *ts){
+
+    int nt = omp_get_max_threads();
+    tile_stats *parts = malloc(nt * sizeof(tile_stats));
+    int failed = 0;
+
+    if(!parts){
+        fprintf(stderr, "out of memory\n");
+        return -1;
+    }
+
+    for(int t = 0; t < nt; t++){
+        ts_init(&parts[t], offset);
+    }
+
+    #pragma omp parallel reduction(+:failed)
+    {
+        int t = omp_get_thread_num();
+        int team = omp_get_num_threads();
+
+        for(size_t i = num_reads * t / team; i < num_reads * (t + 1) / team; i++){
+
+            size_t off = reads->off[i];
+            size_t name_off = reads->name_off[i];
+
+            if(ts_add(&parts[t], reads->name + name_off, reads->name_off[i + 1] - name_off,
+                      reads->seq + off, reads->qual + off, rb_len(reads, i)) != 0){
+                failed++;
+                break;
+            }
+
+        }
+    }
+
+    for(int t = 1; t < nt && !failed; t++){
+        failed += ts_merge(&parts[0], &parts[t]) != 0;
+    }
+
+    for(int t = 1; t < nt; t++){
+        ts_free(&parts[t]);
+    }
+
+    *ts = parts[0];
+    free(parts);
+
+    if(failed){
+        fprintf(stderr, "out of memory\n");
+        ts_free(ts);
+        return -1;
+    }
+
+    ts_sort(ts);
+
+    return 0;
+
+}
+
+/* Print how many tiles there are and which has the lowest mean quality */
+static void tile_summary(const tile_stats *ts, const char *mate){
+
+    const tile_row *worst = NULL;
+    double worst_mean = 0.0;
+
+    for(size_t i = 0; i < ts->n; i++){
+
+        const tile_row *row = &ts->rows[i];
+        double mean = row->bases ? (double)row->qual_sum / (double)row->bases : 0.0;
+
+        if(!worst || mean < worst_mean){
+            worst = row;
+            worst_mean = mean;
+        }
+
+    }
+
+    if(worst){
+        printf("%sTiles: %zu, lowest mean base quality is %.2f (lane %u, tile %u)\n",
+               mate, ts->n, worst_mean, worst->lane, worst->tile);
+    }else{
+        printf("%sTiles: 0\n", mate);
+    }
+
+    if(ts->unparsed){
+        printf("%sReads without a lane and tile in their names: %llu\n",
+               mate, (unsigned long long)ts->unparsed);
+    }
+
+}
 
-        GCconts[i] = (double)GCcount / (double)readlen;
+/* Write PREFIX.<mate>tiles.tsv. Return 0, or -1 after reporting a failure */
+static int tile_report(const tile_stats *ts, const char *prefix, const char *mate){
 
-        free(fastqs[i].seq);
-        free(fastqs[i].name);
-        free(fastqs[i].qualities);
+    FILE *fp = qt_open(prefix, mate, "tiles.tsv");
 
+    if(!fp){
+        return -1;
     }
 
-    free(fastqs);
+    fprintf(fp, "lane\ttile\treads\tbases\tmean_quality\tgc_fraction\n");
 
-    double avg_GC = 0;
+    for(size_t i = 0; i < ts->n; i++){
 
-    for(size_t i = 0; i <num_reads; i++){
+        const tile_row *row = &ts->rows[i];
 
-        avg_GC = avg_GC + (GCconts[i] / ((double)num_reads));
+        fprintf(fp, "%u\t%u\t%llu\t%llu\t%.2f\t%.4f\n", row->lane, row->tile,
+                (unsigned long long)row->reads, (unsigned long long)row->bases,
+                row->bases ? (double)row->qual_sum / (double)row->bases : 0.0,
+                gc_frac_mean(row->gc_sum, row->reads));
 
     }
 
+    return qt_close(fp, prefix, mate, "tiles.tsv");
 
-    printf("Average GC fraction is %.4f\n", avg_GC);
-}
\ No newline at end of file
+}
@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "../Seq_Lib/fqcache.h"
+
+
+int main(int argc, char *argv[]){
+
+    /* Make sure correct number of arguments */
+    if (argc != 3){
+        fprintf(stderr,
+        "Usage: %s <fastq file> <cache file> \n"
+        " <fastq file> : path to a .fastq or .fq file (optionally gzipped)\n"
+        " <cache file> : where to write the binary read cache\n"
+        "Any FASTQ tool built on Seq_Lib accepts the cache in place of the\n"
+        "FASTQ file.\n",
+        argv[0]
+        );
+        return EXIT_FAILURE;
+    }
+
+    const char *in_path = argv[1];
+    const char *out_path = argv[2];
+
+
+    /* Convert */
+
+    int status = fqc_write(in_path, out_path);
+
+    if(status == -1){
+        fprintf(stderr, "x Malformed FASTQ record in '%s'\n", in_path);
+        return EXIT_FAILURE;
+    }
+
+    if(status == 0){
+        fprintf(stderr, "x Failed to convert '%s' to '%s': %s\n",
+                in_path, out_path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+
+    /* Report what was stored */
+
+    fq_cache *cache = fqc_open(out_path);
+
+    if(!cache){
+        perror("fqc_open");
+        fprintf(stderr, "x Failed to open '%s'\n", out_path);
+        return EXIT_FAILURE;
+    }
+
+    struct stat in_st, out_st;
+    stat(in_path, &in_st);
+    stat(out_path, &out_st);
+
+    printf("Wrote %zu reads to '%s' (%.1f MB from %.1f MB)\n",
+           fqc_count(cache), out_path,
+           out_st.st_size / 1e6, in_st.st_size / 1e6);
+
+    fqc_close(cache);
+
+    return EXIT_SUCCESS;
+}
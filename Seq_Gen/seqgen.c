@@ -0,0 +1,293 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <omp.h>
+
+#include "synth.h"
+
+#define CHUNK_BYTES (4 << 20) // output each thread generates at a time
+#define DEFAULT_SIZE "1G"
+
+
+static void print_usage_and_exit(const char *progname){
+    fprintf(stderr,
+        "Usage: %s [options] <out> \n"
+        " <out> : file to write, or - for standard output\n"
+        " -S SIZE : stop once this much is written, e.g. 500M, 10G (default %s)\n"
+        " -n N : write exactly N records instead\n"
+        " -s SEED : seed; the same seed and options give the same file (default 1)\n"
+        " -f : FASTA contigs instead of FASTQ reads\n"
+        " -l LEN : read length: LEN, MIN-MAX (uniform) or MEAN~SD (lognormal,\n"
+        "          as long reads are); default 150, or 1000000 for contigs\n"
+        " -g GC : GC fraction (default 0.5)\n"
+        " -N RATE : fraction of bases that are N (default 0.001; in runs of %d\n"
+        "           for contigs)\n"
+        " -q PROFILE : qualities: illumina, binned, flat or long (default illumina)\n"
+        " -Q MAX : highest Phred score (default 41)\n"
+        " -P OFFSET : quality offset, 33 or 64 (default 33)\n"
+        " -d RATE : fraction of reads duplicating a recent read (default 0)\n"
+        " -a RATE : fraction of reads running into adapter (default 0)\n"
+        " -A SEQ : adapter (default %s)\n"
+        " -G LEN : length of the genome reads are sampled from (default 4000000)\n"
+        " -w WIDTH : FASTA line width (default 60)\n"
+        "Records are generated on every thread and written in order, so the\n"
+        "output does not depend on the thread count.\n",
+        progname, DEFAULT_SIZE, SYNTH_N_RUN, SYNTH_ADAPTER);
+
+    exit(EXIT_FAILURE);
+}
+
+/* Parse a byte count with an optional K, M or G suffix. Return 0 if s
+is not one */
+static uint64_t parse_size(const char *s){
+
+    char *end = NULL;
+    errno = 0;
+    unsigned long long v = strtoull(s, &end, 10);
+    int shift = 0;
+
+    switch(*end){
+        case 'K': case 'k': shift = 10; end++; break;
+        case 'M': case 'm': shift = 20; end++; break;
+        case 'G': case 'g': shift = 30; end++; break;
+    }
+
+    if(errno || end == s || *end != '\0' || v > (UINT64_MAX >> shift)){
+        return 0;
+    }
+
+    return (uint64_t)v << shift;
+}
+
+/* Parse a rate in [0, 1]. Return -1 if s is not one */
+static double parse_rate(const char *s){
+
+    char *end = NULL;
+    double v = strtod(s, &end);
+
+    return end != s && *end == '\0' && v >= 0 && v <= 1 ? v : -1;
+}
+
+/* Parse LEN, MIN-MAX or MEAN~SD into o. Return 0, or -1 if s is none of
+them */
+static int parse_length(const char *s, synth_opts *o){
+
+    char *end = NULL;
+    unsigned long long a = strtoull(s, &end, 10);
+
+    if(end == s || a == 0){
+        return -1;
+    }
+
+    if(*end == '\0'){
+        o->len_dist = SYNTH_FIXED;
+        o->len_mean = a;
+        return 0;
+    }
+
+    char sep = *end;
+    const char *rest = end + 1;
+    unsigned long long b = strtoull(rest, &end, 10);
+
+    if(end == rest || *end != '\0'){
+        return -1;
+    }
+
+    if(sep == '-' && b >= a){
+        o->len_dist = SYNTH_UNIFORM;
+        o->len_min = a;
+        o->len_max = b;
+        return 0;
+    }
+
+    if(sep == '~'){
+        o->len_dist = SYNTH_LOGNORMAL;
+        o->len_mean = a;
+        o->len_sd = b;
+        return 0;
+    }
+
+    return -1;
+}
+
+
+int main(int argc, char *argv[]){
+
+    double start_time = omp_get_wtime();
+
+    /* Options */
+
+    // FASTA changes the default length, so it is known before the rest
+    int fasta = 0;
+    for(int i = 1; i < argc; i++){
+        fasta |= strcmp(argv[i], "-f") == 0;
+    }
+
+    synth_opts o;
+    synth_defaults(&o, fasta);
+
+    uint64_t target = parse_size(DEFAULT_SIZE);
+    uint64_t num_records = UINT64_MAX;
+
+    int c;
+    while((c = getopt(argc, argv, "S:n:s:fl:g:N:q:Q:P:d:a:A:G:w:")) != -1){
+        switch(c){
+            case 'S':
+                if((target = parse_size(optarg)) == 0){
+                    print_usage_and_exit(argv[0]);
+                }
+                break;
+            case 'n':
+                if((num_records = parse_size(optarg)) == 0){
+                    print_usage_and_exit(argv[0]);
+                }
+                target = UINT64_MAX;
+                break;
+            case 's': o.seed = strtoull(optarg, NULL, 10); break;
+            case 'f': break;
+            case 'l':
+                if(parse_length(optarg, &o) != 0){
+                    print_usage_and_exit(argv[0]);
+                }
+                break;
+            case 'g': o.gc = parse_rate(optarg); break;
+            case 'N': o.n_rate = parse_rate(optarg); break;
+            case 'q':
+                if(strcmp(optarg, "illumina") == 0){
+                    o.qual = SYNTH_QUAL_ILLUMINA;
+                }else if(strcmp(optarg, "binned") == 0){
+                    o.qual = SYNTH_QUAL_BINNED;
+                }else if(strcmp(optarg, "flat") == 0){
+                    o.qual = SYNTH_QUAL_FLAT;
+                }else if(strcmp(optarg, "long") == 0){
+                    o.qual = SYNTH_QUAL_LONG;
+                }else{
+                    print_usage_and_exit(argv[0]);
+                }
+                break;
+            case 'Q': o.qual_max = atoi(optarg); break;
+            case 'P': o.qual_offset = atoi(optarg); break;
+            case 'd': o.dup_rate = parse_rate(optarg); break;
+            case 'a': o.adapter_rate = parse_rate(optarg); break;
+            case 'A': o.adapter = optarg; break;
+            case 'G': o.genome_len = parse_size(optarg); break;
+            case 'w': o.line_width = parse_size(optarg); break;
+            default : print_usage_and_exit(argv[0]);
+        }
+    }
+
+    if(optind + 1 != argc){
+        print_usage_and_exit(argv[0]);
+    }
+
+    synth *g = synth_new(&o);
+
+    if(!g){
+        if(errno == ENOMEM){
+            fprintf(stderr, "out of memory\n");
+        }else{
+            fprintf(stderr, "x Invalid generator options\n");
+        }
+        return EXIT_FAILURE;
+    }
+
+    /* Open output */
+
+    const char *path = argv[optind];
+    FILE *out = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+
+    if(!out){
+        perror("fopen");
+        fprintf(stderr, "x Failed to open '%s'\n", path);
+        return EXIT_FAILURE;
+    }
+
+    /* Generate chunks in parallel and write them in order */
+
+    // A chunk's records depend only on the options, and output stops
+    // after the first chunk that reaches the target, so the file is the
+    // same whatever the thread count
+    uint64_t per_chunk = synth_chunk_records(g, CHUNK_BYTES);
+    uint64_t round = 4 * (uint64_t)omp_get_max_threads();
+    uint64_t written = 0;
+    uint64_t records = 0;
+    int done = 0;
+    int failed = 0; // -1 out of memory, -2 write error
+
+    #pragma omp parallel
+    {
+        char *buf = NULL;
+        size_t cap = 0;
+
+        for(uint64_t base = 0; !__atomic_load_n(&done, __ATOMIC_RELAXED); base += round){
+
+            #pragma omp for ordered schedule(dynamic)
+            for(uint64_t k = base; k < base + round; k++){
+
+                uint64_t first = k * per_chunk;
+                uint64_t n = 0;
+                size_t len = 0;
+                int ok = 1;
+
+                if(first < num_records){
+                    n = num_records - first < per_chunk ? num_records - first : per_chunk;
+                }
+
+                // Chunks past the end still pass through ordered below
+                if(n && !__atomic_load_n(&done, __ATOMIC_RELAXED)){
+                    ok = synth_records(g, first, n, &buf, &len, &cap) == 0;
+                }
+
+                #pragma omp ordered
+                {
+                    if(!done){
+                        if(!ok){
+                            failed = -1;
+                            __atomic_store_n(&done, 1, __ATOMIC_RELAXED);
+                        }else if(n == 0){
+                            __atomic_store_n(&done, 1, __ATOMIC_RELAXED);
+                        }else if(fwrite(buf, 1, len, out) != len){
+                            failed = -2;
+                            __atomic_store_n(&done, 1, __ATOMIC_RELAXED);
+                        }else{
+                            written += len;
+                            records += n;
+                            if(written >= target || records >= num_records){
+                                __atomic_store_n(&done, 1, __ATOMIC_RELAXED);
+                            }
+                        }
+                    }
+                }
+
+            }
+
+        }
+
+        free(buf);
+    }
+
+    if(out != stdout ? fclose(out) != 0 : fflush(out) != 0){
+        failed = -2;
+    }
+
+    synth_free(g);
+
+    if(failed == -1){
+        fprintf(stderr, "out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    if(failed == -2){
+        perror("fwrite");
+        fprintf(stderr, "x Failed to write '%s'\n", path);
+        return EXIT_FAILURE;
+    }
+
+    fprintf(stderr, "Wrote %llu %s, %.3f GB in %.3f s\n", (unsigned long long)records,
+            fasta ? "contigs" : "reads", written / 1e9, omp_get_wtime() - start_time);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,377 @@
+// Synthetic reads and contigs, each drawn from its own random stream.
+
+#include "synth.h"
+
+#include <errno.h>
+#include <math.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GENOME_BLOCK 65536   // genome bases drawn from one stream
+#define DUP_WINDOW 100000    // duplicates copy one of this many reads before them
+#define TILE_READS 4096      // reads per tile in the read names
+#define TILES 48             // tiles per lane, 24 on each surface
+#define LANES 4
+#define NAME_MAX_LEN 96
+
+// What a stream is for, so a record's streams never overlap.
+enum { KIND_GENOME, KIND_LAYOUT, KIND_READ, KIND_CONTIG };
+
+struct synth {
+    synth_opts o;
+    char* genome;
+    size_t adapter_len;
+    uint32_t gc_cut;  // a 15-bit draw below this gives G or C
+};
+
+// splitmix64: a 64-bit counter run through a strong mixer, so streams
+// started from nearby states are still unrelated.
+typedef struct {
+    uint64_t s;
+} rng;
+
+static uint64_t next(rng* r) {
+    uint64_t z = (r->s += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static double uniform(rng* r) {
+    return (next(r) >> 11) * 0x1p-53;
+}
+
+static rng stream(uint64_t seed, uint64_t index, int kind) {
+    rng r = {seed};
+    r.s = next(&r) ^ (index * 4 + kind);
+    r.s = next(&r);
+    return r;
+}
+
+// Bases to the next N when each base is one with chance p.
+static size_t n_gap(rng* r, double p) {
+    if (p <= 0) {
+        return SIZE_MAX;
+    }
+    if (p >= 1) {
+        return 0;
+    }
+    double gap = floor(log(1.0 - uniform(r)) / log(1.0 - p));
+    return gap < (double)SIZE_MAX / 2 ? (size_t)gap : SIZE_MAX;
+}
+
+// Write len random bases with the generator's GC content, four per draw.
+static void fill_bases(const synth* g, rng* r, char* out, size_t len) {
+    size_t i = 0;
+    while (i < len) {
+        uint64_t bits = next(r);
+        for (int k = 0; k < 4 && i < len; k++, i++, bits >>= 16) {
+            int gc = (uint32_t)(bits >> 1 & 0x7FFF) < g->gc_cut;
+            out[i] = gc ? "CG"[bits & 1] : "AT"[bits & 1];
+        }
+    }
+}
+
+static size_t mean_len(const synth_opts* o) {
+    return o->len_dist == SYNTH_UNIFORM ? (o->len_min + o->len_max) / 2 : o->len_mean;
+}
+
+static size_t draw_len(const synth* g, rng* r) {
+    const synth_opts* o = &g->o;
+    double len = (double)o->len_mean;
+
+    if (o->len_dist == SYNTH_UNIFORM) {
+        len = (double)(o->len_min + next(r) % (o->len_max - o->len_min + 1));
+    } else if (o->len_dist == SYNTH_LOGNORMAL) {
+        double m = (double)o->len_mean;
+        double s = (double)o->len_sd;
+        double var = log(1.0 + s * s / (m * m));
+        double z = sqrt(-2.0 * log(1.0 - uniform(r))) * cos(2.0 * M_PI * uniform(r));
+        len = exp(log(m) - var / 2 + sqrt(var) * z);
+    }
+
+    if (o->len_min > 0 && len < (double)o->len_min) {
+        len = (double)o->len_min;
+    }
+    if (o->len_max > 0 && len > (double)o->len_max) {
+        len = (double)o->len_max;
+    }
+    if (!o->fasta && len > (double)o->genome_len) {
+        len = (double)o->genome_len;
+    }
+    return len < 1 ? 1 : (size_t)len;
+}
+
+void synth_defaults(synth_opts* o, int fasta) {
+    memset(o, 0, sizeof *o);
+    o->seed = 1;
+    o->fasta = fasta;
+    o->len_dist = SYNTH_FIXED;
+    o->len_mean = fasta ? 1000000 : 150;
+    o->gc = 0.5;
+    o->n_rate = 0.001;
+    o->qual = SYNTH_QUAL_ILLUMINA;
+    o->qual_max = 41;
+    o->qual_offset = 33;
+    o->adapter = SYNTH_ADAPTER;
+    o->genome_len = 4000000;
+    o->line_width = 60;
+}
+
+static int valid(const synth_opts* o) {
+    int max_q = o->qual_offset == 33 ? 93 : 62;  // up to '~'
+    return (o->qual_offset == 33 || o->qual_offset == 64) &&
+           o->qual_max >= 2 && o->qual_max <= max_q &&
+           o->gc >= 0 && o->gc <= 1 && o->n_rate >= 0 && o->n_rate <= 1 &&
+           o->dup_rate >= 0 && o->dup_rate <= 1 &&
+           o->adapter_rate >= 0 && o->adapter_rate <= 1 &&
+           o->adapter != NULL && o->adapter[0] != '\0' &&
+           o->line_width > 0 && (o->fasta || o->genome_len > 0) &&
+           (o->len_dist == SYNTH_UNIFORM ? o->len_min > 0 && o->len_min <= o->len_max
+                                         : o->len_mean > 0) &&
+           (o->len_max == 0 || o->len_min <= o->len_max);
+}
+
+synth* synth_new(const synth_opts* o) {
+    if (!valid(o)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    synth* g = calloc(1, sizeof(synth));
+    if (g == NULL) {
+        return NULL;
+    }
+    g->o = *o;
+    g->adapter_len = strlen(o->adapter);
+    g->gc_cut = (uint32_t)(o->gc * 32768.0 + 0.5);
+
+    // Contigs are fresh sequence; only reads need a genome.
+    if (o->fasta) {
+        return g;
+    }
+
+    g->genome = malloc(o->genome_len);
+    if (g->genome == NULL) {
+        free(g);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    size_t blocks = (o->genome_len + GENOME_BLOCK - 1) / GENOME_BLOCK;
+
+    #pragma omp parallel for schedule(static)
+    for (size_t b = 0; b < blocks; b++) {
+        rng r = stream(o->seed, b, KIND_GENOME);
+        size_t from = b * GENOME_BLOCK;
+        size_t len = o->genome_len - from < GENOME_BLOCK ? o->genome_len - from : GENOME_BLOCK;
+        fill_bases(g, &r, g->genome + from, len);
+    }
+
+    return g;
+}
+
+void synth_free(synth* g) {
+    if (g != NULL) {
+        free(g->genome);
+        free(g);
+    }
+}
+
+size_t synth_chunk_records(const synth* g, size_t bytes) {
+    const synth_opts* o = &g->o;
+    size_t len = mean_len(o);
+    size_t per = o->fasta ? len + len / o->line_width + 64 : 2 * len + 64;
+    return bytes / per > 0 ? bytes / per : 1;
+}
+
+// Where a read's bases come from. A duplicate takes the layout of an
+// earlier read, following duplicates back to the first of them.
+typedef struct {
+    size_t pos;     // first genome base of the fragment
+    size_t len;     // read length
+    size_t insert;  // genome bases read before running into adapter
+    int rev;        // read from the reverse strand
+} layout;
+
+static void read_layout(const synth* g, uint64_t idx, layout* l) {
+    const synth_opts* o = &g->o;
+    for (;;) {
+        rng r = stream(o->seed, idx, KIND_LAYOUT);
+        if (idx > 0 && uniform(&r) < o->dup_rate) {
+            idx -= 1 + next(&r) % (idx < DUP_WINDOW ? idx : DUP_WINDOW);
+            continue;
+        }
+        l->len = draw_len(g, &r);
+        l->pos = next(&r) % (o->genome_len - l->len + 1);
+        l->rev = (int)(next(&r) & 1);
+        l->insert = uniform(&r) < o->adapter_rate ? next(&r) % l->len : l->len;
+        return;
+    }
+}
+
+// Complement of a genome base: bits 1-2 of A, C, T and G are 0, 1, 2, 3.
+static char complement(char b) {
+    return "TGAC"[b >> 1 & 3];
+}
+
+// Write v in decimal at p and return the end, in place of sprintf, which
+// would cost as much as the rest of a short read.
+static char* put_uint(char* p, uint64_t v) {
+    char digits[20];
+    int n = 0;
+    do {
+        digits[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v > 0);
+    while (n > 0) {
+        *p++ = digits[--n];
+    }
+    return p;
+}
+
+static char* put_str(char* p, const char* s) {
+    size_t len = strlen(s);
+    memcpy(p, s, len);
+    return p + len;
+}
+
+// Phred score of base i of a read under the quality profile, from 16
+// random bits; fall is 12 / len^2, so scores drop by 12 over the read.
+static int base_qual(const synth_opts* o, unsigned bits, size_t i, double fall) {
+    int q;
+
+    if (o->qual == SYNTH_QUAL_FLAT) {
+        return o->qual_max;
+    }
+    if (o->qual == SYNTH_QUAL_LONG) {
+        q = 6 + (int)(bits % 16) + (int)(bits >> 4 & 3);
+    } else {
+        q = o->qual_max - 3 - (int)(fall * (double)(i * i)) + (int)(bits & 7) - 4;
+        // The odd low-quality base anywhere in the read
+        if ((bits >> 3 & 63) == 0) {
+            q = 2 + (int)(bits >> 9 & 15);
+        }
+        if (o->qual == SYNTH_QUAL_BINNED) {
+            q = q < 7 ? 2 : q < 18 ? 12 : q < 30 ? 23 : 37;
+        }
+    }
+    return q < 2 ? 2 : q > o->qual_max ? o->qual_max : q;
+}
+
+static int ensure(char** buf, size_t len, size_t* cap, size_t more) {
+    if (*cap - len >= more) {
+        return 0;
+    }
+    size_t want = *cap * 2 > len + more ? *cap * 2 : len + more;
+    char* grown = realloc(*buf, want);
+    if (grown == NULL) {
+        return -1;
+    }
+    *buf = grown;
+    *cap = want;
+    return 0;
+}
+
+static size_t write_read(const synth* g, uint64_t idx, const layout* lp, char* out) {
+    const synth_opts* o = &g->o;
+    layout l = *lp;
+    rng r = stream(o->seed, idx, KIND_READ);
+    uint64_t tile = idx / TILE_READS % TILES;
+    uint64_t lane = 1 + idx / (TILE_READS * TILES) % LANES;
+    uint64_t xy = next(&r);
+    char* p = out;
+
+    p = put_str(p, "@SYN01:1:HSYNTHXX:");
+    p = put_uint(p, lane);
+    *p++ = ':';
+    p = put_uint(p, (tile < TILES / 2 ? 1101 : 2101) + tile % (TILES / 2));
+    *p++ = ':';
+    p = put_uint(p, 1000 + (xy & 0xFFFF) % 30000);
+    *p++ = ':';
+    p = put_uint(p, 1000 + (xy >> 16 & 0xFFFF) % 30000);
+    p = put_str(p, " 1:N:0:ACGTACGT\n");
+
+    // Insert, then adapter, then whatever follows the adapter
+    char* seq = p;
+    const char* frag = g->genome + l.pos;
+    for (size_t i = 0; i < l.insert; i++) {
+        seq[i] = l.rev ? complement(frag[l.insert - 1 - i]) : frag[i];
+    }
+    size_t ad = l.len - l.insert < g->adapter_len ? l.len - l.insert : g->adapter_len;
+    memcpy(seq + l.insert, o->adapter, ad);
+    fill_bases(g, &r, seq + l.insert + ad, l.len - l.insert - ad);
+
+    for (size_t i = n_gap(&r, o->n_rate); i < l.len; i += 1 + n_gap(&r, o->n_rate)) {
+        seq[i] = 'N';
+    }
+    p += l.len;
+
+    memcpy(p, "\n+\n", 3);
+    p += 3;
+
+    double fall = 12.0 / ((double)l.len * (double)l.len);
+    uint64_t bits = 0;
+    for (size_t i = 0; i < l.len; i++, bits >>= 16) {
+        if (i % 4 == 0) {
+            bits = next(&r);
+        }
+        int q = seq[i] == 'N' ? 2 : base_qual(o, (unsigned)(bits & 0xFFFF), i, fall);
+        p[i] = (char)(o->qual_offset + q);
+    }
+    p += l.len;
+    *p++ = '\n';
+
+    return (size_t)(p - out);
+}
+
+static size_t write_contig(const synth* g, uint64_t idx, size_t len, rng* r, char* out) {
+    const synth_opts* o = &g->o;
+    double p_run = o->n_rate / SYNTH_N_RUN;
+    char* p = out + sprintf(out, ">synth_contig_%llu len=%zu\n", (unsigned long long)idx, len);
+    size_t to_run = n_gap(r, p_run);
+    size_t in_run = 0;
+
+    for (size_t done = 0; done < len;) {
+        size_t line = len - done < o->line_width ? len - done : o->line_width;
+        fill_bases(g, r, p, line);
+        for (size_t i = 0; i < line; i++) {
+            if (in_run == 0 && to_run-- == 0) {
+                in_run = SYNTH_N_RUN;
+                to_run = n_gap(r, p_run);
+            }
+            if (in_run > 0) {
+                p[i] = 'N';
+                in_run--;
+            }
+        }
+        p[line] = '\n';
+        p += line + 1;
+        done += line;
+    }
+
+    return (size_t)(p - out);
+}
+
+int synth_records(const synth* g, uint64_t first, size_t n, char** buf, size_t* len, size_t* cap) {
+    for (uint64_t idx = first; idx < first + n; idx++) {
+        if (g->o.fasta) {
+            rng r = stream(g->o.seed, idx, KIND_CONTIG);
+            size_t clen = draw_len(g, &r);
+            if (ensure(buf, *len, cap, NAME_MAX_LEN + clen + clen / g->o.line_width + 1) != 0) {
+                return -1;
+            }
+            *len += write_contig(g, idx, clen, &r, *buf + *len);
+        } else {
+            layout l;
+            read_layout(g, idx, &l);
+            if (ensure(buf, *len, cap, NAME_MAX_LEN + 2 * l.len + 4) != 0) {
+                return -1;
+            }
+            *len += write_read(g, idx, &l, *buf + *len);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,79 @@
+// Synthetic FASTQ and FASTA for tests and benchmarks.
+//
+// Every record is generated from the seed and its own index alone, so
+// any range of records can be made on any thread, in any order, and the
+// output is the same byte for byte whatever the thread count. Reads are
+// sampled from both strands of a random genome built from the seed, with
+// Illumina-style names, a chosen length distribution, GC content, N
+// rate and quality profile, and optionally duplicated or run through
+// into adapter. FASTA records are contigs of fresh sequence with runs of
+// N, wrapped to a fixed line width.
+
+#ifndef _SYNTH_H
+#define _SYNTH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    SYNTH_FIXED,      // every read len_mean long
+    SYNTH_UNIFORM,    // uniform in [len_min, len_max]
+    SYNTH_LOGNORMAL,  // lognormal with mean len_mean and sd len_sd, as long reads are
+} synth_len_dist;
+
+typedef enum {
+    SYNTH_QUAL_ILLUMINA,  // high, falling off towards the 3' end
+    SYNTH_QUAL_BINNED,    // the same on the four NovaSeq bins 2, 12, 23, 37
+    SYNTH_QUAL_FLAT,      // qual_max everywhere
+    SYNTH_QUAL_LONG,      // low and noisy, as nanopore reads are
+} synth_qual;
+
+typedef struct {
+    uint64_t seed;
+    int fasta;                // contigs instead of reads
+    synth_len_dist len_dist;
+    size_t len_mean;
+    size_t len_sd;
+    size_t len_min;
+    size_t len_max;
+    double gc;                // chance a base is G or C
+    double n_rate;            // chance a base is N (in runs of SYNTH_N_RUN for FASTA)
+    synth_qual qual;
+    int qual_max;             // highest Phred score written
+    int qual_offset;          // 33 or 64
+    double dup_rate;          // chance a read repeats the bases of a recent one
+    double adapter_rate;      // chance a read's insert is shorter than the read
+    const char* adapter;
+    size_t genome_len;        // reads are sampled from this much sequence
+    size_t line_width;        // FASTA bases per line
+} synth_opts;
+
+#define SYNTH_N_RUN 100           // length of the N runs in FASTA contigs
+#define SYNTH_ADAPTER "AGATCGGAAGAGC" // Illumina TruSeq adapter start
+
+// Generator structure: create with synth_new, free with synth_free.
+typedef struct synth synth;
+
+// Set o to the defaults: 150 base Illumina reads (or 1 Mb contigs if
+// fasta is set) at 50% GC with one N per thousand bases, from a 4 Mb
+// genome, seed 1.
+void synth_defaults(synth_opts* o, int fasta);
+
+// Build the genome for o and return a generator, or NULL if out of
+// memory or o is not valid (errno is then ENOMEM or EINVAL). The options
+// are copied.
+synth* synth_new(const synth_opts* o);
+
+// Free generator.
+void synth_free(synth* g);
+
+// Append records [first, first + n) as text to *buf, which holds *len
+// bytes of *cap and is grown with realloc as needed. Return 0, or -1 if
+// out of memory.
+int synth_records(const synth* g, uint64_t first, size_t n, char** buf, size_t* len, size_t* cap);
+
+// Records to generate at a time for about bytes bytes of output; depends
+// only on the options, so splitting work by it keeps output reproducible.
+size_t synth_chunk_records(const synth* g, size_t bytes);
+
+#endif // _SYNTH_H
@@ -0,0 +1,342 @@
+// Sequential file input through io_uring, or pread where io_uring is
+// unavailable.
+
+#include "aio.h"
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define DEFAULT_CHUNK (1u << 20)  // bytes per read
+#define DEFAULT_DEPTH 8           // reads in flight
+#define MAX_DEPTH 64
+
+// One chunk buffer. Slots are filled in file order, round robin.
+typedef struct {
+    char* buf;
+    off_t off;          // file offset read into buf
+    ssize_t res;        // bytes read, or -errno
+    size_t pos;         // bytes already copied out
+    bool busy;          // read queued but not completed
+} slot;
+
+// Reader structure: create with aio_open, free with aio_close.
+struct aio_reader {
+    int fd;
+    size_t chunk;
+    int depth;
+    bool eof;
+
+    // pread only
+    off_t pos;          // offset of the next read
+
+    // io_uring only. The submission and completion rings are shared with
+    // the kernel; only the tail of one and the head of the other are ours.
+    int ring;           // -1 when using pread
+    slot* slots;
+    int cur;            // slot holding the next bytes in file order
+    off_t next_off;     // offset of the next chunk to queue
+    void* sq_map;
+    size_t sq_len;
+    void* cq_map;
+    size_t cq_len;
+    struct io_uring_sqe* sqes;
+    size_t sqes_len;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;
+};
+
+static int ring_setup(unsigned entries, struct io_uring_params* p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int ring_enter(int ring, unsigned submit, unsigned wait,
+                      unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, ring, submit, wait, flags,
+                        NULL, 0);
+}
+
+// Map the rings of a fresh io_uring instance. Return false (leaving the
+// reader on pread) if the kernel refuses any step.
+static bool open_ring(aio_reader* a) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof p);
+    int ring = ring_setup((unsigned)a->depth, &p);
+    if (ring < 0) {
+        return false;
+    }
+
+    a->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    a->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (single) {
+        if (a->cq_len > a->sq_len) {
+            a->sq_len = a->cq_len;
+        }
+        a->cq_len = a->sq_len;
+    }
+
+    a->sq_map = mmap(NULL, a->sq_len, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+    a->cq_map = a->sq_map;
+    if (a->sq_map != MAP_FAILED && !single) {
+        a->cq_map = mmap(NULL, a->cq_len, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+    }
+    a->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    a->sqes = MAP_FAILED;
+    if (a->sq_map != MAP_FAILED && a->cq_map != MAP_FAILED) {
+        a->sqes = mmap(NULL, a->sqes_len, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+    }
+
+    if (a->sqes == MAP_FAILED) {
+        if (a->cq_map != MAP_FAILED && a->cq_map != a->sq_map) {
+            munmap(a->cq_map, a->cq_len);
+        }
+        if (a->sq_map != MAP_FAILED) {
+            munmap(a->sq_map, a->sq_len);
+        }
+        close(ring);
+        return false;
+    }
+
+    char* sq = a->sq_map;
+    char* cq = a->cq_map;
+    a->sq_tail = (unsigned*)(sq + p.sq_off.tail);
+    a->sq_mask = (unsigned*)(sq + p.sq_off.ring_mask);
+    a->sq_array = (unsigned*)(sq + p.sq_off.array);
+    a->cq_head = (unsigned*)(cq + p.cq_off.head);
+    a->cq_tail = (unsigned*)(cq + p.cq_off.tail);
+    a->cq_mask = (unsigned*)(cq + p.cq_off.ring_mask);
+    a->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+    a->ring = ring;
+    return true;
+}
+
+// Queue a read of the chunk at a->next_off into slot i.
+static void submit(aio_reader* a, int i) {
+    slot* s = &a->slots[i];
+    s->off = a->next_off;
+    s->pos = 0;
+    s->busy = true;
+    a->next_off += (off_t)a->chunk;
+
+    unsigned tail = *a->sq_tail;
+    unsigned idx = tail & *a->sq_mask;
+    struct io_uring_sqe* e = &a->sqes[idx];
+    memset(e, 0, sizeof *e);
+    e->opcode = IORING_OP_READ;
+    e->fd = a->fd;
+    e->off = (uint64_t)s->off;
+    e->addr = (uint64_t)(uintptr_t)s->buf;
+    e->len = (uint32_t)a->chunk;
+    e->user_data = (uint64_t)i;
+    a->sq_array[idx] = idx;
+    __atomic_store_n(a->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    while (ring_enter(a->ring, 1, 0, 0) < 0) {
+        if (errno != EINTR && errno != EAGAIN) {
+            s->res = -errno;
+            s->busy = false;
+            return;
+        }
+    }
+}
+
+// Finish a chunk the kernel read only part of (or, on kernels without
+// IORING_OP_READ, none of) with pread, so a chunk that comes back short
+// always means end of file.
+static void complete_short(aio_reader* a, slot* s) {
+    if (s->res == -EINVAL || s->res == -EOPNOTSUPP) {
+        s->res = 0;
+    }
+    while (s->res >= 0 && (size_t)s->res < a->chunk) {
+        ssize_t n = pread(a->fd, s->buf + s->res, a->chunk - (size_t)s->res,
+                          s->off + s->res);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            s->res = -errno;
+        } else if (n == 0) {
+            break;
+        } else {
+            s->res += n;
+        }
+    }
+}
+
+// Wait for at least one completion and record it in its slot.
+// Return 0, or -1 if waiting failed.
+static int reap(aio_reader* a) {
+    unsigned head = *a->cq_head;
+    unsigned tail = __atomic_load_n(a->cq_tail, __ATOMIC_ACQUIRE);
+
+    while (head == tail) {
+        if (ring_enter(a->ring, 0, 1, IORING_ENTER_GETEVENTS) < 0 &&
+            errno != EINTR) {
+            return -1;
+        }
+        tail = __atomic_load_n(a->cq_tail, __ATOMIC_ACQUIRE);
+    }
+
+    // At most depth reads are ever in flight.
+    int done[MAX_DEPTH];
+    int ndone = 0;
+    for (; head != tail; head++) {
+        struct io_uring_cqe* c = &a->cqes[head & *a->cq_mask];
+        slot* s = &a->slots[c->user_data];
+        s->res = c->res;
+        s->busy = false;
+        done[ndone++] = (int)c->user_data;
+    }
+    __atomic_store_n(a->cq_head, head, __ATOMIC_RELEASE);
+
+    for (int i = 0; i < ndone; i++) {
+        complete_short(a, &a->slots[done[i]]);
+    }
+    return 0;
+}
+
+aio_reader* aio_open(int fd, size_t chunk, int depth, int use_uring) {
+    aio_reader* a = calloc(1, sizeof(aio_reader));
+    if (a == NULL) {
+        return NULL;
+    }
+    a->fd = fd;
+    a->chunk = chunk ? chunk : DEFAULT_CHUNK;
+    a->depth = depth > 0 ? depth : DEFAULT_DEPTH;
+    if (a->depth > MAX_DEPTH) {
+        a->depth = MAX_DEPTH;
+    }
+    a->ring = -1;
+
+    if (!use_uring || !open_ring(a)) {
+        return a;
+    }
+
+    a->slots = calloc((size_t)a->depth, sizeof(slot));
+    bool ok = a->slots != NULL;
+    for (int i = 0; ok && i < a->depth; i++) {
+        a->slots[i].buf = malloc(a->chunk);
+        ok = a->slots[i].buf != NULL;
+    }
+    if (!ok) {
+        aio_close(a);
+        return NULL;
+    }
+
+    for (int i = 0; i < a->depth; i++) {
+        submit(a, i);
+    }
+    return a;
+}
+
+// aio_read for the pread backend: read straight into buf.
+static ssize_t read_direct(aio_reader* a, char* buf, size_t len) {
+    size_t got = 0;
+    while (got < len && !a->eof) {
+        ssize_t n = pread(a->fd, buf + got, len - got, a->pos);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return -1;
+        }
+        if (n == 0) {
+            a->eof = true;
+        }
+        a->pos += n;
+        got += (size_t)n;
+    }
+    return (ssize_t)got;
+}
+
+ssize_t aio_read(aio_reader* a, void* buf, size_t len) {
+    if (a->ring < 0) {
+        return read_direct(a, buf, len);
+    }
+
+    char* out = buf;
+    size_t got = 0;
+    while (got < len && !a->eof) {
+        slot* s = &a->slots[a->cur];
+        while (s->busy) {
+            if (reap(a) != 0) {
+                return -1;
+            }
+        }
+        if (s->res < 0) {
+            errno = (int)-s->res;
+            return -1;
+        }
+
+        size_t n = (size_t)s->res - s->pos;
+        if (n > len - got) {
+            n = len - got;
+        }
+        memcpy(out + got, s->buf + s->pos, n);
+        s->pos += n;
+        got += n;
+
+        if (s->pos == (size_t)s->res) {
+            // A short chunk is the end of the file; otherwise the slot
+            // goes back to the kernel for the chunk after the last queued.
+            if ((size_t)s->res < a->chunk) {
+                a->eof = true;
+            } else {
+                submit(a, a->cur);
+                a->cur = (a->cur + 1) % a->depth;
+            }
+        }
+    }
+    return (ssize_t)got;
+}
+
+const char* aio_backend(const aio_reader* a) {
+    return a->ring >= 0 ? "io_uring" : "pread";
+}
+
+void aio_close(aio_reader* a) {
+    if (a == NULL) {
+        return;
+    }
+    if (a->ring >= 0) {
+        // The kernel may still be writing into queued buffers.
+        bool busy = true;
+        while (busy && a->slots != NULL) {
+            busy = false;
+            for (int i = 0; i < a->depth; i++) {
+                busy |= a->slots[i].busy;
+            }
+            if (busy && reap(a) != 0) {
+                break;
+            }
+        }
+        munmap(a->sqes, a->sqes_len);
+        if (a->cq_map != a->sq_map) {
+            munmap(a->cq_map, a->cq_len);
+        }
+        munmap(a->sq_map, a->sq_len);
+        close(a->ring);
+    }
+    if (a->slots != NULL) {
+        for (int i = 0; i < a->depth; i++) {
+            free(a->slots[i].buf);
+        }
+        free(a->slots);
+    }
+    free(a);
+}
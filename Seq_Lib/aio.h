@@ -0,0 +1,36 @@
+// Sequential file input with several large reads in flight.
+//
+// The file is read in fixed-size chunks through io_uring, with up to
+// depth chunks queued at the device at once, so the disk queue stays
+// full while the caller parses. When io_uring is unavailable (old
+// kernel, seccomp filter, io_uring_disabled) plain pread is used
+// instead. io_uring is driven through its raw system calls, so nothing
+// beyond the kernel headers is needed.
+
+#ifndef _AIO_H
+#define _AIO_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+// Reader structure: create with aio_open, free with aio_close.
+typedef struct aio_reader aio_reader;
+
+// Start reading file fd from its beginning in chunks of chunk bytes with
+// up to depth reads in flight (0 picks defaults for either). If use_uring
+// is 0 pread is used even when io_uring is available. Return the reader,
+// or NULL if out of memory. fd stays owned by the caller.
+aio_reader* aio_open(int fd, size_t chunk, int depth, int use_uring);
+
+// Copy up to len bytes of the file, continuing where the last call
+// stopped, into buf. Return the bytes copied, 0 at end of file, or -1 on
+// a read error (errno is set).
+ssize_t aio_read(aio_reader* a, void* buf, size_t len);
+
+// "io_uring" or "pread", whichever a is using.
+const char* aio_backend(const aio_reader* a);
+
+// Cancel outstanding reads and free reader.
+void aio_close(aio_reader* a);
+
+#endif // _AIO_H
@@ -0,0 +1,98 @@
+// Bump allocator carving allocations out of large slabs.
+
+#include "arena.h"
+
+#include <stdalign.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_SLAB_SIZE (1u << 20)
+#define ALIGN alignof(max_align_t)
+
+struct arena_slab {
+    arena_slab* next;   // previously filled slab
+    size_t cap;         // bytes available in data
+    size_t off;         // bytes already handed out
+    alignas(max_align_t) unsigned char data[];
+};
+
+void arena_init(arena* a, size_t slab_size) {
+    a->head = NULL;
+    a->slab_size = slab_size ? slab_size : DEFAULT_SLAB_SIZE;
+    a->nslabs = 0;
+    a->used = 0;
+}
+
+// Hand out size bytes at an offset that is a multiple of align (a power
+// of two), starting a new slab when the current one is too full.
+static void* carve(arena* a, size_t size, size_t align) {
+    arena_slab* s = a->head;
+    size_t off = s ? (s->off + align - 1) & ~(align - 1) : 0;
+
+    if (s == NULL || off > s->cap || s->cap - off < size) {
+        size_t cap = size > a->slab_size ? size : a->slab_size;
+        s = malloc(sizeof(arena_slab) + cap);
+        if (s == NULL) {
+            return NULL;
+        }
+        s->cap = cap;
+        s->off = 0;
+        off = 0;
+
+        // An oversized slab goes behind the current one, which may still
+        // have room for later small requests.
+        if (a->head != NULL && cap > a->slab_size) {
+            s->next = a->head->next;
+            a->head->next = s;
+        } else {
+            s->next = a->head;
+            a->head = s;
+        }
+        a->nslabs++;
+    }
+
+    void* p = s->data + off;
+    s->off = off + size;
+    a->used += size;
+    return p;
+}
+
+void* arena_alloc(arena* a, size_t size) {
+    return carve(a, size, ALIGN);
+}
+
+char* arena_strndup(arena* a, const char* s, size_t len) {
+    char* copy = carve(a, len + 1, 1);  // strings need no alignment
+    if (copy == NULL) {
+        return NULL;
+    }
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+void arena_reset(arena* a) {
+    arena_slab* keep = a->head;
+    if (keep == NULL) {
+        return;
+    }
+    arena_slab* s = keep->next;
+    while (s != NULL) {
+        arena_slab* next = s->next;
+        free(s);
+        s = next;
+    }
+    keep->next = NULL;
+    keep->off = 0;
+    a->used = 0;
+}
+
+void arena_free(arena* a) {
+    arena_slab* s = a->head;
+    while (s != NULL) {
+        arena_slab* next = s->next;
+        free(s);
+        s = next;
+    }
+    arena_init(a, a->slab_size);
+}
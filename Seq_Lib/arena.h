@@ -0,0 +1,39 @@
+// Bump allocator: many small allocations carved from large slabs and
+// released together with a single arena_free. fq_next unpacks the reads
+// of a read cache into one; the tools' per-read fields live in read
+// batches (readbatch.h) or are views into the reader's buffers.
+
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include <stddef.h>
+
+typedef struct arena_slab arena_slab;
+
+// Arena structure: set up with arena_init, release with arena_free.
+typedef struct {
+    arena_slab* head;   // slab being carved; older slabs chained behind it
+    size_t slab_size;   // size of a regular slab
+    size_t nslabs;      // slabs allocated so far (i.e. calls to malloc)
+    size_t used;        // bytes handed out
+} arena;
+
+// Set up empty arena whose slabs are slab_size bytes (0 picks a default).
+void arena_init(arena* a, size_t slab_size);
+
+// Return size bytes aligned for any type, or NULL if out of memory.
+// Requests larger than a slab get a slab of their own.
+void* arena_alloc(arena* a, size_t size);
+
+// Copy len bytes of s into the arena and NUL-terminate the copy.
+// Return the copy, or NULL if out of memory.
+char* arena_strndup(arena* a, const char* s, size_t len);
+
+// Forget every allocation but keep the newest slab for reuse, so an
+// arena emptied after each batch stops calling malloc.
+void arena_reset(arena* a);
+
+// Release every slab at once. The arena can be reused afterwards.
+void arena_free(arena* a);
+
+#endif // _ARENA_H
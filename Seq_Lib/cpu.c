@@ -0,0 +1,38 @@
+// Runtime CPU feature detection.
+
+#include "cpu.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const char* const NAMES[] = {"scalar", "sse2", "avx2", "avx512"};
+
+cpu_level cpu_detect(void) {
+    cpu_level level = CPU_SCALAR;
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    level = CPU_SSE2;
+    if (__builtin_cpu_supports("avx2")) {
+        level = CPU_AVX2;
+    }
+    if (__builtin_cpu_supports("avx512f") &&
+        __builtin_cpu_supports("avx512bw")) {
+        level = CPU_AVX512;
+    }
+#endif
+
+    const char* cap = getenv("SEQLIB_SIMD");
+    if (cap != NULL) {
+        for (int i = CPU_SCALAR; i <= CPU_AVX512; i++) {
+            if (strcmp(cap, NAMES[i]) == 0 && (cpu_level)i < level) {
+                level = (cpu_level)i;
+            }
+        }
+    }
+    return level;
+}
+
+const char* cpu_level_name(cpu_level level) {
+    return NAMES[level];
+}
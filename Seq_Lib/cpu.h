@@ -0,0 +1,22 @@
+// Runtime CPU feature detection used to pick SIMD kernels.
+
+#ifndef _CPU_H
+#define _CPU_H
+
+// Instruction set levels, each implying the ones below it.
+typedef enum {
+    CPU_SCALAR = 0,
+    CPU_SSE2,       // x86-64 baseline
+    CPU_AVX2,
+    CPU_AVX512,     // AVX-512 F + BW
+} cpu_level;
+
+// Return best level supported by this CPU. Setting the environment
+// variable SEQLIB_SIMD to scalar, sse2, avx2 or avx512 caps the level,
+// which is handy for testing and benchmarking the fallbacks.
+cpu_level cpu_detect(void);
+
+// Return printable name of level.
+const char* cpu_level_name(cpu_level level);
+
+#endif // _CPU_H
@@ -0,0 +1,252 @@
+// Streaming FASTA reader backed by mmap, or by a fixed buffer refilled
+// from zlib for gzip input.
+
+#include "fareader.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define BUF_SIZE (1u << 20)  // bytes inflated at a time
+
+// Reader structure: create with fa_open, free with fa_close.
+struct fa_reader {
+    const char* data;   // mapping, or buffer of inflated bytes
+    size_t len;         // bytes valid at data
+    size_t pos;         // next unread byte
+    bool line_start;    // data[pos] starts a line
+    bool in_record;     // between a header and the next one
+
+    // Mapped input only.
+    void* map;          // NULL for an empty file or gzip input
+
+    // Gzip input only.
+    gzFile gz;
+    char* buf;
+    bool eof;           // gz has no more bytes
+    bool failed;        // gz hit a read error
+    char* name;         // copy of the current record's name
+    size_t name_cap;
+};
+
+fa_reader* fa_open(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    fa_reader* r = calloc(1, sizeof(fa_reader));
+    if (r == NULL) {
+        close(fd);
+        return NULL;
+    }
+    r->line_start = true;
+
+    // Gzip files start with the magic bytes 1f 8b.
+    unsigned char magic[2];
+    if (pread(fd, magic, 2, 0) == 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+        r->buf = malloc(BUF_SIZE);
+        r->gz = r->buf ? gzdopen(fd, "rb") : NULL;
+        if (r->gz == NULL) {
+            close(fd);
+            free(r->buf);
+            free(r);
+            errno = ENOMEM;
+            return NULL;
+        }
+        gzbuffer(r->gz, 1u << 20);
+        r->data = r->buf;
+        return r;
+    }
+
+    // mmap refuses zero-length mappings; an empty file simply has no records.
+    if (st.st_size > 0) {
+        void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            int saved = errno;
+            free(r);
+            close(fd);
+            errno = saved;
+            return NULL;
+        }
+        madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+        r->map = map;
+        r->data = map;
+        r->len = (size_t)st.st_size;
+    }
+
+    // The mapping keeps its own reference to the file.
+    close(fd);
+    return r;
+}
+
+// Make sure data[pos] is a byte, refilling the buffer of gzip input.
+// Return false at end of input or on a read error (which also sets
+// r->failed).
+static bool fill(fa_reader* r) {
+    if (r->pos < r->len) {
+        return true;
+    }
+    if (r->gz == NULL || r->eof) {
+        return false;
+    }
+    int n = gzread(r->gz, r->buf, BUF_SIZE);
+    if (n <= 0) {
+        r->eof = true;
+        r->failed = n < 0;
+        return false;
+    }
+    r->len = (size_t)n;
+    r->pos = 0;
+    return true;
+}
+
+size_t fa_read_seq(fa_reader* r, const char** bytes) {
+    if (!r->in_record || !fill(r)) {
+        r->in_record = false;
+        return 0;
+    }
+    if (r->line_start && r->data[r->pos] == '>') {
+        r->in_record = false;
+        return 0;
+    }
+
+    // The record ends at the first '>' that starts a line.
+    const char* start = r->data + r->pos;
+    const char* end = r->data + r->len;
+    const char* p = start;
+    const char* gt;
+    while ((gt = memchr(p, '>', (size_t)(end - p))) != NULL) {
+        if (gt > start ? gt[-1] == '\n' : r->line_start) {
+            break;
+        }
+        p = gt + 1;
+    }
+    const char* stop = gt ? gt : end;
+
+    *bytes = start;
+    r->pos = (size_t)(stop - r->data);
+    r->line_start = gt != NULL || stop[-1] == '\n';
+    return (size_t)(stop - start);
+}
+
+// Append len bytes to the name copy of gzip input. Return false if out
+// of memory.
+static bool grow_name(fa_reader* r, size_t have, const char* s, size_t len) {
+    if (have + len > r->name_cap) {
+        size_t cap = (have + len) * 2;
+        char* grown = realloc(r->name, cap);
+        if (grown == NULL) {
+            return false;
+        }
+        r->name = grown;
+        r->name_cap = cap;
+    }
+    memcpy(r->name + have, s, len);
+    return true;
+}
+
+int fa_next_record(fa_reader* r, const char** name, size_t* name_len) {
+    const char* skip;
+    while (fa_read_seq(r, &skip) > 0) {
+    }
+
+    // Blank lines may come before the first header.
+    while (fill(r) && (r->data[r->pos] == '\n' || r->data[r->pos] == '\r')) {
+        r->pos++;
+        r->line_start = true;
+    }
+    if (!fill(r)) {
+        return r->failed ? -1 : 0;
+    }
+    if (!r->line_start || r->data[r->pos] != '>') {
+        return -1;
+    }
+    r->pos++;
+
+    // The name runs to the first space or tab; the rest of the header
+    // line is a description and is skipped. A streamed header may cross
+    // from one buffer into the next.
+    size_t have = 0;
+    bool in_name = true;
+    bool found_nl = false;
+    while (!found_nl && fill(r)) {
+        const char* start = r->data + r->pos;
+        const char* nl = memchr(start, '\n', r->len - r->pos);
+        size_t n = nl ? (size_t)(nl - start) : r->len - r->pos;
+
+        if (in_name) {
+            size_t k = 0;
+            while (k < n && start[k] != ' ' && start[k] != '\t' && start[k] != '\r') {
+                k++;
+            }
+            in_name = k == n;
+            if (r->gz == NULL) {
+                *name = start;
+                have = k;
+            } else if (!grow_name(r, have, start, k)) {
+                errno = ENOMEM;
+                return -1;
+            } else {
+                have += k;
+            }
+        }
+
+        r->pos += n + (nl != NULL);
+        found_nl = nl != NULL;
+    }
+    if (r->gz != NULL) {
+        *name = r->name;
+    }
+    *name_len = have;
+    r->line_start = true;
+    r->in_record = true;
+    return 1;
+}
+
+const char* fa_mapped(fa_reader* r, size_t* len) {
+    if (r->gz != NULL) {
+        return NULL;
+    }
+    *len = r->len;
+    return r->data;
+}
+
+void fa_drop(fa_reader* r, size_t from, size_t to) {
+    if (r->map == NULL) {
+        return;
+    }
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    from = (from + page - 1) & ~(page - 1);
+    to = to < r->len ? to & ~(page - 1) : r->len;
+    if (to > from) {
+        madvise((char*)r->map + from, to - from, MADV_DONTNEED);
+    }
+}
+
+void fa_close(fa_reader* r) {
+    if (r == NULL) {
+        return;
+    }
+    if (r->gz != NULL) {
+        gzclose(r->gz);
+        free(r->buf);
+        free(r->name);
+    }
+    if (r->map != NULL) {
+        munmap(r->map, r->len);
+    }
+    free(r);
+}
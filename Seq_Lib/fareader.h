@@ -0,0 +1,48 @@
+// Streaming FASTA reader for multi-record, multi-line files of any size.
+//
+// Plain files are memory-mapped and each record's sequence comes back as
+// one view into the mapping; gzip files (detected from their magic bytes)
+// are inflated through a fixed buffer and sequences come back a buffer at
+// a time, so memory use never depends on chromosome length. Either way
+// sequence bytes are handed out as they are in the file, line ends
+// included; callers skip them.
+
+#ifndef _FAREADER_H
+#define _FAREADER_H
+
+#include <stddef.h>
+
+// Reader structure: create with fa_open, free with fa_close.
+typedef struct fa_reader fa_reader;
+
+// Open FASTA file at path and return a reader, or NULL on failure
+// (errno is set).
+fa_reader* fa_open(const char* path);
+
+// Skip the rest of the current record and move to the next one. Set
+// *name and *name_len to its name (the header up to the first space, not
+// NUL-terminated, valid until the next call). Return 1 if there is a
+// record, 0 at end of file, or -1 if the input is not valid FASTA (or
+// could not be read).
+int fa_next_record(fa_reader* r, const char** name, size_t* name_len);
+
+// Set *bytes to the next stretch of the current record's sequence and
+// return its length, or return 0 once the record is finished. Stretches
+// may end in the middle of a line and contain '\n' and '\r'. They stay
+// valid until the next call.
+size_t fa_read_seq(fa_reader* r, const char** bytes);
+
+// Return the whole mapped file and set *len to its size, or return NULL
+// for streamed (gzip) input. On mapped input every record's sequence is
+// one stretch inside this mapping, so records can be handed to threads.
+const char* fa_mapped(fa_reader* r, size_t* len);
+
+// Hint that bytes [from, to) of a mapped file are no longer viewed, so
+// their pages (bar partial ones at either end) can leave memory. As with
+// fq_drop, this never affects data.
+void fa_drop(fa_reader* r, size_t from, size_t to);
+
+// Unmap or close file and free reader.
+void fa_close(fa_reader* r);
+
+#endif // _FAREADER_H
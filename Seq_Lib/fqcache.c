@@ -0,0 +1,465 @@
+// Binary read cache: 2-bit packed bases, separate qualities and names,
+// and record indexes, all in one mapped file.
+
+#include "fqcache.h"
+#include "fqreader.h"
+#include "nucleotide.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SECTION_ALIGN 64
+
+// Cache structure: create with fqc_open, free with fqc_close.
+struct fq_cache {
+    void* map;
+    size_t size;
+    const fqc_header* h;
+    const uint64_t* seq_index;
+    const uint64_t* name_index;
+    const fqc_run* runs;
+    const uint8_t* seq;
+    const char* qual;
+    const char* names;
+    size_t dropped;             // reads whose pages fqc_drop released
+};
+
+// Four bases of each packed byte as text.
+static char unpacked[256][4];
+
+__attribute__((constructor))
+static void init_tables(void) {
+    for (int b = 0; b < 256; b++) {
+        for (int k = 0; k < 4; k++) {
+            unpacked[b][k] = nt_base[(b >> (2 * k)) & 3];
+        }
+    }
+}
+
+static uint64_t align_up(uint64_t x) {
+    return (x + SECTION_ALIGN - 1) & ~(uint64_t)(SECTION_ALIGN - 1);
+}
+
+// Fill in the section offsets of h from its counts.
+static void lay_out(fqc_header* h) {
+    h->seq_index = align_up(sizeof(fqc_header));
+    h->name_index = align_up(h->seq_index + (h->nreads + 1) * sizeof(uint64_t));
+    h->runs = align_up(h->name_index + (h->nreads + 1) * sizeof(uint64_t));
+    h->seq = align_up(h->runs + h->nruns * sizeof(fqc_run));
+    h->qual = align_up(h->seq + (h->nbases + 3) / 4);
+    h->names = align_up(h->qual + h->nbases);
+    h->size = h->names + h->name_bytes;
+}
+
+int fqc_is_cache(const void* buf, size_t len) {
+    return len >= sizeof(fqc_header) && memcmp(buf, FQC_MAGIC, 8) == 0;
+}
+
+// Check that the header agrees with the file around it, so a truncated
+// or foreign file is refused instead of read out of bounds.
+static bool valid_header(const fq_cache* c) {
+    fqc_header h = *c->h;
+    lay_out(&h);
+    if (memcmp(&h, c->h, sizeof h) != 0 || h.size != c->size) {
+        return false;
+    }
+    return c->seq_index[0] == 0 && c->seq_index[h.nreads] == h.nbases &&
+           c->name_index[0] == 0 && c->name_index[h.nreads] == h.name_bytes;
+}
+
+fq_cache* fqc_open(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+    if ((size_t)st.st_size < sizeof(fqc_header)) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    fq_cache* c = calloc(1, sizeof(fq_cache));
+    if (c == NULL) {
+        close(fd);
+        return NULL;
+    }
+
+    c->size = (size_t)st.st_size;
+    c->map = mmap(NULL, c->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int saved = errno;
+    close(fd);
+    if (c->map == MAP_FAILED) {
+        free(c);
+        errno = saved;
+        return NULL;
+    }
+
+    const char* base = c->map;
+    c->h = c->map;
+    if (!fqc_is_cache(base, c->size)) {
+        fqc_close(c);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    // Only offsets inside the file are followed before validation.
+    fqc_header h = *c->h;
+    lay_out(&h);
+    if (h.size != c->size) {
+        fqc_close(c);
+        errno = EINVAL;
+        return NULL;
+    }
+    c->seq_index = (const uint64_t*)(base + h.seq_index);
+    c->name_index = (const uint64_t*)(base + h.name_index);
+    c->runs = (const fqc_run*)(base + h.runs);
+    c->seq = (const uint8_t*)(base + h.seq);
+    c->qual = base + h.qual;
+    c->names = base + h.names;
+    if (!valid_header(c)) {
+        fqc_close(c);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    madvise(c->map, c->size, MADV_SEQUENTIAL);
+    return c;
+}
+
+size_t fqc_count(const fq_cache* c) {
+    return (size_t)c->h->nreads;
+}
+
+void fqc_get(const fq_cache* c, size_t i, fqc_read* rd) {
+    rd->start = c->seq_index[i];
+    rd->len = (size_t)(c->seq_index[i + 1] - rd->start);
+    rd->qual = c->qual + rd->start;
+    rd->name = c->names + c->name_index[i];
+    rd->name_len = (size_t)(c->name_index[i + 1] - c->name_index[i]);
+}
+
+// Index of the first run that ends after pos.
+static size_t first_run(const fq_cache* c, uint64_t pos) {
+    size_t lo = 0;
+    size_t hi = (size_t)c->h->nruns;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (c->runs[mid].start + c->runs[mid].len <= pos) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+void fqc_unpack(const fq_cache* c, uint64_t start, size_t len, char* out) {
+    uint64_t p = start;
+    uint64_t end = start + len;
+    char* o = out;
+
+    // Bases up to a byte boundary, whole bytes, then what is left.
+    while (p < end && p % 4 != 0) {
+        *o++ = nt_base[(c->seq[p / 4] >> (2 * (p % 4))) & 3];
+        p++;
+    }
+    for (; p + 4 <= end; p += 4, o += 4) {
+        memcpy(o, unpacked[c->seq[p / 4]], 4);
+    }
+    for (; p < end; p++) {
+        *o++ = nt_base[(c->seq[p / 4] >> (2 * (p % 4))) & 3];
+    }
+
+    // N runs were packed as A; write them over.
+    for (size_t i = first_run(c, start);
+         i < c->h->nruns && c->runs[i].start < end; i++) {
+        uint64_t from = c->runs[i].start > start ? c->runs[i].start : start;
+        uint64_t to = c->runs[i].start + c->runs[i].len;
+        if (to > end) {
+            to = end;
+        }
+        memset(out + (from - start), 'N', (size_t)(to - from));
+    }
+}
+
+// A base is C (01) or G (10) exactly when its two bits differ, so GC in
+// a packed word is the popcount of (w ^ w >> 1) on the low bit of every
+// pair. N is packed as A and never counts.
+#define LOW_BITS 0x5555555555555555ULL
+
+static size_t gc_bits(uint64_t w, uint64_t keep) {
+    return (size_t)__builtin_popcountll((w ^ (w >> 1)) & LOW_BITS & keep);
+}
+
+size_t fqc_gc(const fq_cache* c, uint64_t start, size_t len) {
+    uint64_t p = start;
+    uint64_t end = start + len;
+    size_t gc = 0;
+
+    while (p < end && p % 4 != 0) {
+        gc += gc_bits(c->seq[p / 4] >> (2 * (p % 4)), 1);
+        p++;
+    }
+    for (; p + 32 <= end; p += 32) {
+        uint64_t w;
+        memcpy(&w, c->seq + p / 4, sizeof w);
+        gc += gc_bits(w, ~0ULL);
+    }
+    for (; p + 4 <= end; p += 4) {
+        gc += gc_bits(c->seq[p / 4], 0xff);
+    }
+    for (; p < end; p++) {
+        gc += gc_bits(c->seq[p / 4] >> (2 * (p % 4)), 1);
+    }
+    return gc;
+}
+
+void fqc_drop(fq_cache* c, size_t nreads) {
+    if (nreads <= c->dropped) {
+        return;
+    }
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    const char* base = c->map;
+
+    // Release the fully used pages of each per-base or per-name section.
+    const char* from[3] = {(const char*)c->seq + c->seq_index[c->dropped] / 4,
+                           c->qual + c->seq_index[c->dropped],
+                           c->names + c->name_index[c->dropped]};
+    const char* to[3] = {(const char*)c->seq + c->seq_index[nreads] / 4,
+                         c->qual + c->seq_index[nreads],
+                         c->names + c->name_index[nreads]};
+    for (int s = 0; s < 3; s++) {
+        size_t lo = (size_t)(from[s] - base) & ~(page - 1);
+        size_t hi = (size_t)(to[s] - base) & ~(page - 1);
+        if (hi > lo) {
+            madvise((char*)c->map + lo, hi - lo, MADV_DONTNEED);
+        }
+    }
+    c->dropped = nreads;
+}
+
+void fqc_close(fq_cache* c) {
+    if (c == NULL) {
+        return;
+    }
+    munmap(c->map, c->size);
+    free(c);
+}
+
+// One read packed by nt_pack, reused from read to read.
+typedef struct {
+    uint8_t* packed;
+    uint64_t* nmask;
+    size_t cap;         // bases both buffers can hold
+} packed_read;
+
+// Pack rec into pr, growing it as needed. Return number of bases other
+// than ACGT, or -1 if out of memory.
+static ssize_t pack_read(packed_read* pr, const fq_record* rec) {
+    if (rec->seq_len > pr->cap) {
+        size_t cap = rec->seq_len * 2;
+        uint8_t* packed = realloc(pr->packed, (cap + 3) / 4);
+        if (packed == NULL) {
+            return -1;
+        }
+        pr->packed = packed;
+        uint64_t* nmask = realloc(pr->nmask, (cap + 63) / 64 * sizeof(uint64_t));
+        if (nmask == NULL) {
+            return -1;
+        }
+        pr->nmask = nmask;
+        pr->cap = cap;
+    }
+    return (ssize_t)nt_pack(rec->seq, rec->seq_len, pr->packed, pr->nmask);
+}
+
+// First pass: count what the sections must hold. Return as fq_next, or
+// -2 if out of memory.
+static int measure(const char* path, fqc_header* h) {
+    fq_reader* r = fq_open(path);
+    if (r == NULL) {
+        return -2;
+    }
+
+    packed_read pr = {NULL, NULL, 0};
+    fq_record rec;
+    int got;
+    while ((got = fq_next(r, &rec)) == 1) {
+        h->nreads++;
+        h->nbases += rec.seq_len;
+        h->name_bytes += rec.name_len;
+        ssize_t flagged = pack_read(&pr, &rec);
+        if (flagged < 0) {
+            got = -2;
+            break;
+        }
+        // A run starts at every flagged base whose predecessor in the
+        // read is not flagged.
+        uint64_t carry = 0;
+        for (size_t w = 0; flagged > 0 && w < (rec.seq_len + 63) / 64; w++) {
+            uint64_t m = pr.nmask[w];
+            h->nruns += (uint64_t)__builtin_popcountll(m & ~(m << 1 | carry));
+            carry = m >> 63;
+        }
+        fq_recycle(r);
+    }
+    free(pr.packed);
+    free(pr.nmask);
+    fq_close(r);
+    return got;
+}
+
+// Second pass: fill the sections of the zeroed mapping at out.
+static int fill(const char* path, const fqc_header* h, char* out) {
+    fq_reader* r = fq_open(path);
+    if (r == NULL) {
+        return -2;
+    }
+
+    uint64_t* seq_index = (uint64_t*)(out + h->seq_index);
+    uint64_t* name_index = (uint64_t*)(out + h->name_index);
+    fqc_run* runs = (fqc_run*)(out + h->runs);
+    uint8_t* seq = (uint8_t*)(out + h->seq);
+    uint64_t nbases = 0;
+    uint64_t name_bytes = 0;
+    uint64_t nruns = 0;
+    uint64_t nreads = 0;
+
+    packed_read pr = {NULL, NULL, 0};
+    fq_record rec;
+    int got;
+    while ((got = fq_next(r, &rec)) == 1) {
+        // Input changed between the passes.
+        if (nreads == h->nreads || nbases + rec.seq_len > h->nbases ||
+            name_bytes + rec.name_len > h->name_bytes) {
+            got = -1;
+            break;
+        }
+        seq_index[nreads] = nbases;
+        name_index[nreads] = name_bytes;
+
+        ssize_t flagged = pack_read(&pr, &rec);
+        if (flagged < 0) {
+            got = -2;
+            break;
+        }
+
+        // Reads are packed back to back, so one may start inside a byte
+        // and its packed bytes are shifted into place.
+        uint8_t* dst = seq + nbases / 4;
+        unsigned shift = 2 * (unsigned)(nbases % 4);
+        size_t nbytes = (rec.seq_len + 3) / 4;
+        if (shift == 0) {
+            memcpy(dst, pr.packed, nbytes);
+        } else {
+            for (size_t j = 0; j < (nbases % 4 + rec.seq_len + 3) / 4; j++) {
+                uint8_t lo = j < nbytes ? (uint8_t)(pr.packed[j] << shift) : 0;
+                uint8_t hi = j > 0 ? (uint8_t)(pr.packed[j - 1] >> (8 - shift)) : 0;
+                dst[j] |= lo | hi;
+            }
+        }
+
+        // N runs, from the flagged bases. They never continue a run of
+        // the read before.
+        for (size_t w = 0; flagged > 0 && w < (rec.seq_len + 63) / 64; w++) {
+            for (uint64_t m = pr.nmask[w]; m != 0; m &= m - 1) {
+                size_t i = w * 64 + (size_t)__builtin_ctzll(m);
+                uint64_t p = nbases + i;
+                if (nruns > 0 && runs[nruns - 1].start + runs[nruns - 1].len == p &&
+                    i > 0) {
+                    runs[nruns - 1].len++;
+                } else if (nruns < h->nruns) {
+                    runs[nruns].start = p;
+                    runs[nruns].len = 1;
+                    nruns++;
+                }
+            }
+        }
+        memcpy(out + h->qual + nbases, rec.qual, rec.seq_len);
+        memcpy(out + h->names + name_bytes, rec.name, rec.name_len);
+
+        nbases += rec.seq_len;
+        name_bytes += rec.name_len;
+        nreads++;
+        fq_recycle(r);
+    }
+    free(pr.packed);
+    free(pr.nmask);
+    fq_close(r);
+
+    if (got == 0 && (nreads != h->nreads || nbases != h->nbases ||
+                     name_bytes != h->name_bytes || nruns != h->nruns)) {
+        got = -1;
+    }
+    if (got == 0) {
+        seq_index[nreads] = nbases;
+        name_index[nreads] = name_bytes;
+    }
+    return got;
+}
+
+int fqc_write(const char* in_path, const char* out_path) {
+    fqc_header h;
+    memset(&h, 0, sizeof h);
+
+    int got = measure(in_path, &h);
+    if (got != 0) {
+        return got == -1 ? -1 : 0;
+    }
+    memcpy(h.magic, FQC_MAGIC, 8);
+    lay_out(&h);
+
+    int fd = open(out_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return 0;
+    }
+
+    // The file starts out as zeros, so packing only has to OR bases in.
+    // Reserving the blocks up front means a full disk is reported here
+    // instead of faulting on a write through the mapping.
+    char* out = MAP_FAILED;
+    int err = h.size > 0 ? posix_fallocate(fd, 0, (off_t)h.size) : 0;
+    if (err == 0) {
+        out = mmap(NULL, h.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        err = errno;
+    }
+    if (out == MAP_FAILED) {
+        close(fd);
+        unlink(out_path);
+        errno = err;
+        return 0;
+    }
+
+    got = fill(in_path, &h, out);
+
+    // The magic goes in last, so an unfinished file is never taken for
+    // a cache.
+    if (got == 0) {
+        memcpy(out, &h, sizeof h);
+    }
+    err = errno;
+    munmap(out, h.size);
+    if (close(fd) != 0 && got == 0) {
+        err = errno;
+        got = -2;
+    }
+
+    if (got != 0) {
+        unlink(out_path);
+        errno = err;
+        return got == -1 ? -1 : 0;
+    }
+    return 1;
+}
@@ -0,0 +1,97 @@
+// Binary read cache: a FASTQ file converted once so later runs skip
+// text parsing entirely.
+//
+// Sequences are packed at 2 bits per base (A=0, C=1, G=2, T=3, first
+// base in the low bits) and any other base is recorded in a list of N
+// runs, so an analysis that only needs bases reads about an eighth of
+// the text file. Qualities and names are stored as they were, each in a
+// section of its own, and record indexes give every read's position, so
+// any read can be found without scanning. The cache is mapped read-only;
+// nothing is parsed when it is opened.
+//
+// fq_open recognizes cache files, so every tool built on fqreader can be
+// pointed at one. Tools that only need bases can work on the packed
+// sequence directly through fq_cached and the functions below.
+//
+// The file is in host byte order. Bases other than ACGT (in either case)
+// come back as 'N' and lowercase bases come back in uppercase.
+
+#ifndef _FQCACHE_H
+#define _FQCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FQC_MAGIC "SEQLIBC1"    // first 8 bytes of every cache file
+
+// File header. Every section offset is a multiple of 64.
+typedef struct {
+    char magic[8];
+    uint64_t nreads;
+    uint64_t nbases;
+    uint64_t name_bytes;
+    uint64_t nruns;
+    uint64_t seq_index;     // uint64_t[nreads + 1], first base of each read
+    uint64_t name_index;    // uint64_t[nreads + 1], first name byte of each read
+    uint64_t runs;          // fqc_run[nruns], sorted by start
+    uint64_t seq;           // (nbases + 3) / 4 bytes of packed bases
+    uint64_t qual;          // nbases bytes
+    uint64_t names;         // name_bytes bytes
+    uint64_t size;          // size of the whole file
+} fqc_header;
+
+// Bases [start, start + len) are N (or another non-ACGT base). Runs never
+// cross from one read into the next.
+typedef struct {
+    uint64_t start;
+    uint64_t len;
+} fqc_run;
+
+// Cache structure: create with fqc_open, free with fqc_close.
+typedef struct fq_cache fq_cache;
+
+// One read of a cache. name and qual point into the mapping and are not
+// NUL-terminated; the bases are [start, start + len) of the packed
+// sequence, see fqc_unpack and fqc_gc.
+typedef struct {
+    const char* name;
+    size_t name_len;
+    const char* qual;
+    uint64_t start;
+    size_t len;
+} fqc_read;
+
+// Return 1 if the len bytes at buf begin with a cache header, else 0.
+int fqc_is_cache(const void* buf, size_t len);
+
+// Map cache file at path and return it, or NULL on failure (errno is set;
+// EINVAL if the file is not a valid cache).
+fq_cache* fqc_open(const char* path);
+
+// Number of reads in c.
+size_t fqc_count(const fq_cache* c);
+
+// Fill rd with read i (i < fqc_count(c)).
+void fqc_get(const fq_cache* c, size_t i, fqc_read* rd);
+
+// Write bases [start, start + len) to out as text.
+void fqc_unpack(const fq_cache* c, uint64_t start, size_t len, char* out);
+
+// Count G and C among bases [start, start + len) without unpacking them.
+size_t fqc_gc(const fq_cache* c, uint64_t start, size_t len);
+
+// Hint that reads [0, nreads) are no longer used, so their pages can
+// leave memory. As with fq_drop this never affects data.
+void fqc_drop(fq_cache* c, size_t nreads);
+
+// Unmap cache and free it.
+void fqc_close(fq_cache* c);
+
+// Convert FASTQ file (plain or gzipped) at in_path into a cache at
+// out_path. The input is read twice: once to size the sections, once to
+// fill them. Return 1 on success, -1 if the input is not valid FASTQ, or
+// 0 if a file could not be read or written (errno is set). No partial
+// cache is left behind on failure.
+int fqc_write(const char* in_path, const char* out_path);
+
+#endif // _FQCACHE_H
@@ -0,0 +1,108 @@
+// Paired-end reader built on two fq_readers.
+
+#include "fqpair.h"
+
+#include <errno.h>
+#include <stdlib.h>
+
+// Pair structure: create with fq_pair_open, free with fq_pair_close.
+struct fq_pair {
+    fq_reader* r1;
+    fq_reader* r2;
+};
+
+fq_pair* fq_pair_open(const char* path1, const char* path2) {
+    fq_pair* p = malloc(sizeof(fq_pair));
+    if (p == NULL) {
+        return NULL;
+    }
+
+    p->r1 = fq_open(path1);
+    if (p->r1 == NULL) {
+        free(p);
+        return NULL;
+    }
+    p->r2 = fq_open(path2);
+    if (p->r2 == NULL) {
+        int saved = errno;
+        fq_close(p->r1);
+        free(p);
+        errno = saved;
+        return NULL;
+    }
+    return p;
+}
+
+// Length of the part of a read name that identifies the fragment.
+static size_t name_key_len(const fq_record* rec) {
+    size_t n = 0;
+    while (n < rec->name_len && rec->name[n] != ' ' && rec->name[n] != '\t') {
+        n++;
+    }
+    if (n >= 2 && rec->name[n - 2] == '/' &&
+        (rec->name[n - 1] == '1' || rec->name[n - 1] == '2')) {
+        n -= 2;
+    }
+    return n;
+}
+
+int fq_names_match(const fq_record* a, const fq_record* b) {
+    size_t n = name_key_len(a);
+    if (n != name_key_len(b)) {
+        return 0;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (a->name[i] != b->name[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int fq_pair_next(fq_pair* p, fq_record* r1, fq_record* r2) {
+    int got1 = fq_next(p->r1, r1);
+    int got2 = fq_next(p->r2, r2);
+
+    if (got1 < 0 || got2 < 0) {
+        return -1;
+    }
+    if (got1 != got2) {
+        return FQ_PAIR_UNEVEN;
+    }
+    if (got1 == 0) {
+        return 0;
+    }
+    if (!fq_names_match(r1, r2)) {
+        return FQ_PAIR_MISMATCH;
+    }
+    return 1;
+}
+
+size_t rb_fill_pair(read_batch* b1, read_batch* b2, fq_pair* p, size_t max,
+                    int* status) {
+    fq_record rec1, rec2;
+    int got = 1;
+
+    rb_clear(b1);
+    rb_clear(b2);
+    while (b1->n < max && (got = fq_pair_next(p, &rec1, &rec2)) == 1) {
+        if (!rb_push(b1, &rec1) || !rb_push(b2, &rec2)) {
+            got = -2;
+            break;
+        }
+    }
+    fq_recycle(p->r1);
+    fq_recycle(p->r2);
+
+    *status = got;
+    return b2->n < b1->n ? b2->n : b1->n;
+}
+
+void fq_pair_close(fq_pair* p) {
+    if (p == NULL) {
+        return;
+    }
+    fq_close(p->r1);
+    fq_close(p->r2);
+    free(p);
+}
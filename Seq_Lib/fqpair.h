@@ -0,0 +1,40 @@
+// Paired-end reader: advances the R1 and R2 files of a pair in lockstep
+// and checks that the mates' read names agree.
+
+#ifndef _FQPAIR_H
+#define _FQPAIR_H
+
+#include <stddef.h>
+
+#include "fqreader.h"
+#include "readbatch.h"
+
+// Extra fq_pair_next / rb_fill_pair results besides those of fq_next.
+#define FQ_PAIR_MISMATCH -3 // mates' read names differ
+#define FQ_PAIR_UNEVEN -4   // one file ran out of reads before the other
+
+// Pair structure: create with fq_pair_open, free with fq_pair_close.
+typedef struct fq_pair fq_pair;
+
+// Open both mate files and return a pair reader, or NULL on failure
+// (errno is set).
+fq_pair* fq_pair_open(const char* path1, const char* path2);
+
+// Read next pair of mates. Return 1 if a pair was read, 0 when both files
+// end together, -1 if either file is not valid FASTQ, FQ_PAIR_MISMATCH
+// or FQ_PAIR_UNEVEN. Views follow the rules of fq_next.
+int fq_pair_next(fq_pair* p, fq_record* r1, fq_record* r2);
+
+// Like rb_fill for both mates at once: mate i of b1 pairs with mate i of
+// b2. *status takes the values of rb_fill or fq_pair_next.
+size_t rb_fill_pair(read_batch* b1, read_batch* b2, fq_pair* p, size_t max,
+                    int* status);
+
+// Return 1 if the names of a and b denote mates of one fragment: they
+// agree up to the first whitespace, ignoring a trailing /1 or /2.
+int fq_names_match(const fq_record* a, const fq_record* b);
+
+// Close both mate files and free pair reader.
+void fq_pair_close(fq_pair* p);
+
+#endif // _FQPAIR_H
@@ -0,0 +1,771 @@
+// Zero-copy FASTQ reader backed by mmap, or by a producer thread that
+// inflates gzip input or reads plain input through aio.h.
+
+#include "fqreader.h"
+#include "aio.h"
+#include "arena.h"
+#include "nlscan.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define BLOCK_SIZE (4u << 20)  // initial size of a ring block
+#define RING_DEPTH 4           // blocks inflated ahead of the consumer
+#define SPLIT_BATCH 256        // records fq_next splits off at a time
+#define NL_BATCH 1024          // newline offsets indexed at a time
+#define MAX_WINDOW (1u << 30)  // bytes fq_split looks at per call
+
+// Chunk of decompressed input holding only whole records.
+typedef struct block {
+    char* buf;
+    size_t cap;
+    size_t len;
+    struct block* next;
+} block;
+
+// Reader structure: create with fq_open, free with fq_close.
+struct fq_reader {
+    const char* data;   // start of mapping or of current block
+    size_t size;        // bytes valid at data
+    const char* pos;    // start of next unsplit record
+
+    // Records split off ahead of fq_next.
+    fq_record split[SPLIT_BATCH];
+    size_t nsplit;
+    size_t isplit;
+    bool bad;           // input after the split records is malformed
+
+    // Mapped input only.
+    void* map;          // NULL for an empty file or gzip input
+    size_t dropped;     // bytes at the start of map released by fq_recycle
+
+    // Cache input only. Names and qualities are views into the cache;
+    // bases are unpacked into the arena until fq_recycle empties it.
+    fq_cache* cache;
+    size_t cache_next;  // index of the next read
+    arena unpacked;
+
+    // Streamed input only (gzip, or plain files when SEQLIB_IO asks for
+    // it). The producer thread inflates or reads into blocks and queues
+    // them on ready; the consumer moves finished blocks to held until
+    // fq_recycle hands them back to the producer through spare.
+    gzFile gz;          // gzip input
+    aio_reader* aio;    // plain input
+    int fd;             // file behind aio
+    bool streamed;
+    pthread_t producer;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    block* ready;       // FIFO of filled blocks
+    block* ready_tail;
+    size_t nready;
+    block* spare;       // blocks free for reuse
+    bool done;          // producer finished (EOF or error)
+    bool failed;        // producer hit a read error or ran out of memory
+    bool stop;          // fq_close asked producer to quit
+    block* cur;         // block being parsed (consumer only)
+    block* held;        // parsed blocks whose views may still be in use
+};
+
+static void free_blocks(block* b) {
+    while (b != NULL) {
+        block* next = b->next;
+        free(b->buf);
+        free(b);
+        b = next;
+    }
+}
+
+// Take a block from the spare list, or allocate a new one.
+static block* get_block(fq_reader* r) {
+    pthread_mutex_lock(&r->lock);
+    block* b = r->spare;
+    if (b != NULL) {
+        r->spare = b->next;
+    }
+    pthread_mutex_unlock(&r->lock);
+
+    if (b == NULL) {
+        b = malloc(sizeof(block));
+        if (b == NULL) {
+            return NULL;
+        }
+        b->cap = BLOCK_SIZE;
+        b->buf = malloc(b->cap);
+        if (b->buf == NULL) {
+            free(b);
+            return NULL;
+        }
+    }
+    b->len = 0;
+    b->next = NULL;
+    return b;
+}
+
+// Queue filled block for the consumer, waiting while the ring is full.
+// Return false if the reader is being closed.
+static bool put_ready(fq_reader* r, block* b) {
+    pthread_mutex_lock(&r->lock);
+    while (r->nready >= RING_DEPTH && !r->stop) {
+        pthread_cond_wait(&r->not_full, &r->lock);
+    }
+    if (r->stop) {
+        pthread_mutex_unlock(&r->lock);
+        return false;
+    }
+    if (r->ready_tail != NULL) {
+        r->ready_tail->next = b;
+    } else {
+        r->ready = b;
+    }
+    r->ready_tail = b;
+    r->nready++;
+    pthread_cond_signal(&r->not_empty);
+    pthread_mutex_unlock(&r->lock);
+    return true;
+}
+
+// Return offset just past the last complete record in buf[0, len).
+// Blocks always start on a record. Blank lines between records are
+// skipped as fq_split and fq_parse skip them, so a record ends at every
+// fourth line that is not one of them.
+static size_t last_record_end(const char* buf, size_t len) {
+    size_t cut = 0;
+    size_t lines = 0;   // lines of the current record so far
+    const char* p = buf;
+    const char* end = buf + len;
+    const char* nl;
+
+    while ((nl = memchr(p, '\n', (size_t)(end - p))) != NULL) {
+        bool blank = nl == p || (nl == p + 1 && *p == '\r');
+        p = nl + 1;
+        if (lines == 0 && blank) {
+            cut = (size_t)(p - buf);
+        } else if (++lines == 4) {
+            lines = 0;
+            cut = (size_t)(p - buf);
+        }
+    }
+    return cut;
+}
+
+// Read or inflate up to len bytes of input into buf. Return the bytes
+// stored, 0 at end of input, or -1 on error.
+static ssize_t fill(fq_reader* r, char* buf, size_t len) {
+    if (r->aio != NULL) {
+        return aio_read(r->aio, buf, len);
+    }
+    return gzread(r->gz, buf, (unsigned)len);
+}
+
+// Producer thread: inflate or read the file into blocks cut on record
+// boundaries. Bytes of a partial record at the end of a block are
+// carried over to the start of the next one.
+static void* produce(void* arg) {
+    fq_reader* r = arg;
+    block* b = get_block(r);
+    bool ok = b != NULL;
+
+    while (ok) {
+        ssize_t n = fill(r, b->buf + b->len, b->cap - b->len);
+        if (n < 0) {
+            ok = false;
+            break;
+        }
+        b->len += (size_t)n;
+        bool eof = n == 0 || (r->gz != NULL && gzeof(r->gz));
+
+        if (eof) {
+            if (b->len > 0 && !put_ready(r, b)) {
+                free_blocks(b);
+                return NULL;
+            }
+            if (b->len == 0) {
+                free_blocks(b);
+            }
+            break;
+        }
+        if (b->len < b->cap) {
+            continue;  // short read, keep filling
+        }
+
+        size_t cut = last_record_end(b->buf, b->len);
+        if (cut == 0) {
+            // A single record is bigger than the block; grow it.
+            char* grown = realloc(b->buf, b->cap * 2);
+            if (grown == NULL) {
+                ok = false;
+                break;
+            }
+            b->buf = grown;
+            b->cap *= 2;
+            continue;
+        }
+
+        block* next = get_block(r);
+        if (next == NULL) {
+            ok = false;
+            break;
+        }
+        if (next->cap < b->len - cut) {
+            char* grown = realloc(next->buf, b->cap);
+            if (grown == NULL) {
+                free_blocks(next);
+                ok = false;
+                break;
+            }
+            next->buf = grown;
+            next->cap = b->cap;
+        }
+        next->len = b->len - cut;
+        memcpy(next->buf, b->buf + cut, next->len);
+        b->len = cut;
+
+        if (!put_ready(r, b)) {
+            free_blocks(b);
+            free_blocks(next);
+            return NULL;
+        }
+        b = next;
+    }
+
+    pthread_mutex_lock(&r->lock);
+    if (!ok) {
+        r->failed = true;
+        if (b != NULL) {
+            b->next = r->spare;
+            r->spare = b;
+        }
+    }
+    r->done = true;
+    pthread_cond_signal(&r->not_empty);
+    pthread_mutex_unlock(&r->lock);
+    return NULL;
+}
+
+// Move to the next filled block. Return 1 on success, 0 at end of
+// input, or -1 if the producer failed.
+static int advance_block(fq_reader* r) {
+    if (r->cur != NULL) {
+        r->cur->next = r->held;
+        r->held = r->cur;
+        r->cur = NULL;
+    }
+
+    pthread_mutex_lock(&r->lock);
+    while (r->ready == NULL && !r->done) {
+        pthread_cond_wait(&r->not_empty, &r->lock);
+    }
+    block* b = r->ready;
+    if (b != NULL) {
+        r->ready = b->next;
+        if (r->ready == NULL) {
+            r->ready_tail = NULL;
+        }
+        r->nready--;
+        pthread_cond_signal(&r->not_full);
+    }
+    bool failed = r->failed;
+    pthread_mutex_unlock(&r->lock);
+
+    if (b == NULL) {
+        return failed ? -1 : 0;
+    }
+    b->next = NULL;
+    r->cur = b;
+    r->data = b->buf;
+    r->size = b->len;
+    r->pos = b->buf;
+    return 1;
+}
+
+// Start the producer on fd, inflating it if gzip is set and otherwise
+// reading it through aio (io_uring if use_uring is set, else pread).
+static fq_reader* open_streamed(fq_reader* r, int fd, bool gzip,
+                                bool use_uring) {
+    if (gzip) {
+        r->gz = gzdopen(fd, "rb");
+        if (r->gz != NULL) {
+            gzbuffer(r->gz, 1u << 20);
+        }
+    } else {
+        r->aio = aio_open(fd, 0, 0, use_uring);
+        r->fd = fd;
+    }
+    if (r->gz == NULL && r->aio == NULL) {
+        close(fd);
+        free(r);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    r->streamed = true;
+    pthread_mutex_init(&r->lock, NULL);
+    pthread_cond_init(&r->not_empty, NULL);
+    pthread_cond_init(&r->not_full, NULL);
+
+    int err = pthread_create(&r->producer, NULL, produce, r);
+    if (err != 0) {
+        if (r->gz != NULL) {
+            gzclose(r->gz);
+        } else {
+            aio_close(r->aio);
+            close(fd);
+        }
+        free(r);
+        errno = err;
+        return NULL;
+    }
+    return r;
+}
+
+fq_reader* fq_open(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    fq_reader* r = calloc(1, sizeof(fq_reader));
+    if (r == NULL) {
+        close(fd);
+        return NULL;
+    }
+
+    // Gzip files start with the magic bytes 1f 8b.
+    unsigned char magic[sizeof(fqc_header)];
+    ssize_t got = pread(fd, magic, sizeof magic, 0);
+    if (got >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+        return open_streamed(r, fd, true, false);
+    }
+    if (got > 0 && fqc_is_cache(magic, (size_t)got)) {
+        close(fd);
+        r->cache = fqc_open(path);
+        if (r->cache == NULL) {
+            int saved = errno;
+            free(r);
+            errno = saved;
+            return NULL;
+        }
+        arena_init(&r->unpacked, 0);
+        return r;
+    }
+
+    // Plain files are mapped unless SEQLIB_IO picks explicit reads.
+    const char* io = getenv("SEQLIB_IO");
+    if (io != NULL && (strcmp(io, "uring") == 0 || strcmp(io, "pread") == 0)) {
+        return open_streamed(r, fd, false, strcmp(io, "uring") == 0);
+    }
+
+    r->size = (size_t)st.st_size;
+
+    // mmap refuses zero-length mappings; an empty file simply has no records.
+    if (r->size > 0) {
+        void* map = mmap(NULL, r->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            int saved = errno;
+            free(r);
+            close(fd);
+            errno = saved;
+            return NULL;
+        }
+        madvise(map, r->size, MADV_SEQUENTIAL);
+        r->map = map;
+        r->data = map;
+    }
+    r->pos = r->data;
+
+    // The mapping keeps its own reference to the file.
+    close(fd);
+    return r;
+}
+
+// Cut next line out of [*pp, end). Set *line and *len to the line
+// without its terminator, move *pp past the terminator and return 1,
+// or return 0 if there is nothing left.
+static int next_line(const char** pp, const char* end, const char** line,
+                     size_t* len) {
+    const char* p = *pp;
+    if (p >= end) {
+        return 0;
+    }
+
+    const char* nl = memchr(p, '\n', (size_t)(end - p));
+    const char* stop = nl ? nl : end;  // last line may lack a newline
+
+    *line = p;
+    *len = (size_t)(stop - p);
+    if (*len > 0 && p[*len - 1] == '\r') {
+        (*len)--;
+    }
+
+    *pp = nl ? nl + 1 : end;
+    return 1;
+}
+
+int fq_parse(const char** pp, const char* end, fq_record* rec) {
+    const char* p = *pp;
+    const char* plus;
+    size_t plus_len;
+
+    // Skip blank lines between records (e.g. trailing empty lines).
+    while (p < end && (*p == '\n' || *p == '\r')) {
+        p++;
+    }
+
+    if (!next_line(&p, end, &rec->name, &rec->name_len)) {
+        *pp = p;
+        return 0;
+    }
+    if (rec->name_len == 0 || rec->name[0] != '@') {
+        return -1;
+    }
+    rec->name++;
+    rec->name_len--;
+
+    if (!next_line(&p, end, &rec->seq, &rec->seq_len) ||
+        !next_line(&p, end, &plus, &plus_len) ||
+        !next_line(&p, end, &rec->qual, &rec->qual_len)) {
+        return -1;  // truncated record
+    }
+    if (plus_len == 0 || plus[0] != '+' || rec->qual_len != rec->seq_len) {
+        return -1;
+    }
+
+    *pp = p;
+    return 1;
+}
+
+size_t fq_sync(const char* buf, size_t len, size_t off) {
+    if (off == 0) {
+        return 0;
+    }
+
+    // Back up one byte so a line starting exactly at off is not skipped.
+    const char* p = buf + off - 1;
+    const char* end = buf + len;
+
+    while (p < end) {
+        // Move to the start of the next line.
+        const char* nl = memchr(p, '\n', (size_t)(end - p));
+        if (nl == NULL) {
+            break;
+        }
+        p = nl + 1;
+        if (p >= end || *p != '@') {
+            continue;
+        }
+
+        // '@' also starts quality lines. Two lines below a header is the
+        // '+' separator, while two lines below a quality line is the next
+        // read's sequence, which never starts with '+'.
+        const char* q = p;
+        size_t lines = 0;
+        while (lines < 2 && (nl = memchr(q, '\n', (size_t)(end - q))) != NULL) {
+            q = nl + 1;
+            lines++;
+        }
+        if (lines < 2 || q >= end) {
+            break;  // too close to the end to tell
+        }
+        if (*q == '+') {
+            return (size_t)(p - buf);
+        }
+    }
+    return len;
+}
+
+// Fill rec from the four lines of a record. Return 1, or -1 if they do
+// not form a valid record.
+static int make_record(const char* const line[4], const size_t len[4],
+                       fq_record* rec) {
+    if (len[0] == 0 || line[0][0] != '@' || len[2] == 0 ||
+        line[2][0] != '+' || len[3] != len[1]) {
+        return -1;
+    }
+    rec->name = line[0] + 1;
+    rec->name_len = len[0] - 1;
+    rec->seq = line[1];
+    rec->seq_len = len[1];
+    rec->qual = line[3];
+    rec->qual_len = len[3];
+    return 1;
+}
+
+int fq_split(const char* buf, size_t len, int at_eof, fq_record* recs,
+             size_t max, size_t* nrecs, size_t* used) {
+    uint32_t nl[NL_BATCH];
+    size_t nnl = 0;         // offsets in nl
+    size_t inl = 0;         // next unused offset in nl
+    size_t nl_base = 0;     // buf offset that nl entries are relative to
+    size_t indexed = 0;     // bytes of window indexed so far
+
+    size_t window = len < MAX_WINDOW ? len : MAX_WINDOW;
+    bool eof = at_eof && window == len;
+
+    const char* line[4];
+    size_t line_len[4];
+    int nline = 0;
+    size_t line_start = 0;
+    size_t rec_start = 0;   // end of the last complete record
+    size_t n = 0;
+    int status = 1;
+
+    while (n < max) {
+        size_t stop;
+
+        // Fast path: the next four line ends are already indexed and a
+        // header starts here. Blank lines, "\r" ones included, take the
+        // slow path, which skips them.
+        if (nline == 0 && nnl - inl >= 4 && line_start < nl_base + nl[inl] &&
+            buf[line_start] == '@') {
+            size_t s = line_start;
+            for (int k = 0; k < 4; k++) {
+                size_t e = nl_base + nl[inl + k];
+                line[k] = buf + s;
+                line_len[k] = e - s - (e > s && buf[e - 1] == '\r');
+                s = e + 1;
+            }
+            if (make_record(line, line_len, &recs[n]) != 1) {
+                status = -1;
+                break;
+            }
+            n++;
+            inl += 4;
+            line_start = s;
+            rec_start = s;
+            continue;
+        }
+
+        if (inl < nnl) {
+            stop = nl_base + nl[inl++];
+        } else if (indexed < window) {
+            // Index the next stretch of newlines in one vector pass.
+            size_t scanned;
+            nl_base = indexed;
+            nnl = nl_index(buf + indexed, window - indexed, nl, NL_BATCH,
+                           &scanned);
+            inl = 0;
+            indexed += scanned;
+            continue;
+        } else if (eof && line_start < window) {
+            stop = window;  // last line lacks a newline
+        } else {
+            break;
+        }
+
+        size_t l = stop - line_start;
+        if (l > 0 && buf[stop - 1] == '\r') {
+            l--;
+        }
+
+        if (nline == 0 && l == 0) {
+            // Blank line between records.
+            rec_start = stop + 1;
+        } else {
+            line[nline] = buf + line_start;
+            line_len[nline] = l;
+            if (++nline == 4) {
+                if (make_record(line, line_len, &recs[n]) != 1) {
+                    status = -1;
+                    break;
+                }
+                n++;
+                nline = 0;
+                rec_start = stop + 1;
+            }
+        }
+        line_start = stop + 1;
+    }
+
+    // Input ended in the middle of a record.
+    if (status == 1 && eof && n < max && nline > 0) {
+        status = -1;
+    }
+
+    *nrecs = n;
+    *used = rec_start < len ? rec_start : len;
+    return status;
+}
+
+// fq_next for cache input.
+static int next_cached(fq_reader* r, fq_record* rec) {
+    if (r->cache_next == fqc_count(r->cache)) {
+        return 0;
+    }
+
+    fqc_read rd;
+    fqc_get(r->cache, r->cache_next, &rd);
+    char* seq = arena_alloc(&r->unpacked, rd.len ? rd.len : 1);
+    if (seq == NULL) {
+        return -1;
+    }
+    fqc_unpack(r->cache, rd.start, rd.len, seq);
+    r->cache_next++;
+
+    rec->name = rd.name;
+    rec->name_len = rd.name_len;
+    rec->seq = seq;
+    rec->seq_len = rd.len;
+    rec->qual = rd.qual;
+    rec->qual_len = rd.len;
+    return 1;
+}
+
+int fq_next(fq_reader* r, fq_record* rec) {
+    if (r->cache != NULL) {
+        return next_cached(r, rec);
+    }
+
+    while (r->isplit == r->nsplit) {
+        if (r->bad) {
+            return -1;
+        }
+
+        const char* end = r->data + r->size;
+        size_t used = 0;
+        r->isplit = 0;
+        r->nsplit = 0;
+
+        // Blocks and mapped files both hold whole records only.
+        if (r->pos < end &&
+            fq_split(r->pos, (size_t)(end - r->pos), 1, r->split,
+                     SPLIT_BATCH, &r->nsplit, &used) == -1) {
+            r->bad = true;
+        }
+        r->pos += used;
+
+        if (r->nsplit == 0 && !r->bad) {
+            if (!r->streamed) {
+                return 0;
+            }
+            int got = advance_block(r);
+            if (got != 1) {
+                return got;
+            }
+        }
+    }
+
+    *rec = r->split[r->isplit++];
+    return 1;
+}
+
+fq_cache* fq_cached(fq_reader* r) {
+    return r->cache;
+}
+
+const char* fq_backend(const fq_reader* r) {
+    if (r->cache != NULL) {
+        return "cache";
+    }
+    if (r->gz != NULL) {
+        return "gzip";
+    }
+    return r->aio != NULL ? aio_backend(r->aio) : "mmap";
+}
+
+const char* fq_mapped(fq_reader* r, size_t* len) {
+    if (r->streamed || r->cache != NULL) {
+        return NULL;
+    }
+    *len = r->size;
+    return r->data;
+}
+
+void fq_drop(fq_reader* r, size_t from, size_t to) {
+    if (r->map == NULL) {
+        return;
+    }
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    from &= ~(page - 1);
+    to = to < r->size ? to & ~(page - 1) : r->size;
+    if (to > from) {
+        // Pages of a read-only file mapping are simply read back in if
+        // touched again, so this never loses data.
+        madvise((char*)r->map + from, to - from, MADV_DONTNEED);
+    }
+}
+
+void fq_recycle(fq_reader* r) {
+    if (r->cache != NULL) {
+        arena_reset(&r->unpacked);
+        fqc_drop(r->cache, r->cache_next);
+        return;
+    }
+    if (!r->streamed) {
+        // Release the mapped pages of every record handed out so far.
+        const char* upto = r->isplit < r->nsplit ? r->split[r->isplit].name - 1
+                                                 : r->pos;
+        size_t done = (size_t)(upto - r->data);
+        if (r->map != NULL && done > r->dropped) {
+            fq_drop(r, r->dropped, done);
+            r->dropped = done;
+        }
+        return;
+    }
+    if (r->held == NULL) {
+        return;
+    }
+
+    block* last = r->held;
+    while (last->next != NULL) {
+        last = last->next;
+    }
+
+    pthread_mutex_lock(&r->lock);
+    last->next = r->spare;
+    r->spare = r->held;
+    pthread_mutex_unlock(&r->lock);
+    r->held = NULL;
+}
+
+void fq_close(fq_reader* r) {
+    if (r == NULL) {
+        return;
+    }
+
+    if (r->streamed) {
+        pthread_mutex_lock(&r->lock);
+        r->stop = true;
+        pthread_cond_broadcast(&r->not_full);
+        pthread_mutex_unlock(&r->lock);
+        pthread_join(r->producer, NULL);
+
+        free_blocks(r->ready);
+        free_blocks(r->spare);
+        free_blocks(r->held);
+        free_blocks(r->cur);
+        if (r->gz != NULL) {
+            gzclose(r->gz);
+        } else {
+            aio_close(r->aio);
+            close(r->fd);
+        }
+        pthread_mutex_destroy(&r->lock);
+        pthread_cond_destroy(&r->not_empty);
+        pthread_cond_destroy(&r->not_full);
+    }
+
+    if (r->cache != NULL) {
+        fqc_close(r->cache);
+        arena_free(&r->unpacked);
+    }
+    if (r->map != NULL) {
+        munmap(r->map, r->size);
+    }
+    free(r);
+}
@@ -0,0 +1,101 @@
+// Zero-copy FASTQ reader shared by the FASTQ tools.
+//
+// Plain files are memory-mapped and records are handed out as (pointer,
+// length) views into the mapping, so no line is ever copied. Gzip files
+// (detected from their magic bytes) are inflated by a dedicated thread
+// into a small ring of blocks that always end on a record boundary, so
+// decompression overlaps with whatever the caller does with the records.
+// Binary caches written by fqc_write (see fqcache.h) are recognized too;
+// their bases are unpacked as records are read.
+//
+// Setting SEQLIB_IO=uring reads plain files through io_uring instead of
+// mapping them: the producer thread keeps several large reads queued at
+// the disk and hands whole-record blocks to the parser, the same way it
+// does for gzip input (see aio.h). SEQLIB_IO=pread does the same with
+// plain pread, which is also what uring falls back to when the kernel
+// refuses io_uring. Either way fq_mapped then returns NULL.
+//
+// Build a tool against it with e.g.
+//   gcc -O2 -fopenmp multiGC_optim.c ../Seq_Lib/*.c -o multiGC_optim -lz -lpthread
+
+#ifndef _FQREADER_H
+#define _FQREADER_H
+
+#include <stddef.h>
+
+#include "fqcache.h"
+
+// One FASTQ record. Fields point into the reader's buffer and are NOT
+// NUL-terminated; always use the matching *_len field. Line endings
+// ("\n" or "\r\n") are not part of any field.
+typedef struct {
+    const char* name;   // header line without the leading '@'
+    size_t name_len;
+    const char* seq;
+    size_t seq_len;
+    const char* qual;
+    size_t qual_len;
+} fq_record;
+
+// Reader structure: create with fq_open, free with fq_close.
+typedef struct fq_reader fq_reader;
+
+// Open FASTQ file at path and return a reader, or NULL on failure
+// (errno is set).
+fq_reader* fq_open(const char* path);
+
+// Read next record into rec. Return 1 if a record was read, 0 at end of
+// file, or -1 if the input is not valid FASTQ (or could not be read).
+// Views stay valid until fq_recycle or fq_close is called.
+int fq_next(fq_reader* r, fq_record* rec);
+
+// Tell the reader that no view returned so far is used any more, so the
+// buffers behind them can be reused. Streaming consumers should call this
+// after each batch to keep memory use fixed: gzip blocks go back to the
+// ring and pages of a mapped file already parsed leave the resident set.
+// Callers that keep every record simply never call it.
+void fq_recycle(fq_reader* r);
+
+// Hint that bytes [from, to) of a mapped file are no longer viewed, so
+// their pages (bar a partial last one) can leave memory. Dropped pages are
+// read back from the file if touched again, so this never affects data.
+// Threads that parse their own ranges of the mapping use this in place
+// of fq_recycle.
+void fq_drop(fq_reader* r, size_t from, size_t to);
+
+// Return the whole mapped file and set *len to its size, or return NULL
+// for streamed (gzip) input. Callers may split a mapped file between
+// threads with fq_sync and parse each part with fq_parse.
+const char* fq_mapped(fq_reader* r, size_t* len);
+
+// Name of the input path r uses: "mmap", "io_uring", "pread", "gzip" or
+// "cache".
+const char* fq_backend(const fq_reader* r);
+
+// Return the cache behind r, or NULL if r reads FASTQ text. Tools that
+// only need bases can work on the packed sequence through it instead of
+// calling fq_next.
+fq_cache* fq_cached(fq_reader* r);
+
+// Parse the record starting at *pp (blank lines before it are skipped)
+// and move *pp past it. Return values are as for fq_next.
+int fq_parse(const char** pp, const char* end, fq_record* rec);
+
+// Split as many whole records as fit in recs[0, max) off the front of
+// buf[0, len), finding line ends for the whole block with the vector
+// scanner in nlscan.h. Set *nrecs to the records stored and *used to the
+// bytes they cover (including blank lines around them). A record cut off
+// by the end of buf is left for the next call unless at_eof is set.
+// Return 1, or -1 if the input after the stored records is not valid.
+int fq_split(const char* buf, size_t len, int at_eof, fq_record* recs,
+             size_t max, size_t* nrecs, size_t* used);
+
+// Return offset of the first record that starts at or after off in
+// buf[0, len), or len if there is none. Lines starting with '@' may be
+// headers or quality strings; the line two below tells them apart.
+size_t fq_sync(const char* buf, size_t len, size_t off);
+
+// Unmap file and free reader.
+void fq_close(fq_reader* r);
+
+#endif // _FQREADER_H
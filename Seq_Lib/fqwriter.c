@@ -0,0 +1,125 @@
+// Buffered FASTQ writer over write(2).
+
+#include "fqwriter.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+struct fq_writer {
+    int fd;
+    int failed;     // a write failed; later calls do nothing
+    size_t used;
+    char* buf;
+};
+
+fq_writer* fq_wopen(const char* path) {
+    int fd = strcmp(path, "-") == 0 ? STDOUT_FILENO
+                                    : open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+    fq_writer* w = malloc(sizeof *w);
+    char* buf = malloc(FQW_BUFFER);
+    if (w == NULL || buf == NULL) {
+        free(w);
+        free(buf);
+        if (fd != STDOUT_FILENO) {
+            close(fd);
+        }
+        errno = ENOMEM;
+        return NULL;
+    }
+    w->fd = fd;
+    w->failed = 0;
+    w->used = 0;
+    w->buf = buf;
+    return w;
+}
+
+int fq_wflush(fq_writer* w) {
+    size_t done = 0;
+    while (!w->failed && done < w->used) {
+        ssize_t n = write(w->fd, w->buf + done, w->used - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            w->failed = 1;
+            break;
+        }
+        done += (size_t)n;
+    }
+    w->used = 0;
+    return w->failed ? -1 : 0;
+}
+
+char* fq_wreserve(fq_writer* w, size_t n) {
+    if (n > FQW_BUFFER) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (FQW_BUFFER - w->used < n && fq_wflush(w) != 0) {
+        return NULL;
+    }
+    return w->failed ? NULL : w->buf + w->used;
+}
+
+void fq_wcommit(fq_writer* w, size_t n) {
+    w->used += n;
+}
+
+int fq_wwrite(fq_writer* w, const char* buf, size_t len) {
+    // Pieces too big for the buffer go out in buffer-sized parts.
+    while (len > 0) {
+        size_t part = len < FQW_BUFFER ? len : FQW_BUFFER;
+        char* dst = fq_wreserve(w, part);
+        if (dst == NULL) {
+            return -1;
+        }
+        memcpy(dst, buf, part);
+        fq_wcommit(w, part);
+        buf += part;
+        len -= part;
+    }
+    return w->failed ? -1 : 0;
+}
+
+int fq_wrecord(fq_writer* w, const fq_record* rec) {
+    size_t n = rec->name_len + rec->seq_len + rec->qual_len + 6;
+    if (n > FQW_BUFFER) {
+        return fq_wwrite(w, "@", 1) || fq_wwrite(w, rec->name, rec->name_len) ||
+               fq_wwrite(w, "\n", 1) || fq_wwrite(w, rec->seq, rec->seq_len) ||
+               fq_wwrite(w, "\n+\n", 3) || fq_wwrite(w, rec->qual, rec->qual_len) ||
+               fq_wwrite(w, "\n", 1) ? -1 : 0;
+    }
+    char* p = fq_wreserve(w, n);
+    if (p == NULL) {
+        return -1;
+    }
+    *p++ = '@';
+    memcpy(p, rec->name, rec->name_len);
+    p += rec->name_len;
+    *p++ = '\n';
+    memcpy(p, rec->seq, rec->seq_len);
+    p += rec->seq_len;
+    memcpy(p, "\n+\n", 3);
+    p += 3;
+    memcpy(p, rec->qual, rec->qual_len);
+    p += rec->qual_len;
+    *p = '\n';
+    fq_wcommit(w, n);
+    return 0;
+}
+
+int fq_wclose(fq_writer* w) {
+    int ret = fq_wflush(w);
+    if (w->fd != STDOUT_FILENO && close(w->fd) != 0) {
+        ret = -1;
+    }
+    free(w->buf);
+    free(w);
+    return ret;
+}
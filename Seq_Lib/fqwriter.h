@@ -0,0 +1,47 @@
+// Buffered FASTQ writer.
+//
+// Records are copied into one large buffer that goes to the file with
+// write(2) each time it fills, so nothing is allocated per record.
+// Callers that build a field themselves (re-encoded qualities, trimmed
+// reads) can reserve space in the buffer, write into it in place and
+// commit what they used, with no copy in between.
+
+#ifndef _FQWRITER_H
+#define _FQWRITER_H
+
+#include <stddef.h>
+
+#include "fqreader.h"
+
+#define FQW_BUFFER (4 << 20)    // bytes buffered between writes
+
+// Writer structure: create with fq_wopen, free with fq_wclose.
+typedef struct fq_writer fq_writer;
+
+// Create or truncate file at path ("-" is standard output) and return a
+// writer, or NULL on failure (errno is set).
+fq_writer* fq_wopen(const char* path);
+
+// Return space for n bytes at the end of the buffer, flushing it first if
+// they don't fit, or NULL on a write error or if n is larger than
+// FQW_BUFFER (errno is set). Nothing is written until fq_wcommit.
+char* fq_wreserve(fq_writer* w, size_t n);
+
+// Add the first n bytes of the last reservation to the output.
+void fq_wcommit(fq_writer* w, size_t n);
+
+// Copy len bytes of buf to the output. Return 0, or -1 on a write error.
+int fq_wwrite(fq_writer* w, const char* buf, size_t len);
+
+// Write rec as four lines: "@name", sequence, "+" and qualities. Return
+// 0, or -1 on a write error.
+int fq_wrecord(fq_writer* w, const fq_record* rec);
+
+// Write out the buffer. Return 0, or -1 on a write error.
+int fq_wflush(fq_writer* w);
+
+// Flush, close the file (unless it is standard output) and free writer.
+// Return 0, or -1 if any write failed.
+int fq_wclose(fq_writer* w);
+
+#endif // _FQWRITER_H
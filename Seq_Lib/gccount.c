@@ -0,0 +1,144 @@
+// Vectorized GC counting with SSE2, AVX2 and AVX-512 kernels picked at
+// load time from the features of the running CPU.
+
+#include "gccount.h"
+
+#include <stdint.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define GC_X86 1
+#endif
+
+// Setting bit 5 lowercases letters, and only 'G'/'g' and 'C'/'c' become
+// 'g' and 'c' that way, so each kernel needs two compares per vector.
+#define CASE_BIT 0x20
+
+size_t gc_count_scalar(const char* seq, size_t len) {
+    size_t gc = 0;
+    for (size_t i = 0; i < len; i++) {
+        char b = (char)(seq[i] | CASE_BIT);
+        gc += b == 'g' || b == 'c';
+    }
+    return gc;
+}
+
+#ifdef GC_X86
+
+// The SSE2 and AVX2 kernels count matches in byte lanes (a match is -1,
+// so subtracting it adds one) and fold the lanes into 64-bit sums with
+// sad_epu8 before any lane can pass 255.
+#define LANE_ROUNDS 255
+
+__attribute__((target("sse2")))
+static size_t gc_count_sse2(const char* seq, size_t len) {
+    const __m128i lower = _mm_set1_epi8(CASE_BIT);
+    const __m128i g = _mm_set1_epi8('g');
+    const __m128i c = _mm_set1_epi8('c');
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sums = zero;
+    size_t i = 0;
+
+    while (i + 16 <= len) {
+        __m128i lanes = zero;
+        for (int r = 0; r < LANE_ROUNDS && i + 16 <= len; r++, i += 16) {
+            __m128i v = _mm_or_si128(_mm_loadu_si128((const __m128i*)(seq + i)), lower);
+            lanes = _mm_sub_epi8(lanes, _mm_cmpeq_epi8(v, g));
+            lanes = _mm_sub_epi8(lanes, _mm_cmpeq_epi8(v, c));
+        }
+        sums = _mm_add_epi64(sums, _mm_sad_epu8(lanes, zero));
+    }
+    size_t gc = (size_t)_mm_cvtsi128_si64(sums) +
+                (size_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(sums, sums));
+    return gc + gc_count_scalar(seq + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static size_t gc_count_avx2(const char* seq, size_t len) {
+    const __m256i lower = _mm256_set1_epi8(CASE_BIT);
+    const __m256i g = _mm256_set1_epi8('g');
+    const __m256i c = _mm256_set1_epi8('c');
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i sums = zero;
+    size_t i = 0;
+
+    while (i + 32 <= len) {
+        __m256i lanes = zero;
+        for (int r = 0; r < LANE_ROUNDS && i + 32 <= len; r++, i += 32) {
+            __m256i v = _mm256_or_si256(_mm256_loadu_si256((const __m256i*)(seq + i)), lower);
+            lanes = _mm256_sub_epi8(lanes, _mm256_cmpeq_epi8(v, g));
+            lanes = _mm256_sub_epi8(lanes, _mm256_cmpeq_epi8(v, c));
+        }
+        sums = _mm256_add_epi64(sums, _mm256_sad_epu8(lanes, zero));
+    }
+    __m128i half = _mm_add_epi64(_mm256_castsi256_si128(sums),
+                                 _mm256_extracti128_si256(sums, 1));
+    size_t gc = (size_t)_mm_cvtsi128_si64(half) +
+                (size_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(half, half));
+    return gc + gc_count_scalar(seq + i, len - i);
+}
+
+// AVX-512 compares straight into a 64-bit mask, so a popcount per
+// vector is all the counting needed.
+__attribute__((target("avx512f,avx512bw,popcnt")))
+static size_t gc_count_avx512(const char* seq, size_t len) {
+    const __m512i lower = _mm512_set1_epi8(CASE_BIT);
+    const __m512i g = _mm512_set1_epi8('g');
+    const __m512i c = _mm512_set1_epi8('c');
+    size_t gc = 0;
+    size_t i = 0;
+
+    for (; i + 64 <= len; i += 64) {
+        __m512i v = _mm512_or_si512(_mm512_loadu_si512((const void*)(seq + i)), lower);
+        gc += (size_t)_mm_popcnt_u64(_mm512_cmpeq_epi8_mask(v, g) |
+                                     _mm512_cmpeq_epi8_mask(v, c));
+    }
+    // Masked load covers the tail without reading past the buffer.
+    if (i < len) {
+        __mmask64 live = (1ULL << (len - i)) - 1;  // len - i < 64 here
+        __m512i v = _mm512_or_si512(_mm512_maskz_loadu_epi8(live, seq + i), lower);
+        gc += (size_t)_mm_popcnt_u64(_mm512_mask_cmpeq_epi8_mask(live, v, g) |
+                                     _mm512_mask_cmpeq_epi8_mask(live, v, c));
+    }
+    return gc;
+}
+
+#endif // GC_X86
+
+static gc_count_fn impl = gc_count_scalar;
+static const char* impl_name = "scalar";
+
+gc_count_fn gc_count_kernel(cpu_level level) {
+    switch (level) {
+#ifdef GC_X86
+    case CPU_AVX512:
+        return gc_count_avx512;
+    case CPU_AVX2:
+        return gc_count_avx2;
+    case CPU_SSE2:
+        return gc_count_sse2;
+#endif
+    case CPU_SCALAR:
+        return gc_count_scalar;
+    default:
+        return NULL;
+    }
+}
+
+__attribute__((constructor))
+static void pick_kernel(void) {
+    cpu_level level = cpu_detect();
+    gc_count_fn fn = gc_count_kernel(level);
+    if (fn != NULL) {
+        impl = fn;
+        impl_name = cpu_level_name(level);
+    }
+}
+
+size_t gc_count(const char* seq, size_t len) {
+    return impl(seq, len);
+}
+
+const char* gc_count_impl(void) {
+    return impl_name;
+}
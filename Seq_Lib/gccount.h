@@ -0,0 +1,44 @@
+// GC counting with SSE2, AVX2 and AVX-512 kernels picked at load time
+// from the features of the running CPU, plus the scalar reference they
+// must agree with.
+
+#ifndef _GCCOUNT_H
+#define _GCCOUNT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpu.h"
+
+#define GC_FRAC_BITS 24 // fraction bits of gc_frac
+
+// Return GC fraction gc / len of a read in units of 2^-GC_FRAC_BITS,
+// rounded to the nearest, or 0 for an empty read. Tools sum these rather
+// than doubles, so totals are exact and the same in any order: across
+// threads, batches, or runs merged from partial results. Sums of up to
+// 2^40 reads fit.
+static inline uint64_t gc_frac(size_t gc, size_t len) {
+    return len ? (((uint64_t)gc << GC_FRAC_BITS) + len / 2) / len : 0;
+}
+
+// Return average of the GC fractions of reads reads summing to sum.
+static inline double gc_frac_mean(uint64_t sum, uint64_t reads) {
+    return reads ? (double)sum / (double)(1ULL << GC_FRAC_BITS) / (double)reads : 0.0;
+}
+
+typedef size_t (*gc_count_fn)(const char* seq, size_t len);
+
+// Return number of G, C, g and c bytes in seq[0, len).
+size_t gc_count(const char* seq, size_t len);
+
+// Byte-at-a-time reference version of gc_count.
+size_t gc_count_scalar(const char* seq, size_t len);
+
+// Return kernel written for level, or NULL if this build has none. Only
+// call kernels for levels up to cpu_detect().
+gc_count_fn gc_count_kernel(cpu_level level);
+
+// Return name of the kernel gc_count dispatches to on this CPU.
+const char* gc_count_impl(void);
+
+#endif // _GCCOUNT_H
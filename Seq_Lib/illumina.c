@@ -0,0 +1,104 @@
+// Illumina read name parsing.
+
+#include "illumina.h"
+
+#include <string.h>
+
+// Matches are found from the lowest set bit of a mask up.
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "illumina.c reads names a word at a time and needs a little-endian CPU"
+#endif
+
+#define MAX_COLONS 8    // more than either layout has; stored positions wrap
+
+// Parse the decimal number s[0, len) into *v. Return 0, or -1 if it is
+// empty, too long or has a byte that is not a digit.
+static int parse_uint(const char* s, size_t len, uint32_t* v) {
+    uint32_t n = 0;
+    unsigned bad = len == 0 || len > ILMN_MAX_DIGITS;
+    for (size_t i = 0; i < len && i < ILMN_MAX_DIGITS; i++) {
+        unsigned d = (unsigned char)s[i] - '0';
+        bad |= d > 9;
+        n = n * 10 + d;
+    }
+    *v = n;
+    return bad ? -1 : 0;
+}
+
+// Set the top bit of every byte of w equal to c, and no other bit.
+static uint64_t byte_mask(uint64_t w, unsigned char c) {
+    const uint64_t low7 = 0x7F7F7F7F7F7F7F7FULL;
+    uint64_t x = w ^ (0x0101010101010101ULL * c);
+    return ~(((x & low7) + low7) | x | low7);
+}
+
+// Start of field i of a name whose colons are at colon[].
+static size_t field_start(const size_t* colon, int i) {
+    return i == 0 ? 0 : colon[i - 1] + 1;
+}
+
+// Parse field i, which ends at colon i, as a number.
+static int field_uint(const char* name, const size_t* colon, int i, uint32_t* v) {
+    size_t start = field_start(colon, i);
+    return parse_uint(name + start, colon[i] - start, v);
+}
+
+int ilmn_parse(const char* name, size_t len, ilmn_header* h) {
+    size_t colon[MAX_COLONS];
+    size_t ncolons = 0;
+    size_t end = len;
+
+    // The first word holds the fields; a comment may follow. Eight bytes
+    // at a time, colons and the first blank are found as bit masks.
+    for (size_t i = 0; i < end; i += 8) {
+        uint64_t w = 0;
+        if (end - i >= 8) {
+            memcpy(&w, name + i, 8);
+        } else {
+            memcpy(&w, name + i, end - i);
+        }
+        uint64_t blank = byte_mask(w, ' ') | byte_mask(w, '\t');
+        uint64_t colons = byte_mask(w, ':');
+        if (blank) {
+            // Bytes past the buffer were read as 0 and match neither.
+            end = i + (size_t)__builtin_ctzll(blank) / 8;
+            colons &= (blank & -blank) - 1;
+        }
+        for (; colons; colons &= colons - 1) {
+            colon[ncolons++ % MAX_COLONS] = i + (size_t)__builtin_ctzll(colons) / 8;
+        }
+    }
+    if (ncolons != 6 && ncolons != 4) {
+        return -1;
+    }
+
+    h->instrument = name;
+    h->instrument_len = colon[0];
+
+    // The last number ends at the word's end, or at a '#index' or '/mate'.
+    size_t y = colon[ncolons - 1] + 1;
+    size_t y_end = y;
+    while (y_end < end && name[y_end] != '#' && name[y_end] != '/') {
+        y_end++;
+    }
+
+    int bad;
+    if (ncolons == 6) {
+        h->flowcell = name + field_start(colon, 2);
+        h->flowcell_len = colon[2] - field_start(colon, 2);
+        bad = field_uint(name, colon, 1, &h->run);
+        bad |= field_uint(name, colon, 3, &h->lane);
+        bad |= field_uint(name, colon, 4, &h->tile);
+        bad |= field_uint(name, colon, 5, &h->x);
+    } else {
+        h->flowcell = NULL;
+        h->flowcell_len = 0;
+        h->run = 0;
+        bad = field_uint(name, colon, 1, &h->lane);
+        bad |= field_uint(name, colon, 2, &h->tile);
+        bad |= field_uint(name, colon, 3, &h->x);
+    }
+    bad |= parse_uint(name + y, y_end - y, &h->y);
+
+    return bad ? -1 : 0;
+}
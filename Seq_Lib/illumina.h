@@ -0,0 +1,35 @@
+// Fields of Illumina read names, read without sscanf.
+//
+// Two layouts are recognised, the first word of the name being
+//   instrument:run:flowcell:lane:tile:x:y       (Casava 1.8 and later)
+//   instrument:lane:tile:x:y[#index][/mate]     (older pipelines)
+// Colons and the end of the first word are found eight bytes at a time as
+// bit masks, and each number is parsed over its known width with bad
+// digits OR-ed into a flag, so the work per name hardly branches on its
+// bytes.
+
+#ifndef _ILLUMINA_H
+#define _ILLUMINA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ILMN_MAX_DIGITS 9   // longer numbers are rejected, so none overflow
+
+typedef struct {
+    const char* instrument; // points into the name; not NUL-terminated
+    size_t instrument_len;
+    const char* flowcell;   // NULL for the older layout
+    size_t flowcell_len;
+    uint32_t run;           // 0 for the older layout
+    uint32_t lane;
+    uint32_t tile;
+    uint32_t x;
+    uint32_t y;
+} ilmn_header;
+
+// Parse the name name[0, len), without its leading '@', into h. Return 0,
+// or -1 if it has neither layout (h is then left partly set).
+int ilmn_parse(const char* name, size_t len, ilmn_header* h);
+
+#endif // _ILLUMINA_H
@@ -0,0 +1,159 @@
+// Vectorized newline scanner with SSE2, AVX2 and AVX-512 kernels picked
+// at load time from the features of the running CPU.
+
+#include "nlscan.h"
+#include "cpu.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define NL_X86 1
+#endif
+
+typedef size_t (*nl_index_fn)(const char*, size_t, uint32_t*, size_t,
+                              size_t*);
+
+// Append offset base + i for every set bit i of mask.
+static inline size_t emit(uint64_t mask, size_t base, uint32_t* pos,
+                          size_t n) {
+    while (mask != 0) {
+        pos[n++] = (uint32_t)(base + (size_t)__builtin_ctzll(mask));
+        mask &= mask - 1;
+    }
+    return n;
+}
+
+// Scan tail of fewer than 64 bytes one byte at a time. The caller has
+// checked there are at least 64 free slots.
+static size_t scan_tail(const char* buf, size_t i, size_t len,
+                        uint32_t* pos, size_t n) {
+    for (; i < len; i++) {
+        if (buf[i] == '\n') {
+            pos[n++] = (uint32_t)i;
+        }
+    }
+    return n;
+}
+
+static size_t nl_index_scalar(const char* buf, size_t len, uint32_t* pos,
+                              size_t cap, size_t* scanned) {
+    size_t n = 0;
+    const char* p = buf;
+    const char* end = buf + len;
+    const char* nl;
+
+    while (n < cap && (nl = memchr(p, '\n', (size_t)(end - p))) != NULL) {
+        pos[n++] = (uint32_t)(nl - buf);
+        p = nl + 1;
+    }
+    *scanned = n < cap ? len : (size_t)(p - buf);
+    return n;
+}
+
+#ifdef NL_X86
+
+// Each kernel handles 64 bytes per step so a step never produces more
+// offsets than the NL_MIN_CAP free slots checked beforehand.
+
+__attribute__((target("sse2")))
+static size_t nl_index_sse2(const char* buf, size_t len, uint32_t* pos,
+                            size_t cap, size_t* scanned) {
+    const __m128i nl = _mm_set1_epi8('\n');
+    size_t n = 0;
+    size_t i = 0;
+
+    for (; i + 64 <= len && cap - n >= NL_MIN_CAP; i += 64) {
+        const __m128i* p = (const __m128i*)(buf + i);
+        uint64_t m0 = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(p), nl));
+        uint64_t m1 = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(p + 1), nl));
+        uint64_t m2 = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(p + 2), nl));
+        uint64_t m3 = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(p + 3), nl));
+        n = emit(m0 | (m1 << 16) | (m2 << 32) | (m3 << 48), i, pos, n);
+    }
+    if (i + 64 > len && cap - n >= NL_MIN_CAP) {
+        n = scan_tail(buf, i, len, pos, n);
+        i = len;
+    }
+    *scanned = i;
+    return n;
+}
+
+__attribute__((target("avx2")))
+static size_t nl_index_avx2(const char* buf, size_t len, uint32_t* pos,
+                            size_t cap, size_t* scanned) {
+    const __m256i nl = _mm256_set1_epi8('\n');
+    size_t n = 0;
+    size_t i = 0;
+
+    for (; i + 64 <= len && cap - n >= NL_MIN_CAP; i += 64) {
+        const __m256i* p = (const __m256i*)(buf + i);
+        uint64_t lo = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(p), nl));
+        uint64_t hi = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(p + 1), nl));
+        n = emit(lo | (hi << 32), i, pos, n);
+    }
+    if (i + 64 > len && cap - n >= NL_MIN_CAP) {
+        n = scan_tail(buf, i, len, pos, n);
+        i = len;
+    }
+    *scanned = i;
+    return n;
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static size_t nl_index_avx512(const char* buf, size_t len, uint32_t* pos,
+                              size_t cap, size_t* scanned) {
+    const __m512i nl = _mm512_set1_epi8('\n');
+    size_t n = 0;
+    size_t i = 0;
+
+    for (; i + 64 <= len && cap - n >= NL_MIN_CAP; i += 64) {
+        __m512i v = _mm512_loadu_si512((const void*)(buf + i));
+        n = emit(_mm512_cmpeq_epi8_mask(v, nl), i, pos, n);
+    }
+    // Masked load covers the tail without reading past the buffer.
+    if (i < len && cap - n >= NL_MIN_CAP) {
+        __mmask64 live = (1ULL << (len - i)) - 1;  // len - i < 64 here
+        __m512i v = _mm512_maskz_loadu_epi8(live, buf + i);
+        n = emit(_mm512_mask_cmpeq_epi8_mask(live, v, nl), i, pos, n);
+        i = len;
+    }
+    *scanned = i;
+    return n;
+}
+
+#endif // NL_X86
+
+static nl_index_fn impl = nl_index_scalar;
+static const char* impl_name = "scalar";
+
+__attribute__((constructor))
+static void pick_kernel(void) {
+#ifdef NL_X86
+    cpu_level level = cpu_detect();
+    switch (level) {
+    case CPU_AVX512:
+        impl = nl_index_avx512;
+        break;
+    case CPU_AVX2:
+        impl = nl_index_avx2;
+        break;
+    case CPU_SSE2:
+        impl = nl_index_sse2;
+        break;
+    default:
+        impl = nl_index_scalar;
+        break;
+    }
+    impl_name = cpu_level_name(level);
+#endif
+}
+
+size_t nl_index(const char* buf, size_t len, uint32_t* pos, size_t cap,
+                size_t* scanned) {
+    return impl(buf, len, pos, cap, scanned);
+}
+
+const char* nl_index_impl(void) {
+    return impl_name;
+}
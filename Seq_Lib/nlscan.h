@@ -0,0 +1,24 @@
+// Vectorized newline scanner: finds the line ends of a whole block at
+// once and records them in a position index.
+
+#ifndef _NLSCAN_H
+#define _NLSCAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Smallest capacity nl_index accepts for pos.
+#define NL_MIN_CAP 64
+
+// Store offsets of the '\n' bytes in buf[0, len) in pos, in order.
+// Scanning stops early once fewer than NL_MIN_CAP slots are free, so cap
+// must be at least NL_MIN_CAP. Set *scanned to the number of bytes
+// examined and return the number of offsets stored. len must be below
+// 4 GiB so offsets fit in 32 bits.
+size_t nl_index(const char* buf, size_t len, uint32_t* pos, size_t cap,
+                size_t* scanned);
+
+// Return name of the kernel nl_index dispatches to on this CPU.
+const char* nl_index_impl(void);
+
+#endif // _NLSCAN_H
@@ -0,0 +1,314 @@
+// Nucleotide tables, validation and 2-bit packing with SSE2, AVX2 and
+// AVX-512 kernels picked at load time from the features of the running
+// CPU.
+
+#include "nucleotide.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define NT_X86 1
+#endif
+
+// Setting bit 5 lowercases letters, so packing sees one case.
+#define CASE_BIT 0x20
+
+// Codes: A, C, G, T in either case are 0 to 3, all else NT_N.
+const uint8_t nt_code[256] = {
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,  // 0x00
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,  // 0x10
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,  // 0x20
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,  // 0x30
+    4, 0, 4, 1, 4, 4, 4, 2, 4, 4, 4, 4, 4, 4, 4, 4,  // 0x40
+    4, 4, 4, 4, 3, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,  // 0x50
+    4, 0, 4, 1, 4, 4, 4, 2, 4, 4, 4, 4, 4, 4, 4, 4,  // 0x60
+    4, 4, 4, 4, 3, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,  // 0x70
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,  // 0x80
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,  // 0x90
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,  // 0xA0
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,  // 0xB0
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,  // 0xC0
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,  // 0xD0
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,  // 0xE0
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,  // 0xF0
+};
+
+// Alphabet bits: ACGT carry NT_ACGT | NT_ACGTN, N carries NT_ACGTN.
+const uint8_t nt_class[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0x00
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0x10
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0x20
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0x30
+    0, 3, 0, 3, 0, 0, 0, 3, 0, 0, 0, 0, 0, 0, 2, 0,  // 0x40
+    0, 0, 0, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0x50
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0x60
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0x70
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0x80
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0x90
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0xA0
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0xB0
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0xC0
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0xD0
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0xE0
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0xF0
+};
+
+const char nt_base[4] = {'A', 'C', 'G', 'T'};
+
+size_t nt_valid_span_scalar(const char* seq, size_t len, nt_alphabet alphabet) {
+    size_t i = 0;
+    while (i < len && (nt_class[(unsigned char)seq[i]] & alphabet)) {
+        i++;
+    }
+    return i;
+}
+
+// Pack bases [from, len) of seq, from a multiple of 4, into packed and
+// flag the non-ACGT ones in nmask, whose words must be zero from
+// from / 64 on.
+static size_t pack_from(const char* seq, size_t from, size_t len, uint8_t* packed,
+                        uint64_t* nmask) {
+    size_t flagged = 0;
+    for (size_t i = from; i < len; i += 4) {
+        uint8_t byte = 0;
+        for (size_t k = 0; k < 4 && i + k < len; k++) {
+            uint8_t code = nt_code[(unsigned char)seq[i + k]];
+            if (code == NT_N) {
+                nmask[(i + k) / 64] |= 1ULL << ((i + k) % 64);
+                flagged++;
+                code = NT_A;
+            }
+            byte |= (uint8_t)(code << (2 * k));
+        }
+        packed[i / 4] = byte;
+    }
+    return flagged;
+}
+
+size_t nt_pack_scalar(const char* seq, size_t len, uint8_t* packed, uint64_t* nmask) {
+    memset(nmask, 0, (len + 63) / 64 * sizeof(uint64_t));
+    return pack_from(seq, 0, len, packed, nmask);
+}
+
+#ifdef NT_X86
+
+__attribute__((target("sse2")))
+static size_t nt_valid_span_sse2(const char* seq, size_t len, nt_alphabet alphabet) {
+    const __m128i a = _mm_set1_epi8('A');
+    const __m128i c = _mm_set1_epi8('C');
+    const __m128i g = _mm_set1_epi8('G');
+    const __m128i t = _mm_set1_epi8('T');
+    // With ACGT only, N is compared against a byte no sequence holds.
+    const __m128i n = _mm_set1_epi8(alphabet == NT_ACGTN ? 'N' : 'A');
+    size_t i = 0;
+
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(seq + i));
+        __m128i ok = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, a), _mm_cmpeq_epi8(v, c)),
+                                  _mm_or_si128(_mm_cmpeq_epi8(v, g), _mm_cmpeq_epi8(v, t)));
+        ok = _mm_or_si128(ok, _mm_cmpeq_epi8(v, n));
+        unsigned bad = ~(unsigned)_mm_movemask_epi8(ok) & 0xffff;
+        if (bad != 0) {
+            return i + (size_t)__builtin_ctz(bad);
+        }
+    }
+    return i + nt_valid_span_scalar(seq + i, len - i, alphabet);
+}
+
+// The low nibbles of A, C, G, T and N (1, 3, 7, 4, e) all differ, so one
+// shuffle looks up the only letter each byte could be and one compare
+// tells if it is. Unused slots hold 0xff, which a shuffle never returns
+// for a byte of 0xff (its high bit selects zero).
+#define LETTERS(n) -1, 'A', -1, 'C', 'T', -1, -1, 'G', -1, -1, -1, -1, -1, -1, (n), -1
+
+// Code of the lowercase letter with each low nibble, and the letter
+// itself (zero, which no lowercased byte is, where there is none).
+#define CODES 0, NT_A, 0, NT_C, NT_T, 0, 0, NT_G, 0, 0, 0, 0, 0, 0, 0, 0
+#define LOWER 0, 'a', 0, 'c', 't', 0, 0, 'g', 0, 0, 0, 0, 0, 0, 0, 0
+
+__attribute__((target("avx2")))
+static size_t nt_valid_span_avx2(const char* seq, size_t len, nt_alphabet alphabet) {
+    const __m256i letters = alphabet == NT_ACGTN
+        ? _mm256_setr_epi8(LETTERS('N'), LETTERS('N'))
+        : _mm256_setr_epi8(LETTERS(-1), LETTERS(-1));
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(seq + i));
+        __m256i ok = _mm256_cmpeq_epi8(_mm256_shuffle_epi8(letters, v), v);
+        uint32_t bad = ~(uint32_t)_mm256_movemask_epi8(ok);
+        if (bad != 0) {
+            return i + (size_t)__builtin_ctz(bad);
+        }
+    }
+    return i + nt_valid_span_scalar(seq + i, len - i, alphabet);
+}
+
+// Packing turns 32 codes into 8 bytes: maddubs folds pairs into c0 + 4c1,
+// madd folds those into c0 + 4c1 + 16c2 + 64c3 per 32-bit lane, and a
+// shuffle and permute gather the low bytes of the lanes.
+__attribute__((target("avx2,popcnt")))
+static size_t nt_pack_avx2(const char* seq, size_t len, uint8_t* packed, uint64_t* nmask) {
+    const __m256i lower = _mm256_set1_epi8(CASE_BIT);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    const __m256i letters = _mm256_setr_epi8(LOWER, LOWER);
+    const __m256i codes = _mm256_setr_epi8(CODES, CODES);
+    const __m256i pairs = _mm256_set1_epi16(0x0401);
+    const __m256i quads = _mm256_set1_epi32(0x00100001);
+    const __m256i gather = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                            0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 1, 1, 1, 1, 1);
+    size_t flagged = 0;
+    size_t i = 0;
+
+    memset(nmask, 0, (len + 63) / 64 * sizeof(uint64_t));
+
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_or_si256(_mm256_loadu_si256((const __m256i*)(seq + i)), lower);
+        __m256i idx = _mm256_and_si256(v, nibble);
+        __m256i ok = _mm256_cmpeq_epi8(_mm256_shuffle_epi8(letters, idx), v);
+        __m256i code = _mm256_and_si256(_mm256_shuffle_epi8(codes, idx), ok);
+
+        uint32_t bad = ~(uint32_t)_mm256_movemask_epi8(ok);
+        nmask[i / 64] |= (uint64_t)bad << (i % 64);
+        flagged += (size_t)_mm_popcnt_u32(bad);
+
+        __m256i x = _mm256_madd_epi16(_mm256_maddubs_epi16(code, pairs), quads);
+        x = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(x, gather), order);
+        uint64_t out = (uint64_t)_mm_cvtsi128_si64(_mm256_castsi256_si128(x));
+        memcpy(packed + i / 4, &out, sizeof out);
+    }
+    return flagged + pack_from(seq, i, len, packed, nmask);
+}
+
+// AVX-512 compares straight into 64-bit masks, which are also the nmask
+// words, and narrows the 32-bit lanes to bytes in one instruction.
+__attribute__((target("avx512f,avx512bw,popcnt")))
+static size_t nt_valid_span_avx512(const char* seq, size_t len, nt_alphabet alphabet) {
+    const __m512i letters = alphabet == NT_ACGTN
+        ? _mm512_broadcast_i32x4(_mm_setr_epi8(LETTERS('N')))
+        : _mm512_broadcast_i32x4(_mm_setr_epi8(LETTERS(-1)));
+    size_t i = 0;
+
+    for (; i + 64 <= len; i += 64) {
+        __m512i v = _mm512_loadu_si512((const void*)(seq + i));
+        uint64_t bad = ~_mm512_cmpeq_epi8_mask(_mm512_shuffle_epi8(letters, v), v);
+        if (bad != 0) {
+            return i + (size_t)__builtin_ctzll(bad);
+        }
+    }
+    // Masked load covers the tail without reading past the buffer.
+    if (i < len) {
+        __mmask64 live = (1ULL << (len - i)) - 1;  // len - i < 64 here
+        __m512i v = _mm512_maskz_loadu_epi8(live, seq + i);
+        uint64_t bad = live & ~_mm512_mask_cmpeq_epi8_mask(live, _mm512_shuffle_epi8(letters, v), v);
+        return i + (bad != 0 ? (size_t)__builtin_ctzll(bad) : len - i);
+    }
+    return i;
+}
+
+__attribute__((target("avx512f,avx512bw,popcnt")))
+static size_t nt_pack_avx512(const char* seq, size_t len, uint8_t* packed, uint64_t* nmask) {
+    const __m512i lower = _mm512_set1_epi8(CASE_BIT);
+    const __m512i nibble = _mm512_set1_epi8(0x0f);
+    const __m512i letters = _mm512_broadcast_i32x4(_mm_setr_epi8(LOWER));
+    const __m512i codes = _mm512_broadcast_i32x4(_mm_setr_epi8(CODES));
+    const __m512i pairs = _mm512_set1_epi16(0x0401);
+    const __m512i quads = _mm512_set1_epi32(0x00100001);
+    size_t flagged = 0;
+
+    for (size_t i = 0; i < len; i += 64) {
+        __mmask64 live = len - i >= 64 ? ~0ULL : (1ULL << (len - i)) - 1;
+        __m512i v = _mm512_or_si512(_mm512_maskz_loadu_epi8(live, seq + i), lower);
+        __m512i idx = _mm512_and_si512(v, nibble);
+        __mmask64 ok = _mm512_mask_cmpeq_epi8_mask(live, _mm512_shuffle_epi8(letters, idx), v);
+        __m512i code = _mm512_maskz_mov_epi8(ok, _mm512_shuffle_epi8(codes, idx));
+
+        uint64_t bad = live & ~ok;
+        nmask[i / 64] = bad;
+        flagged += (size_t)_mm_popcnt_u64(bad);
+
+        __m512i x = _mm512_madd_epi16(_mm512_maddubs_epi16(code, pairs), quads);
+        size_t nbytes = len - i >= 64 ? 16 : (len - i + 3) / 4;
+        _mm512_mask_cvtepi32_storeu_epi8(packed + i / 4, (__mmask16)((1u << nbytes) - 1), x);
+    }
+    return flagged;
+}
+
+#endif // NT_X86
+
+static nt_span_fn span_impl = nt_valid_span_scalar;
+static nt_pack_fn pack_impl = nt_pack_scalar;
+static const char* span_name = "scalar";
+static const char* pack_name = "scalar";
+
+nt_span_fn nt_valid_span_kernel(cpu_level level) {
+    switch (level) {
+#ifdef NT_X86
+    case CPU_AVX512:
+        return nt_valid_span_avx512;
+    case CPU_AVX2:
+        return nt_valid_span_avx2;
+    case CPU_SSE2:
+        return nt_valid_span_sse2;
+#endif
+    case CPU_SCALAR:
+        return nt_valid_span_scalar;
+    default:
+        return NULL;
+    }
+}
+
+// Packing needs byte shuffles, which SSE2 lacks.
+nt_pack_fn nt_pack_kernel(cpu_level level) {
+    switch (level) {
+#ifdef NT_X86
+    case CPU_AVX512:
+        return nt_pack_avx512;
+    case CPU_AVX2:
+        return nt_pack_avx2;
+#endif
+    case CPU_SCALAR:
+        return nt_pack_scalar;
+    default:
+        return NULL;
+    }
+}
+
+__attribute__((constructor))
+static void pick_kernels(void) {
+    cpu_level top = cpu_detect();
+
+    // Each kernel falls back to the best level below top that has one.
+    for (int level = (int)top; level >= CPU_SCALAR; level--) {
+        if (nt_valid_span_kernel((cpu_level)level) != NULL) {
+            span_impl = nt_valid_span_kernel((cpu_level)level);
+            span_name = cpu_level_name((cpu_level)level);
+            break;
+        }
+    }
+    for (int level = (int)top; level >= CPU_SCALAR; level--) {
+        if (nt_pack_kernel((cpu_level)level) != NULL) {
+            pack_impl = nt_pack_kernel((cpu_level)level);
+            pack_name = cpu_level_name((cpu_level)level);
+            break;
+        }
+    }
+}
+
+size_t nt_valid_span(const char* seq, size_t len, nt_alphabet alphabet) {
+    return span_impl(seq, len, alphabet);
+}
+
+size_t nt_pack(const char* seq, size_t len, uint8_t* packed, uint64_t* nmask) {
+    return pack_impl(seq, len, packed, nmask);
+}
+
+const char* nt_valid_span_impl(void) {
+    return span_name;
+}
+
+const char* nt_pack_impl(void) {
+    return pack_name;
+}
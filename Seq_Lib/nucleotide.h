@@ -0,0 +1,66 @@
+// Nucleotide encoding shared by the tools: compile-time lookup tables,
+// validation of whole reads and ASCII-to-2-bit packing, with SSE2/AVX2/
+// AVX-512 kernels picked at load time like those of gccount.
+
+#ifndef _NUCLEOTIDE_H
+#define _NUCLEOTIDE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpu.h"
+
+// 2-bit codes of the bases, and the code of every other byte.
+#define NT_A 0
+#define NT_C 1
+#define NT_G 2
+#define NT_T 3
+#define NT_N 4  // N, ambiguity codes and anything else
+
+// Code of each byte value: NT_A to NT_T for ACGT in either case, NT_N for
+// all others. Indexing a table of five columns with it needs no branch.
+extern const uint8_t nt_code[256];
+
+// Base of each 2-bit code.
+extern const char nt_base[4];
+
+// Alphabets nt_valid_span accepts. Like the tools, they take upper case
+// only.
+typedef enum {
+    NT_ACGT = 1,
+    NT_ACGTN = 2,
+} nt_alphabet;
+
+// Alphabet bits of each byte value.
+extern const uint8_t nt_class[256];
+
+typedef size_t (*nt_span_fn)(const char* seq, size_t len, nt_alphabet alphabet);
+typedef size_t (*nt_pack_fn)(const char* seq, size_t len, uint8_t* packed,
+                             uint64_t* nmask);
+
+// Return length of the longest prefix of seq[0, len) made of alphabet,
+// so len if the whole sequence is valid.
+size_t nt_valid_span(const char* seq, size_t len, nt_alphabet alphabet);
+
+// Pack seq[0, len) two bits a base into packed, which must hold
+// (len + 3) / 4 bytes: base i goes in bits 2 * (i % 4) of byte i / 4 and
+// bits past the last base are zero. Bases other than ACGT (either case)
+// are packed as A and flagged in nmask, which must hold (len + 63) / 64
+// words: bit i % 64 of word i / 64. Return number of flagged bases.
+size_t nt_pack(const char* seq, size_t len, uint8_t* packed, uint64_t* nmask);
+
+// Byte-at-a-time reference versions of the above.
+size_t nt_valid_span_scalar(const char* seq, size_t len, nt_alphabet alphabet);
+size_t nt_pack_scalar(const char* seq, size_t len, uint8_t* packed, uint64_t* nmask);
+
+// Return kernels written for level, or NULL if this build has none. Only
+// call kernels for levels up to cpu_detect().
+nt_span_fn nt_valid_span_kernel(cpu_level level);
+nt_pack_fn nt_pack_kernel(cpu_level level);
+
+// Return names of the levels nt_valid_span and nt_pack dispatch to on
+// this CPU.
+const char* nt_valid_span_impl(void);
+const char* nt_pack_impl(void);
+
+#endif // _NUCLEOTIDE_H
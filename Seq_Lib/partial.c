@@ -0,0 +1,181 @@
+// Partial results as named arrays of counts, and their file format.
+
+#include "partial.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    char name[PT_NAME_MAX + 1];
+    uint64_t n;
+} pt_section_header;
+
+typedef struct {
+    char name[PT_NAME_MAX + 1];
+    size_t n;
+    uint64_t* v;
+} pt_section;
+
+struct partial {
+    size_t nsections;
+    size_t cap;
+    pt_section* sections;
+};
+
+partial* pt_new(void) {
+    return calloc(1, sizeof(partial));
+}
+
+static pt_section* find(const partial* p, const char* name) {
+    for (size_t i = 0; i < p->nsections; i++) {
+        if (strcmp(p->sections[i].name, name) == 0) {
+            return &p->sections[i];
+        }
+    }
+    return NULL;
+}
+
+int pt_add(partial* p, const char* name, const uint64_t* v, size_t n) {
+    if (strlen(name) > PT_NAME_MAX) {
+        return -1;
+    }
+    pt_section* s = find(p, name);
+    if (s == NULL) {
+        if (p->nsections == p->cap) {
+            size_t cap = p->cap ? 2 * p->cap : 8;
+            pt_section* grown = realloc(p->sections, cap * sizeof(pt_section));
+            if (grown == NULL) {
+                return -1;
+            }
+            p->sections = grown;
+            p->cap = cap;
+        }
+        s = &p->sections[p->nsections++];
+        memset(s, 0, sizeof *s);
+        strcpy(s->name, name);
+    }
+    if (n > s->n) {
+        uint64_t* grown = realloc(s->v, n * sizeof(uint64_t));
+        if (grown == NULL) {
+            return -1;
+        }
+        memset(grown + s->n, 0, (n - s->n) * sizeof(uint64_t));
+        s->v = grown;
+        s->n = n;
+    }
+    for (size_t i = 0; i < n; i++) {
+        s->v[i] += v[i];
+    }
+    return 0;
+}
+
+int pt_add1(partial* p, const char* name, uint64_t v) {
+    return pt_add(p, name, &v, 1);
+}
+
+const uint64_t* pt_get(const partial* p, const char* name, size_t* n) {
+    const pt_section* s = find(p, name);
+    *n = s ? s->n : 0;
+    return s ? s->v : NULL;
+}
+
+uint64_t pt_get1(const partial* p, const char* name) {
+    size_t n;
+    const uint64_t* v = pt_get(p, name, &n);
+    return n > 0 ? v[0] : 0;
+}
+
+int pt_merge(partial* into, const partial* from) {
+    for (size_t i = 0; i < from->nsections; i++) {
+        const pt_section* s = &from->sections[i];
+        if (pt_add(into, s->name, s->v, s->n) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int pt_write(const partial* p, const char* path) {
+    FILE* fp = fopen(path, "wb");
+    if (fp == NULL) {
+        return -1;
+    }
+    uint64_t count = p->nsections;
+    int ok = fwrite(PT_MAGIC, 1, 8, fp) == 8 && fwrite(&count, sizeof count, 1, fp) == 1;
+    for (size_t i = 0; ok && i < p->nsections; i++) {
+        const pt_section* s = &p->sections[i];
+        pt_section_header h;
+        memset(&h, 0, sizeof h);
+        strcpy(h.name, s->name);
+        h.n = s->n;
+        ok = fwrite(&h, sizeof h, 1, fp) == 1 && fwrite(s->v, sizeof(uint64_t), s->n, fp) == s->n;
+    }
+    int err = errno;
+    if (fclose(fp) != 0 && ok) {
+        return -1;
+    }
+    if (!ok) {
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+// Read the sections of partial file fp into p. Return 0, or an errno
+// value.
+static int read_sections(FILE* fp, partial* p) {
+    char magic[8];
+    uint64_t count;
+    if (fread(magic, 1, 8, fp) != 8 || memcmp(magic, PT_MAGIC, 8) != 0 ||
+        fread(&count, sizeof count, 1, fp) != 1) {
+        return EINVAL;
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        pt_section_header h;
+        if (fread(&h, sizeof h, 1, fp) != 1 || h.name[PT_NAME_MAX] != '\0' ||
+            h.n > SIZE_MAX / sizeof(uint64_t)) {
+            return EINVAL;
+        }
+        uint64_t* v = malloc(h.n ? h.n * sizeof(uint64_t) : 1);
+        if (v == NULL) {
+            return ENOMEM;
+        }
+        int err = fread(v, sizeof(uint64_t), h.n, fp) != h.n ? EINVAL
+                  // A name repeated in one file is summed like any other.
+                  : pt_add(p, h.name, v, h.n) != 0 ? ENOMEM : 0;
+        free(v);
+        if (err != 0) {
+            return err;
+        }
+    }
+    return fgetc(fp) == EOF ? 0 : EINVAL;
+}
+
+partial* pt_read(const char* path) {
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return NULL;
+    }
+    partial* p = pt_new();
+    int err = p ? read_sections(fp, p) : ENOMEM;
+    fclose(fp);
+    if (err != 0) {
+        pt_free(p);
+        errno = err;
+        return NULL;
+    }
+    return p;
+}
+
+void pt_free(partial* p) {
+    if (p == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < p->nsections; i++) {
+        free(p->sections[i].v);
+    }
+    free(p->sections);
+    free(p);
+}
@@ -0,0 +1,69 @@
+// Partial results: a tool's counts for part of a run, saved in a compact
+// binary file so runs split across machines can be merged exactly.
+//
+// A partial is a set of named sections, each an array of 64-bit counts:
+// totals, histograms and row-major per-cycle matrices. Every section is
+// additive, so merging two partials adds matching sections element by
+// element, and a section one side lacks (or has fewer cycle rows of)
+// counts as zeros. Counts never pass through floating point, so merged
+// partials give exactly the numbers one run over all the input would.
+//
+// Section names used by the tools, each with "R1." or "R2." in front for
+// the mates of paired input:
+//   reads        reads counted
+//   gc_sum       sum of per-read GC fractions, see gc_frac
+//   gc_hist      GC_BINS counts: reads by GC percentage
+//   gc_cycles    5 counts per cycle: A, C, G, T and N bases
+//   qual_bases   bases with a quality
+//   qual_sum     sum of their Phred scores
+//   qual_cycles  QS_SCORES counts per cycle: bases by Phred score
+//   read_qual    QS_SCORES counts: reads by mean Phred score
+//
+// The file is in host byte order: an 8-byte magic and the section count,
+// then each section as a 32-byte NUL-padded name, its length and its
+// counts.
+
+#ifndef _PARTIAL_H
+#define _PARTIAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PT_MAGIC "SEQLIBP1"     // first 8 bytes of every partial file
+#define PT_NAME_MAX 31          // longest section name
+
+// Partial structure: create with pt_new or pt_read, free with pt_free.
+typedef struct partial partial;
+
+// Return new empty partial, or NULL if out of memory.
+partial* pt_new(void);
+
+// Add counts v[0, n) to section name, creating it or growing it with
+// zeros first as needed. Return 0, or -1 if out of memory or name is too
+// long.
+int pt_add(partial* p, const char* name, const uint64_t* v, size_t n);
+
+// Add a single count to section name, as pt_add with n = 1.
+int pt_add1(partial* p, const char* name, uint64_t v);
+
+// Return counts of section name and set *n to their number, or return
+// NULL (and set *n to 0) if p has no such section.
+const uint64_t* pt_get(const partial* p, const char* name, size_t* n);
+
+// Return first count of section name, or 0 if there is none.
+uint64_t pt_get1(const partial* p, const char* name);
+
+// Add every section of from to into. Return 0, or -1 if out of memory.
+int pt_merge(partial* into, const partial* from);
+
+// Write p to path. Return 0, or -1 on failure (errno is set).
+int pt_write(const partial* p, const char* path);
+
+// Read partial file at path. Return it, or NULL on failure (errno is
+// set, to EINVAL if the file is not a valid partial).
+partial* pt_read(const char* path);
+
+// Free partial.
+void pt_free(partial* p);
+
+#endif // _PARTIAL_H
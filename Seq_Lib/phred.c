@@ -0,0 +1,59 @@
+// Phred offset detection from a sample of reads.
+
+#include "phred.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include "fqreader.h"
+
+int phred_guess(int min, int max) {
+    if (min > max || min < ';') {
+        return 33;
+    }
+    return max > 'J' ? 64 : 33;
+}
+
+void phred_range(const char* qual, size_t len, int* min, int* max) {
+    int lo = *min, hi = *max;
+    for (size_t j = 0; j < len; j++) {
+        int b = (unsigned char)qual[j];
+        lo = b < lo ? b : lo;
+        hi = b > hi ? b : hi;
+    }
+    *min = lo;
+    *max = hi;
+}
+
+int phred_detect(const char* path, size_t nreads) {
+    fq_reader* r = fq_open(path);
+    if (r == NULL) {
+        return -1;
+    }
+
+    // A quality of 33 rules out 64 at once, so most files stop after a
+    // read or two.
+    int min = 256, max = -1;
+    fq_record rec;
+    int status = 1;
+    for (size_t i = 0; i < nreads && min >= ';' && (status = fq_next(r, &rec)) == 1; i++) {
+        phred_range(rec.qual, rec.qual_len, &min, &max);
+    }
+    fq_close(r);
+
+    if (status == -1) {
+        errno = EINVAL;
+        return -1;
+    }
+    return phred_guess(min, max);
+}
+
+int phred_parse(const char* s) {
+    if (strcmp(s, "33") == 0) {
+        return 33;
+    }
+    if (strcmp(s, "64") == 0) {
+        return 64;
+    }
+    return strcmp(s, "auto") == 0 ? 0 : -1;
+}
@@ -0,0 +1,35 @@
+// Phred quality encoding detection.
+//
+// Qualities are stored as Phred + 33 in current FASTQ files, and as
+// Phred + 64 in older Illumina (1.3 to 1.7) and Solexa runs. The offset
+// is guessed from the lowest and highest quality bytes of a file's first
+// reads: bytes below ';' only occur in Phred + 33, and with none of those,
+// bytes past 'J' (Q41 in Phred + 33) only occur in Phred + 64.
+
+#ifndef _PHRED_H
+#define _PHRED_H
+
+#include <stddef.h>
+
+#define PHRED_SAMPLE_READS 10000  // reads phred_detect looks at by default
+
+// Return 33 or 64 for qualities whose bytes span [min, max]. Files with
+// bytes in both encodings' common range only (';' to 'J') are taken to be
+// Phred + 33, which is far the more likely. min > max (no qualities) gives
+// 33.
+int phred_guess(int min, int max);
+
+// Widen [*min, *max] to take in the len quality bytes at qual. Start
+// from min 256 and max -1, which phred_guess takes as no qualities.
+void phred_range(const char* qual, size_t len, int* min, int* max);
+
+// Return the offset of FASTQ file path (anything fq_open reads) guessed
+// from its first nreads reads, or -1 if it could not be opened or is not
+// valid FASTQ (errno is set).
+int phred_detect(const char* path, size_t nreads);
+
+// Parse a tool's offset option: "33", "64" or "auto". Return the offset,
+// 0 for auto, or -1 if s is none of those.
+int phred_parse(const char* s);
+
+#endif // _PHRED_H
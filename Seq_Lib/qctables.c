@@ -0,0 +1,94 @@
+// Report tables of GC and quality counts.
+
+#include "qctables.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "qualstat.h"
+
+FILE* qt_open(const char* prefix, const char* mate, const char* name) {
+    size_t len = strlen(prefix) + strlen(mate) + strlen(name) + 2;
+    char* path = malloc(len);
+    if (path == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return NULL;
+    }
+    snprintf(path, len, "%s.%s%s", prefix, mate, name);
+    FILE* fp = fopen(path, "w");
+    if (fp == NULL) {
+        perror("fopen");
+        fprintf(stderr, "x Failed to write '%s'\n", path);
+    }
+    free(path);
+    return fp;
+}
+
+int qt_close(FILE* fp, const char* prefix, const char* mate, const char* name) {
+    if (fclose(fp) != 0) {
+        perror("fclose");
+        fprintf(stderr, "x Failed to write '%s.%s%s'\n", prefix, mate, name);
+        return -1;
+    }
+    return 0;
+}
+
+void qt_gc_hist(FILE* fp, const uint64_t* hist) {
+    fprintf(fp, "gc_percent\treads\n");
+    for (size_t b = 0; b < QT_GC_BINS; b++) {
+        fprintf(fp, "%zu\t%llu\n", b, (unsigned long long)hist[b]);
+    }
+}
+
+void qt_gc_cycles(FILE* fp, const uint64_t* cycle, size_t ncycles) {
+    fprintf(fp, "cycle\tA\tC\tG\tT\tN\tGC_fraction\n");
+    for (size_t j = 0; j < ncycles; j++) {
+        const uint64_t* row = cycle + j * QT_CODES;
+        uint64_t bases = row[0] + row[1] + row[2] + row[3] + row[4];
+        fprintf(fp, "%zu\t%llu\t%llu\t%llu\t%llu\t%llu\t%.4f\n", j + 1,
+                (unsigned long long)row[0], (unsigned long long)row[1],
+                (unsigned long long)row[2], (unsigned long long)row[3],
+                (unsigned long long)row[4],
+                bases ? (double)(row[1] + row[2]) / (double)bases : 0.0);
+    }
+}
+
+void qt_qual_cycles(FILE* fp, const uint64_t* cycle, size_t ncycles) {
+    // Columns run up to the highest score seen.
+    int max_q = 0;
+    for (size_t k = 0; k < ncycles * QS_SCORES; k++) {
+        if (cycle[k] && (int)(k % QS_SCORES) > max_q) {
+            max_q = (int)(k % QS_SCORES);
+        }
+    }
+
+    fprintf(fp, "cycle\tmean");
+    for (int q = 0; q <= max_q; q++) {
+        fprintf(fp, "\tQ%d", q);
+    }
+    fprintf(fp, "\n");
+
+    for (size_t j = 0; j < ncycles; j++) {
+        const uint64_t* row = cycle + j * QS_SCORES;
+        uint64_t bases = 0;
+        uint64_t sum = 0;
+        for (int q = 0; q < QS_SCORES; q++) {
+            bases += row[q];
+            sum += row[q] * (uint64_t)q;
+        }
+        fprintf(fp, "%zu\t%.2f", j + 1, bases ? (double)sum / (double)bases : 0.0);
+        for (int q = 0; q <= max_q; q++) {
+            fprintf(fp, "\t%llu", (unsigned long long)row[q]);
+        }
+        fprintf(fp, "\n");
+    }
+}
+
+void qt_read_qual(FILE* fp, const uint64_t* read_mean) {
+    fprintf(fp, "mean_quality\treads\n");
+    for (int q = 0; q < QS_SCORES; q++) {
+        if (read_mean[q]) {
+            fprintf(fp, "%d\t%llu\n", q, (unsigned long long)read_mean[q]);
+        }
+    }
+}
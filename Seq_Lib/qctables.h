@@ -0,0 +1,37 @@
+// Report tables shared by the tools and by qcmerge, so a table written
+// from merged partial results is byte for byte the one a single run
+// writes.
+
+#ifndef _QCTABLES_H
+#define _QCTABLES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define QT_GC_BINS 101  // whole GC percentages 0 to 100
+#define QT_CODES 5      // base counts per cycle: A, C, G, T and N
+
+// Open PREFIX.<mate><name> for writing, or report the failure and return
+// NULL.
+FILE* qt_open(const char* prefix, const char* mate, const char* name);
+
+// Close a table opened with qt_open. Return 0, or -1 after reporting a
+// failure.
+int qt_close(FILE* fp, const char* prefix, const char* mate, const char* name);
+
+// gc_hist.tsv: reads by GC percentage, hist[QT_GC_BINS].
+void qt_gc_hist(FILE* fp, const uint64_t* hist);
+
+// cycles.tsv: QT_CODES base counts and the GC fraction of each cycle.
+void qt_gc_cycles(FILE* fp, const uint64_t* cycle, size_t ncycles);
+
+// qual_cycles.tsv: mean and count of every Phred score of each cycle,
+// QS_SCORES counts a row, with columns up to the highest score seen.
+void qt_qual_cycles(FILE* fp, const uint64_t* cycle, size_t ncycles);
+
+// read_qual.tsv: reads by mean Phred score, read_mean[QS_SCORES]; only
+// scores some read has.
+void qt_read_qual(FILE* fp, const uint64_t* read_mean);
+
+#endif // _QCTABLES_H
@@ -0,0 +1,218 @@
+// Quality binning tables and the shuffle kernels that apply them.
+
+#include "qualbin.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define QB_X86 1
+#endif
+
+#define QB_MAX_SCORE 93     // highest score printable with offset 33
+
+typedef struct {
+    int lo, hi, q;
+} qb_range;
+
+static const qb_range ILLUMINA8[] = {
+    {2, 9, 6}, {10, 19, 15}, {20, 24, 22}, {25, 29, 27},
+    {30, 34, 33}, {35, 39, 37}, {40, QB_MAX_SCORE, 40},
+};
+
+static const qb_range NOVASEQ[] = {
+    {2, 14, 12}, {15, 30, 23}, {31, QB_MAX_SCORE, 37},
+};
+
+// Parse "LO-HI:Q[,LO-HI:Q...]" into ranges[0, max). Return the number of
+// ranges, or -1 if s is not such a list.
+static int parse_ranges(const char* s, qb_range* ranges, int max) {
+    int n = 0;
+    while (n < max) {
+        char* end;
+        long lo = strtol(s, &end, 10);
+        if (end == s || *end != '-') {
+            return -1;
+        }
+        s = end + 1;
+        long hi = strtol(s, &end, 10);
+        if (end == s || *end != ':') {
+            return -1;
+        }
+        s = end + 1;
+        long q = strtol(s, &end, 10);
+        if (end == s || lo < 0 || hi < lo || hi > 255 || q < 0 || q > 255) {
+            return -1;
+        }
+        ranges[n++] = (qb_range){(int)lo, (int)hi, (int)q};
+        if (*end == '\0') {
+            return n;
+        }
+        if (*end != ',') {
+            return -1;
+        }
+        s = end + 1;
+    }
+    return -1;
+}
+
+int qb_table_init(qb_table* t, const char* scheme, int in_offset, int out_offset) {
+    qb_range custom[256];
+    const qb_range* ranges;
+    int n;
+
+    if (strcmp(scheme, "illumina8") == 0) {
+        ranges = ILLUMINA8;
+        n = sizeof ILLUMINA8 / sizeof ILLUMINA8[0];
+    } else if (strcmp(scheme, "novaseq") == 0) {
+        ranges = NOVASEQ;
+        n = sizeof NOVASEQ / sizeof NOVASEQ[0];
+    } else if (strcmp(scheme, "none") == 0) {
+        ranges = NULL;
+        n = 0;
+    } else if ((n = parse_ranges(scheme, custom, 256)) > 0) {
+        ranges = custom;
+    } else {
+        return -1;
+    }
+    if (in_offset < 0 || in_offset > '~' || out_offset < 0 || out_offset > '~') {
+        return -1;
+    }
+
+    for (int b = 0; b < 256; b++) {
+        int q = b - in_offset;
+
+        // Only printable bytes past the offset are qualities.
+        if (q < 0 || b < '!' || b > '~') {
+            t->map[b] = (uint8_t)b;
+            continue;
+        }
+        for (int i = 0; i < n; i++) {
+            if (q >= ranges[i].lo && q <= ranges[i].hi) {
+                q = ranges[i].q;
+                break;
+            }
+        }
+        t->map[b] = (uint8_t)(q + out_offset > '~' ? '~' : q + out_offset);
+    }
+
+    // Shuffle table h holds map[16h, 16h + 16) XOR the table before it,
+    // so XOR-ing the lookups of x - 16h over h telescopes to map[x]: every
+    // lookup past x's own table gets a negative index, and pshufb returns
+    // 0 for those. Bytes 128 and up map to themselves and need no table.
+    for (int h = 0; h < 8; h++) {
+        for (int i = 0; i < 16; i++) {
+            uint8_t prev = h > 0 ? t->map[16 * (h - 1) + i] : 0;
+            t->_steps[h][i] = t->map[16 * h + i] ^ prev;
+        }
+    }
+    return 0;
+}
+
+void qb_apply_scalar(const qb_table* t, const char* in, size_t len, char* out) {
+    for (size_t i = 0; i < len; i++) {
+        out[i] = (char)t->map[(unsigned char)in[i]];
+    }
+}
+
+#ifdef QB_X86
+
+// There is no SSE2 kernel: pshufb came in with SSSE3.
+
+__attribute__((target("avx2")))
+static inline __m256i chain_avx2(const __m256i steps[8], __m256i x) {
+    const __m256i sixteen = _mm256_set1_epi8(16);
+    __m256i acc = _mm256_shuffle_epi8(steps[0], x);
+    for (int h = 1; h < 8; h++) {
+        x = _mm256_sub_epi8(x, sixteen);
+        acc = _mm256_xor_si256(acc, _mm256_shuffle_epi8(steps[h], x));
+    }
+    return acc;
+}
+
+__attribute__((target("avx2")))
+static void qb_apply_avx2(const qb_table* t, const char* in, size_t len, char* out) {
+    __m256i steps[8];
+    for (int h = 0; h < 8; h++) {
+        steps[h] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)t->_steps[h]));
+    }
+
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(in + i));
+        // Bytes with the top bit set are kept as they are.
+        __m256i y = _mm256_blendv_epi8(chain_avx2(steps, x), x, x);
+        _mm256_storeu_si256((__m256i*)(out + i), y);
+    }
+    qb_apply_scalar(t, in + i, len - i, out + i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static inline __m512i chain_avx512(const __m512i steps[8], __m512i x) {
+    const __m512i sixteen = _mm512_set1_epi8(16);
+    __m512i acc = _mm512_shuffle_epi8(steps[0], x);
+    for (int h = 1; h < 8; h++) {
+        x = _mm512_sub_epi8(x, sixteen);
+        acc = _mm512_xor_si512(acc, _mm512_shuffle_epi8(steps[h], x));
+    }
+    return acc;
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void qb_apply_avx512(const qb_table* t, const char* in, size_t len, char* out) {
+    __m512i steps[8];
+    for (int h = 0; h < 8; h++) {
+        steps[h] = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*)t->_steps[h]));
+    }
+
+    for (size_t i = 0; i < len; i += 64) {
+        // Masked load and store cover the tail without touching bytes
+        // past either buffer.
+        __mmask64 live = len - i >= 64 ? ~0ULL : (1ULL << (len - i)) - 1;
+        __m512i x = _mm512_maskz_loadu_epi8(live, in + i);
+        __m512i y = _mm512_mask_blend_epi8(_mm512_movepi8_mask(x), chain_avx512(steps, x), x);
+        _mm512_mask_storeu_epi8(out + i, live, y);
+    }
+}
+
+#endif // QB_X86
+
+static qb_apply_fn impl = qb_apply_scalar;
+static const char* impl_name = "scalar";
+
+qb_apply_fn qb_apply_kernel(cpu_level level) {
+    switch (level) {
+#ifdef QB_X86
+    case CPU_AVX512:
+        return qb_apply_avx512;
+    case CPU_AVX2:
+        return qb_apply_avx2;
+#endif
+    case CPU_SCALAR:
+        return qb_apply_scalar;
+    default:
+        return NULL;
+    }
+}
+
+__attribute__((constructor))
+static void pick_kernel(void) {
+    // Fall back level by level: there is no SSE2 kernel.
+    for (int level = cpu_detect(); level >= CPU_SCALAR; level--) {
+        qb_apply_fn fn = qb_apply_kernel((cpu_level)level);
+        if (fn != NULL) {
+            impl = fn;
+            impl_name = cpu_level_name((cpu_level)level);
+            return;
+        }
+    }
+}
+
+void qb_apply(const qb_table* t, const char* in, size_t len, char* out) {
+    impl(t, in, len, out);
+}
+
+const char* qb_apply_impl(void) {
+    return impl_name;
+}
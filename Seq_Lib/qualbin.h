@@ -0,0 +1,52 @@
+// Quality binning and re-encoding through a 256-entry byte table, applied
+// with SIMD shuffles (AVX2 and AVX-512 kernels picked at load time) or a
+// byte-at-a-time lookup.
+
+#ifndef _QUALBIN_H
+#define _QUALBIN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpu.h"
+
+// Byte map, plus its first half cut into 16-entry shuffle tables. Bytes
+// 128 and up are never qualities and always map to themselves.
+typedef struct {
+    uint8_t map[256];
+
+    // Don't use this field directly.
+    uint8_t _steps[8][16];
+} qb_table;
+
+typedef void (*qb_apply_fn)(const qb_table* t, const char* in, size_t len, char* out);
+
+// Build t for scheme, reading qualities encoded as Phred + in_offset and
+// writing them as Phred + out_offset. Bytes that are not a quality for
+// in_offset are copied unchanged. scheme is one of
+//   illumina8 : 2-9 to 6, 10-19 to 15, 20-24 to 22, 25-29 to 27,
+//               30-34 to 33, 35-39 to 37, 40 and up to 40
+//   novaseq   : 2-14 to 12, 15-30 to 23, 31 and up to 37
+//   none      : scores kept, only the offset changes
+// or a custom list of LO-HI:Q ranges such as "0-19:10,20-41:30", scores
+// outside every range being kept. Scores below 2 are kept by the named
+// schemes, since Q2 is the no-call score. Scores past '~' in the output
+// encoding are capped there. Return 0, or -1 if scheme or an offset is
+// not valid.
+int qb_table_init(qb_table* t, const char* scheme, int in_offset, int out_offset);
+
+// Write t->map[in[i]] to out[i] for i in [0, len). in and out may be the
+// same buffer.
+void qb_apply(const qb_table* t, const char* in, size_t len, char* out);
+
+// Byte-at-a-time reference version of qb_apply.
+void qb_apply_scalar(const qb_table* t, const char* in, size_t len, char* out);
+
+// Return kernel written for level, or NULL if this build has none. Only
+// call kernels for levels up to cpu_detect().
+qb_apply_fn qb_apply_kernel(cpu_level level);
+
+// Return name of the kernel qb_apply dispatches to on this CPU.
+const char* qb_apply_impl(void);
+
+#endif // _QUALBIN_H
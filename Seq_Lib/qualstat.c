@@ -0,0 +1,237 @@
+// Cycle x score matrices in narrow counters, and vectorized quality sums.
+
+#include "qualstat.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define QS_X86 1
+#endif
+
+// Clamped score of byte b for Phred + off, and the table of all 256 built
+// at compile time, so reads in either common encoding are counted through
+// a constant table.
+#define SCORE(b, off) ((b) < (off) ? 0 : (b) - (off) >= QS_SCORES ? QS_SCORES - 1 : (b) - (off))
+#define SCORES4(b, off) SCORE(b, off), SCORE((b) + 1, off), SCORE((b) + 2, off), SCORE((b) + 3, off)
+#define SCORES16(b, off) SCORES4(b, off), SCORES4((b) + 4, off), SCORES4((b) + 8, off), SCORES4((b) + 12, off)
+#define SCORES64(b, off) SCORES16(b, off), SCORES16((b) + 16, off), SCORES16((b) + 32, off), SCORES16((b) + 48, off)
+#define SCORES256(off) SCORES64(0, off), SCORES64(64, off), SCORES64(128, off), SCORES64(192, off)
+
+static const uint8_t SCORE_33[256] = {SCORES256(33)};
+static const uint8_t SCORE_64[256] = {SCORES256(64)};
+
+void qs_init(qual_stats* s, int offset) {
+    memset(s, 0, sizeof *s);
+    s->offset = offset;
+    for (int b = 0; b < 256; b++) {
+        int q = b - offset;
+        s->_score[b] = (uint8_t)(q < 0 ? 0 : q >= QS_SCORES ? QS_SCORES - 1 : q);
+    }
+}
+
+// Make room for cycles rows in *rows (of *have), zeroing the new ones.
+static int grow(void** rows, size_t* have, size_t cycles, size_t row_bytes) {
+    if (cycles <= *have) {
+        return 0;
+    }
+    char* grown = realloc(*rows, cycles * row_bytes);
+    if (grown == NULL) {
+        return -1;
+    }
+    memset(grown + *have * row_bytes, 0, (cycles - *have) * row_bytes);
+    *rows = grown;
+    *have = cycles;
+    return 0;
+}
+
+int qs_flush(qual_stats* s) {
+    if (grow((void**)&s->cycle, &s->ncycles, s->_narrow_cycles, QS_SCORES * sizeof(uint64_t)) != 0) {
+        return -1;
+    }
+    size_t n = s->_narrow_cycles * QS_SCORES;
+    for (size_t i = 0; i < n; i++) {
+        s->cycle[i] += s->_narrow[i];
+    }
+    if (n > 0) {
+        memset(s->_narrow, 0, n * sizeof(uint16_t));
+    }
+    s->_pending = 0;
+    return 0;
+}
+
+// Count one read into the narrow rows and histogram its mean score, for
+// qualities encoded as Phred + offset with score as the byte table.
+// Inlined with a constant offset and table, the loop has neither a branch
+// nor a subtraction per base.
+static inline __attribute__((always_inline))
+void add_read(qual_stats* s, const char* qual, size_t len, int offset, const uint8_t* score) {
+    // Bases of a read go to different rows, so the increments don't
+    // wait on each other.
+    uint16_t* row = s->_narrow;
+    for (size_t j = 0; j < len; j++, row += QS_SCORES) {
+        row[score[(unsigned char)qual[j]]]++;
+    }
+    s->_pending++;
+
+    // Bytes below the offset are not valid qualities; they are not
+    // clamped here, only kept from taking the sum below zero.
+    uint64_t raw = qs_sum(qual, len);
+    uint64_t base = (uint64_t)offset * len;
+    uint64_t sum = raw > base ? raw - base : 0;
+
+    if (len > 0) {
+        uint64_t mean = (2 * sum + len) / (2 * len);
+        s->read_mean[mean < QS_SCORES ? mean : QS_SCORES - 1]++;
+    }
+    s->nreads++;
+    s->nbases += len;
+    s->qsum += sum;
+}
+
+int qs_add(qual_stats* s, const char* qual, size_t len) {
+    if (s->_pending == QS_FLUSH_READS && qs_flush(s) != 0) {
+        return -1;
+    }
+    if (grow((void**)&s->_narrow, &s->_narrow_cycles, len, QS_SCORES * sizeof(uint16_t)) != 0) {
+        return -1;
+    }
+
+    switch (s->offset) {
+    case 33:
+        add_read(s, qual, len, 33, SCORE_33);
+        break;
+    case 64:
+        add_read(s, qual, len, 64, SCORE_64);
+        break;
+    default:
+        add_read(s, qual, len, s->offset, s->_score);
+        break;
+    }
+    return 0;
+}
+
+int qs_merge(qual_stats* into, qual_stats* from) {
+    if (qs_flush(into) != 0 || qs_flush(from) != 0) {
+        return -1;
+    }
+    if (grow((void**)&into->cycle, &into->ncycles, from->ncycles, QS_SCORES * sizeof(uint64_t)) != 0) {
+        return -1;
+    }
+    for (size_t i = 0; i < from->ncycles * QS_SCORES; i++) {
+        into->cycle[i] += from->cycle[i];
+    }
+    for (int q = 0; q < QS_SCORES; q++) {
+        into->read_mean[q] += from->read_mean[q];
+    }
+    into->nreads += from->nreads;
+    into->nbases += from->nbases;
+    into->qsum += from->qsum;
+    return 0;
+}
+
+void qs_free(qual_stats* s) {
+    free(s->cycle);
+    free(s->_narrow);
+    s->cycle = NULL;
+    s->_narrow = NULL;
+    s->ncycles = 0;
+    s->_narrow_cycles = 0;
+}
+
+uint64_t qs_sum_scalar(const char* qual, size_t len) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < len; i++) {
+        sum += (unsigned char)qual[i];
+    }
+    return sum;
+}
+
+#ifdef QS_X86
+
+// sad_epu8 against zero adds up each run of 8 bytes into a 64-bit lane.
+
+__attribute__((target("sse2")))
+static uint64_t qs_sum_sse2(const char* qual, size_t len) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sums = zero;
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        sums = _mm_add_epi64(sums, _mm_sad_epu8(_mm_loadu_si128((const __m128i*)(qual + i)), zero));
+    }
+    uint64_t sum = (uint64_t)_mm_cvtsi128_si64(sums) +
+                   (uint64_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(sums, sums));
+    return sum + qs_sum_scalar(qual + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static uint64_t qs_sum_avx2(const char* qual, size_t len) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i sums = zero;
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        sums = _mm256_add_epi64(sums, _mm256_sad_epu8(_mm256_loadu_si256((const __m256i*)(qual + i)), zero));
+    }
+    __m128i half = _mm_add_epi64(_mm256_castsi256_si128(sums),
+                                 _mm256_extracti128_si256(sums, 1));
+    uint64_t sum = (uint64_t)_mm_cvtsi128_si64(half) +
+                   (uint64_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(half, half));
+    return sum + qs_sum_scalar(qual + i, len - i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static uint64_t qs_sum_avx512(const char* qual, size_t len) {
+    const __m512i zero = _mm512_setzero_si512();
+    __m512i sums = zero;
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        sums = _mm512_add_epi64(sums, _mm512_sad_epu8(_mm512_loadu_si512((const void*)(qual + i)), zero));
+    }
+    // Masked load covers the tail without reading past the buffer.
+    if (i < len) {
+        __mmask64 live = (1ULL << (len - i)) - 1;  // len - i < 64 here
+        sums = _mm512_add_epi64(sums, _mm512_sad_epu8(_mm512_maskz_loadu_epi8(live, qual + i), zero));
+    }
+    return (uint64_t)_mm512_reduce_add_epi64(sums);
+}
+
+#endif // QS_X86
+
+static qs_sum_fn impl = qs_sum_scalar;
+static const char* impl_name = "scalar";
+
+qs_sum_fn qs_sum_kernel(cpu_level level) {
+    switch (level) {
+#ifdef QS_X86
+    case CPU_AVX512:
+        return qs_sum_avx512;
+    case CPU_AVX2:
+        return qs_sum_avx2;
+    case CPU_SSE2:
+        return qs_sum_sse2;
+#endif
+    case CPU_SCALAR:
+        return qs_sum_scalar;
+    default:
+        return NULL;
+    }
+}
+
+__attribute__((constructor))
+static void pick_kernel(void) {
+    cpu_level level = cpu_detect();
+    qs_sum_fn fn = qs_sum_kernel(level);
+    if (fn != NULL) {
+        impl = fn;
+        impl_name = cpu_level_name(level);
+    }
+}
+
+uint64_t qs_sum(const char* qual, size_t len) {
+    return impl(qual, len);
+}
+
+const char* qs_sum_impl(void) {
+    return impl_name;
+}
@@ -0,0 +1,71 @@
+// Quality statistics: a cycle x Phred score count matrix and a histogram
+// of per-read mean quality, as in FastQC's per-base and per-sequence
+// quality reports.
+//
+// Each base adds one to a 16-bit counter, so a row of scores for a cycle
+// takes 128 bytes and the counters for a whole read stay in L1 cache.
+// A counter can gain at most one per read, so every QS_FLUSH_READS reads
+// the narrow counters are added into the 64-bit matrix and cleared.
+// Per-read quality sums use a vector kernel (psadbw) picked for the CPU.
+// Threads keep their own qual_stats and merge them at the end.
+
+#ifndef _QUALSTAT_H
+#define _QUALSTAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpu.h"
+
+#define QS_SCORES 64            // Phred scores 0 to 63; others are clamped
+#define QS_FLUSH_READS 65535    // reads a 16-bit counter can take
+
+typedef struct {
+    int offset;                 // 33 or 64
+    size_t ncycles;             // rows of cycle
+    uint64_t* cycle;            // cycle[j * QS_SCORES + q]: bases of cycle j scoring q
+    uint64_t read_mean[QS_SCORES]; // reads by mean score, rounded
+    uint64_t nreads;
+    uint64_t nbases;
+    uint64_t qsum;              // sum of all scores
+
+    // Don't use these fields directly.
+    uint16_t* _narrow;          // counts not yet in cycle, same layout
+    size_t _narrow_cycles;
+    size_t _pending;            // reads in _narrow
+    uint8_t _score[256];        // quality byte to clamped score
+} qual_stats;
+
+typedef uint64_t (*qs_sum_fn)(const char* qual, size_t len);
+
+// Set up empty stats for qualities encoded as Phred + offset.
+void qs_init(qual_stats* s, int offset);
+
+// Add one read's quality string. Return 0, or -1 if out of memory.
+int qs_add(qual_stats* s, const char* qual, size_t len);
+
+// Move pending counts into s->cycle, which is up to date afterwards.
+// Return 0, or -1 if out of memory.
+int qs_flush(qual_stats* s);
+
+// Add from into into (both flushed first). Return 0, or -1 if out of
+// memory.
+int qs_merge(qual_stats* into, qual_stats* from);
+
+// Free the stats' buffers.
+void qs_free(qual_stats* s);
+
+// Return the sum of the bytes of qual[0, len).
+uint64_t qs_sum(const char* qual, size_t len);
+
+// Byte-at-a-time reference version of qs_sum.
+uint64_t qs_sum_scalar(const char* qual, size_t len);
+
+// Return kernel written for level, or NULL if this build has none. Only
+// call kernels for levels up to cpu_detect().
+qs_sum_fn qs_sum_kernel(cpu_level level);
+
+// Return name of the kernel qs_sum dispatches to on this CPU.
+const char* qs_sum_impl(void);
+
+#endif // _QUALSTAT_H
@@ -0,0 +1,107 @@
+// Struct-of-arrays read batch.
+
+#include "readbatch.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_READS 1024
+#define INITIAL_BYTES (256u << 10)
+
+void rb_init(read_batch* b) {
+    memset(b, 0, sizeof(*b));
+}
+
+void rb_clear(read_batch* b) {
+    b->n = 0;
+}
+
+// Grow *buf (holding cap elements of size elem) to hold at least need.
+static int grow(void** buf, size_t* cap, size_t need, size_t elem,
+                size_t initial) {
+    if (need <= *cap) {
+        return 1;
+    }
+    size_t new_cap = *cap ? *cap : initial;
+    while (new_cap < need) {
+        new_cap *= 2;
+    }
+    void* p = realloc(*buf, new_cap * elem);
+    if (p == NULL) {
+        return 0;
+    }
+    *buf = p;
+    *cap = new_cap;
+    return 1;
+}
+
+int rb_push(read_batch* b, const fq_record* rec) {
+    size_t reads_cap = b->_cap;
+    size_t bytes = b->n ? b->off[b->n] : 0;
+    size_t name_bytes = b->n ? b->name_off[b->n] : 0;
+
+    // Offset arrays need n + 2 entries once this read is in.
+    if (!grow((void**)&b->off, &reads_cap, b->n + 2, sizeof(size_t),
+              INITIAL_READS)) {
+        return 0;
+    }
+    reads_cap = b->_cap;
+    if (!grow((void**)&b->name_off, &reads_cap, b->n + 2, sizeof(size_t),
+              INITIAL_READS)) {
+        return 0;
+    }
+    b->_cap = reads_cap;
+
+    size_t bytes_cap = b->_bytes_cap;
+    if (!grow((void**)&b->seq, &bytes_cap, bytes + rec->seq_len, 1,
+              INITIAL_BYTES)) {
+        return 0;
+    }
+    bytes_cap = b->_bytes_cap;
+    if (!grow((void**)&b->qual, &bytes_cap, bytes + rec->seq_len, 1,
+              INITIAL_BYTES)) {
+        return 0;
+    }
+    b->_bytes_cap = bytes_cap;
+
+    if (!grow((void**)&b->name, &b->_name_cap, name_bytes + rec->name_len,
+              1, INITIAL_BYTES)) {
+        return 0;
+    }
+
+    b->off[0] = 0;
+    b->name_off[0] = 0;
+    memcpy(b->seq + bytes, rec->seq, rec->seq_len);
+    memcpy(b->qual + bytes, rec->qual, rec->seq_len);
+    memcpy(b->name + name_bytes, rec->name, rec->name_len);
+    b->n++;
+    b->off[b->n] = bytes + rec->seq_len;
+    b->name_off[b->n] = name_bytes + rec->name_len;
+    return 1;
+}
+
+size_t rb_fill(read_batch* b, fq_reader* r, size_t max, int* status) {
+    fq_record rec;
+    int got = 1;
+
+    rb_clear(b);
+    while (b->n < max && (got = fq_next(r, &rec)) == 1) {
+        if (!rb_push(b, &rec)) {
+            got = -2;
+            break;
+        }
+    }
+    fq_recycle(r);
+
+    *status = got;
+    return b->n;
+}
+
+void rb_free(read_batch* b) {
+    free(b->seq);
+    free(b->qual);
+    free(b->off);
+    free(b->name);
+    free(b->name_off);
+    rb_init(b);
+}
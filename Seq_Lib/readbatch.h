@@ -0,0 +1,52 @@
+// Struct-of-arrays batch of reads: all sequences back to back in one
+// buffer, qualities and names in parallel buffers, and offset arrays to
+// find each read. Kernels walk the buffers linearly.
+
+#ifndef _READBATCH_H
+#define _READBATCH_H
+
+#include <stddef.h>
+
+#include "fqreader.h"
+
+// Read i has sequence seq[off[i], off[i+1]) and quality string
+// qual[off[i], off[i+1]); its name is name[name_off[i], name_off[i+1]).
+// No field is NUL-terminated.
+typedef struct {
+    size_t n;           // reads in batch
+    char* seq;
+    char* qual;
+    size_t* off;        // n + 1 entries, off[0] == 0
+    char* name;
+    size_t* name_off;   // n + 1 entries, name_off[0] == 0
+
+    // Don't use these fields directly.
+    size_t _cap;        // reads the offset arrays can hold
+    size_t _bytes_cap;  // bytes seq and qual can hold
+    size_t _name_cap;   // bytes name can hold
+} read_batch;
+
+// Set up empty batch.
+void rb_init(read_batch* b);
+
+// Empty batch but keep its buffers for reuse.
+void rb_clear(read_batch* b);
+
+// Append a copy of rec. Return 1, or 0 if out of memory.
+int rb_push(read_batch* b, const fq_record* rec);
+
+// Clear batch and fill it with up to max reads from r, returning how
+// many were stored. Since the batch owns copies, the reader's buffers are
+// recycled afterwards. *status is set to 1 if more input may follow, 0 at
+// end of file, -1 if the input is malformed and -2 if out of memory.
+size_t rb_fill(read_batch* b, fq_reader* r, size_t max, int* status);
+
+// Free the batch's buffers.
+void rb_free(read_batch* b);
+
+// Length of read i.
+static inline size_t rb_len(const read_batch* b, size_t i) {
+    return b->off[i + 1] - b->off[i];
+}
+
+#endif // _READBATCH_H
@@ -0,0 +1,148 @@
+// Per-tile read statistics.
+
+#include "tilestat.h"
+
+#include <stdlib.h>
+
+#include "gccount.h"
+#include "illumina.h"
+#include "qualstat.h"
+
+#define INITIAL_ROWS 64 // HiSeq and NovaSeq lanes have up to a few hundred tiles
+
+static uint64_t tile_key(uint32_t lane, uint32_t tile) {
+    return (uint64_t)lane << 32 | tile;
+}
+
+static size_t slot_of(uint64_t key, size_t nslots) {
+    // Fibonacci hashing: tile numbers are dense in their low digits.
+    return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & (nslots - 1);
+}
+
+// Put row i into the first free slot for its key.
+static void place(tile_stats* s, size_t i) {
+    size_t h = slot_of(tile_key(s->rows[i].lane, s->rows[i].tile), s->_nslots);
+    while (s->_slots[h] != 0) {
+        h = (h + 1) & (s->_nslots - 1);
+    }
+    s->_slots[h] = (uint32_t)(i + 1);
+}
+
+// Double the rows and the table. Return 0, or -1 if out of memory.
+static int grow(tile_stats* s) {
+    size_t cap = s->_cap ? 2 * s->_cap : INITIAL_ROWS;
+    tile_row* rows = realloc(s->rows, cap * sizeof *rows);
+    if (rows == NULL) {
+        return -1;
+    }
+    s->rows = rows;
+
+    uint32_t* slots = calloc(2 * cap, sizeof *slots);
+    if (slots == NULL) {
+        return -1;
+    }
+    free(s->_slots);
+    s->_slots = slots;
+    s->_nslots = 2 * cap;
+    s->_cap = cap;
+    for (size_t i = 0; i < s->n; i++) {
+        place(s, i);
+    }
+    return 0;
+}
+
+// Return the row of (lane, tile), adding an empty one if it is new, or
+// NULL if out of memory.
+static tile_row* find_row(tile_stats* s, uint32_t lane, uint32_t tile) {
+    if (s->n > 0 && s->rows[s->_last].lane == lane && s->rows[s->_last].tile == tile) {
+        return &s->rows[s->_last];
+    }
+
+    uint64_t key = tile_key(lane, tile);
+    if (s->_nslots > 0) {
+        size_t h = slot_of(key, s->_nslots);
+        for (; s->_slots[h] != 0; h = (h + 1) & (s->_nslots - 1)) {
+            tile_row* row = &s->rows[s->_slots[h] - 1];
+            if (tile_key(row->lane, row->tile) == key) {
+                s->_last = s->_slots[h] - 1;
+                return row;
+            }
+        }
+    }
+
+    if (s->n == s->_cap && grow(s) != 0) {
+        return NULL;
+    }
+    s->rows[s->n] = (tile_row){lane, tile, 0, 0, 0, 0};
+    place(s, s->n);
+    s->_last = s->n++;
+    return &s->rows[s->_last];
+}
+
+void ts_init(tile_stats* s, int offset) {
+    s->offset = offset;
+    s->n = 0;
+    s->rows = NULL;
+    s->unparsed = 0;
+    s->_cap = 0;
+    s->_slots = NULL;
+    s->_nslots = 0;
+    s->_last = 0;
+}
+
+int ts_add(tile_stats* s, const char* name, size_t name_len, const char* seq,
+           const char* qual, size_t len) {
+    ilmn_header h;
+    if (ilmn_parse(name, name_len, &h) != 0) {
+        s->unparsed++;
+        return 0;
+    }
+
+    tile_row* row = find_row(s, h.lane, h.tile);
+    if (row == NULL) {
+        return -1;
+    }
+    row->reads++;
+    row->bases += len;
+    // Bytes below the offset are not qualities; only keep the sum from
+    // wrapping below zero.
+    uint64_t raw = qs_sum(qual, len);
+    uint64_t base = (uint64_t)s->offset * len;
+    row->qual_sum += raw > base ? raw - base : 0;
+    row->gc_sum += gc_frac(gc_count(seq, len), len);
+    return 0;
+}
+
+int ts_merge(tile_stats* into, const tile_stats* from) {
+    for (size_t i = 0; i < from->n; i++) {
+        const tile_row* r = &from->rows[i];
+        tile_row* row = find_row(into, r->lane, r->tile);
+        if (row == NULL) {
+            return -1;
+        }
+        row->reads += r->reads;
+        row->bases += r->bases;
+        row->qual_sum += r->qual_sum;
+        row->gc_sum += r->gc_sum;
+    }
+    into->unparsed += from->unparsed;
+    return 0;
+}
+
+static int by_lane_tile(const void* a, const void* b) {
+    uint64_t ka = tile_key(((const tile_row*)a)->lane, ((const tile_row*)a)->tile);
+    uint64_t kb = tile_key(((const tile_row*)b)->lane, ((const tile_row*)b)->tile);
+    return (ka > kb) - (ka < kb);
+}
+
+void ts_sort(tile_stats* s) {
+    if (s->n > 1) {
+        qsort(s->rows, s->n, sizeof *s->rows, by_lane_tile);
+    }
+}
+
+void ts_free(tile_stats* s) {
+    free(s->rows);
+    free(s->_slots);
+    ts_init(s, s->offset);
+}
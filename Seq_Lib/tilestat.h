@@ -0,0 +1,57 @@
+// Read counts, quality and GC per flowcell (lane, tile), as in FastQC's
+// per-tile quality report, to spot bubbles, smudges and failing tiles.
+//
+// Tiles live in a small open-addressed table keyed on (lane, tile), in
+// the order first seen. Reads come off the sequencer grouped by tile, so
+// the tile of the previous read is checked before the table. Threads
+// keep their own tile_stats over their share of the reads and merge
+// them at the end.
+
+#ifndef _TILESTAT_H
+#define _TILESTAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    uint32_t lane;
+    uint32_t tile;
+    uint64_t reads;
+    uint64_t bases;
+    uint64_t qual_sum;  // sum of Phred scores
+    uint64_t gc_sum;    // sum of per-read GC fractions, in gc_frac units
+} tile_row;
+
+typedef struct {
+    int offset;         // 33 or 64
+    size_t n;           // tiles seen
+    tile_row* rows;     // rows[0, n)
+    uint64_t unparsed;  // reads whose names have no lane and tile
+
+    // Don't use these fields directly.
+    size_t _cap;        // rows allocated
+    uint32_t* _slots;   // row index + 1, or 0 for an empty slot
+    size_t _nslots;     // a power of two, at least twice _cap
+    size_t _last;       // row of the previous read
+} tile_stats;
+
+// Set up empty stats for qualities encoded as Phred + offset.
+void ts_init(tile_stats* s, int offset);
+
+// Add one read, given its name (without the '@') and its sequence and
+// qualities of length len, to the row of the lane and tile in its name,
+// or to s->unparsed. Return 0, or -1 if out of memory.
+int ts_add(tile_stats* s, const char* name, size_t name_len, const char* seq,
+           const char* qual, size_t len);
+
+// Add from into into. Return 0, or -1 if out of memory.
+int ts_merge(tile_stats* into, const tile_stats* from);
+
+// Sort s->rows by lane and then tile. Call after the last ts_add or
+// ts_merge, since the table is not rebuilt.
+void ts_sort(tile_stats* s);
+
+// Free the stats' buffers.
+void ts_free(tile_stats* s);
+
+#endif // _TILESTAT_H
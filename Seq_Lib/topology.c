@@ -0,0 +1,134 @@
+// NUMA topology from /sys/devices/system/node and pinning through
+// sched_setaffinity.
+
+#define _GNU_SOURCE
+#include "topology.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NODE_DIR "/sys/devices/system/node"
+
+// CPUs this process may use, grouped by node: node n has
+// cpus[first[n], first[n + 1]).
+static int ncpus;
+static int cpus[CPU_SETSIZE];
+static int nnodes;
+static int first[CPU_SETSIZE + 1];
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+// Add the CPUs of a sysfs list such as "0-3,8-11" to set. Return 0, or
+// -1 if the file cannot be read.
+static int read_list(const char* path, cpu_set_t* set) {
+    FILE* fp = fopen(path, "r");
+    if (fp == NULL) {
+        return -1;
+    }
+    char line[4096];
+    int ok = fgets(line, sizeof line, fp) != NULL;
+    fclose(fp);
+    if (!ok) {
+        return -1;
+    }
+
+    CPU_ZERO(set);
+    char* p = line;
+    while (*p >= '0' && *p <= '9') {
+        long lo = strtol(p, &p, 10);
+        long hi = lo;
+        if (*p == '-') {
+            hi = strtol(p + 1, &p, 10);
+        }
+        for (long c = lo; c <= hi && c < CPU_SETSIZE; c++) {
+            CPU_SET((int)c, set);
+        }
+        if (*p == ',') {
+            p++;
+        }
+    }
+    return 0;
+}
+
+static void add_node(const cpu_set_t* node, const cpu_set_t* allowed) {
+    int before = ncpus;
+    for (int c = 0; c < CPU_SETSIZE; c++) {
+        if (CPU_ISSET(c, node) && CPU_ISSET(c, allowed)) {
+            cpus[ncpus++] = c;
+        }
+    }
+    // Nodes without CPUs (memory only, or outside our mask) get no workers.
+    if (ncpus > before) {
+        first[nnodes++] = before;
+        first[nnodes] = ncpus;
+    }
+}
+
+static void discover(void) {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof allowed, &allowed) != 0) {
+        CPU_ZERO(&allowed);
+        CPU_SET(0, &allowed);
+    }
+
+    cpu_set_t online;
+    if (read_list(NODE_DIR "/online", &online) == 0) {
+        for (int n = 0; n < CPU_SETSIZE; n++) {
+            char path[64];
+            cpu_set_t node;
+            snprintf(path, sizeof path, NODE_DIR "/node%d/cpulist", n);
+            if (CPU_ISSET(n, &online) && read_list(path, &node) == 0) {
+                add_node(&node, &allowed);
+            }
+        }
+    }
+
+    // Without a topology (or if it left us no CPU) treat the machine as
+    // one node.
+    if (nnodes == 0) {
+        add_node(&allowed, &allowed);
+    }
+}
+
+int topo_nodes(void) {
+    pthread_once(&once, discover);
+    return nnodes;
+}
+
+int topo_node_cpus(int node) {
+    pthread_once(&once, discover);
+    return node >= 0 && node < nnodes ? first[node + 1] - first[node] : 0;
+}
+
+// Index into cpus of worker t's CPU: workers are spread evenly over the
+// CPUs of the first nodes nodes in order, so blocks of them fill one node
+// before the next.
+static int worker_cpu(int t, int nt, int nodes) {
+    if (nodes <= 0 || nodes > nnodes) {
+        nodes = nnodes;
+    }
+    return (int)((long)t * first[nodes] / nt);
+}
+
+int topo_worker_node(int t, int nt, int nodes) {
+    pthread_once(&once, discover);
+    int c = worker_cpu(t, nt, nodes);
+    int node = 0;
+    while (node + 1 < nnodes && first[node + 1] <= c) {
+        node++;
+    }
+    return node;
+}
+
+int topo_pin_worker(int t, int nt, int nodes) {
+    pthread_once(&once, discover);
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpus[worker_cpu(t, nt, nodes)], &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof set, &set) != 0) {
+        return -1;
+    }
+    return topo_worker_node(t, nt, nodes);
+}
@@ -0,0 +1,29 @@
+// NUMA topology and thread pinning, read from sysfs so no library is
+// needed.
+//
+// Pinning a worker to one CPU keeps it on one node, and Linux places a
+// page on the node of the thread that first writes it, so buffers a
+// pinned worker allocates and fills itself stay local to it.
+
+#ifndef _TOPOLOGY_H
+#define _TOPOLOGY_H
+
+// Return number of NUMA nodes this process may run on (1 when the
+// system exposes no topology).
+int topo_nodes(void);
+
+// Return number of CPUs of node this process may run on.
+int topo_node_cpus(int node);
+
+// Return the node worker t of nt is placed on when workers are spread
+// over the first nodes nodes (0 for all of them). Workers go to the
+// nodes in contiguous blocks sized to each node's CPU count, so
+// neighbouring workers share a node.
+int topo_worker_node(int t, int nt, int nodes);
+
+// Pin the calling thread to one CPU of the node topo_worker_node names,
+// workers of a node taking its CPUs in turn. Return that node, or -1 if
+// the thread could not be pinned (it then runs anywhere).
+int topo_pin_worker(int t, int nt, int nodes);
+
+#endif // _TOPOLOGY_H
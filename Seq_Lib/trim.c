@@ -0,0 +1,63 @@
+// Leading, trailing and sliding-window quality trimming.
+
+#include "trim.h"
+
+#include <stdint.h>
+
+void trim_defaults(trim_opts* o, int phred) {
+    o->leading = 0;
+    o->trailing = 0;
+    o->window = 0;
+    o->window_qual = 0;
+    o->min_len = 0;
+    o->phred = phred;
+}
+
+int trim_read(const trim_opts* o, const char* qual, size_t len, size_t* start, size_t* end) {
+    const unsigned char* q = (const unsigned char*)qual;
+    size_t a = 0;
+    size_t e = len;
+
+    // Bytes below these are cut; 0 cuts nothing.
+    int lead = o->leading > 0 ? o->leading + o->phred : 0;
+    int trail = o->trailing > 0 ? o->trailing + o->phred : 0;
+
+    while (a < e && q[a] < lead) {
+        a++;
+    }
+    while (e > a && q[e - 1] < trail) {
+        e--;
+    }
+
+    if (o->window > 0 && e > a) {
+        // A read shorter than the window is one window.
+        size_t w = (size_t)o->window < e - a ? (size_t)o->window : e - a;
+        int pass = o->window_qual + o->phred;
+        uint64_t need = (uint64_t)w * (uint64_t)pass;
+        uint64_t sum = 0;
+        for (size_t i = a; i < a + w; i++) {
+            sum += q[i];
+        }
+
+        // Window [i, i + w) slides one base at a time.
+        for (size_t i = a;; i++) {
+            if (sum < need) {
+                size_t cut = i;
+                while (cut < i + w && q[cut] >= pass) {
+                    cut++;
+                }
+                e = cut;
+                break;
+            }
+            if (i + w >= e) {
+                break;
+            }
+            sum += q[i + w];
+            sum -= q[i];
+        }
+    }
+
+    *start = a;
+    *end = e > a ? e : a;
+    return *end - *start >= o->min_len;
+}
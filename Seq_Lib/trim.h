@@ -0,0 +1,36 @@
+// Quality trimming of single reads, in the manner of Trimmomatic's
+// LEADING, TRAILING, SLIDINGWINDOW and MINLEN steps.
+//
+// Scores are compared as raw quality bytes: thresholds have the offset
+// added once when a trimmer is set up, so trimming Phred+33 and Phred+64
+// input runs the same loops with no subtraction per base. The sliding
+// window keeps a running sum, adding the base that enters and taking off
+// the one that leaves, so each step costs the same whatever the window.
+
+#ifndef _TRIM_H
+#define _TRIM_H
+
+#include <stddef.h>
+
+typedef struct {
+    int leading;        // cut bases scoring below this from the 5' end (0: off)
+    int trailing;       // the same from the 3' end (0: off)
+    int window;         // bases in the sliding window (0: off)
+    int window_qual;    // lowest mean score a window may have
+    size_t min_len;     // drop reads shorter than this after trimming
+    int phred;          // quality offset, 33 or 64
+} trim_opts;
+
+// Set o to no trimming at all, keeping reads of any length, for qualities
+// encoded as Phred + phred.
+void trim_defaults(trim_opts* o, int phred);
+
+// Find the part of a read to keep from its qualities qual[0, len): cut
+// the leading and then trailing low-quality bases, then scan windows
+// from the 5' end and cut at the first one whose mean score is too low,
+// keeping those of its bases that pass on their own. Set [*start, *end)
+// to what is left. Return 1 if it holds at least o->min_len bases, or 0
+// if the read should be dropped.
+int trim_read(const trim_opts* o, const char* qual, size_t len, size_t* start, size_t* end);
+
+#endif // _TRIM_H
@@ -0,0 +1,153 @@
+// Work stealing over iteration ranges: one locked range per thread,
+// taken from the front by its owner and halved from the back by thieves.
+
+#include "wsteal.h"
+
+#include <omp.h>
+#include <stdlib.h>
+
+#define CACHE_LINE 64
+
+// Iterations [lo, hi) a thread has left. Each sits on its own cache line
+// so owners taking work don't slow each other down.
+typedef struct {
+    omp_lock_t lock;
+    size_t lo;
+    size_t hi;
+} __attribute__((aligned(CACHE_LINE))) ws_range;
+
+// Take the back half of victim's iterations into *lo, *hi. Return 0 if
+// it had none.
+static int steal(ws_range* victim, size_t* lo, size_t* hi) {
+    int got = 0;
+    omp_set_lock(&victim->lock);
+    if (victim->hi > victim->lo) {
+        size_t take = (victim->hi - victim->lo + 1) / 2;
+        *hi = victim->hi;
+        *lo = victim->hi - take;
+        victim->hi = *lo;
+        got = 1;
+    }
+    omp_unset_lock(&victim->lock);
+    return got;
+}
+
+void ws_for(size_t n, size_t grain, ws_body body, void* ctx) {
+    int nt = omp_in_parallel() ? 1 : omp_get_max_threads();
+    if (grain == 0) {
+        grain = 1;
+    }
+    ws_range* ranges = nt > 1 && n > grain ? aligned_alloc(CACHE_LINE, nt * sizeof(ws_range)) : NULL;
+    if (ranges == NULL) {
+        if (n > 0) {
+            body(ctx, 0, n);
+        }
+        return;
+    }
+
+    for (int t = 0; t < nt; t++) {
+        omp_init_lock(&ranges[t].lock);
+        ranges[t].lo = n * t / nt;
+        ranges[t].hi = n * (t + 1) / nt;
+    }
+
+    #pragma omp parallel num_threads(nt)
+    {
+        int t = omp_get_thread_num();
+        ws_range* own = &ranges[t];
+        unsigned seed = (unsigned)t * 2654435761u + 1;
+
+        // A smaller team than asked for leaves some shares without an
+        // owner; they are simply stolen.
+        for (;;) {
+            omp_set_lock(&own->lock);
+            size_t lo = own->lo;
+            size_t hi = own->hi - lo > grain ? lo + grain : own->hi;
+            own->lo = hi;
+            omp_unset_lock(&own->lock);
+
+            if (lo < hi) {
+                body(ctx, lo, hi);
+                continue;
+            }
+
+            // Try every other range once, from a random start so thieves
+            // spread out. Work is only ever moved, never added, so when
+            // all are empty the rest is in the hands of running threads.
+            int found = 0;
+            seed = seed * 1103515245 + 12345;
+            int start = (int)(seed >> 16) % nt;
+            for (int k = 0; k < nt && !found; k++) {
+                int v = (start + k) % nt;
+                if (v != t && steal(&ranges[v], &lo, &hi)) {
+                    found = 1;
+                }
+            }
+            if (!found) {
+                break;
+            }
+
+            omp_set_lock(&own->lock);
+            own->lo = lo;
+            own->hi = hi;
+            omp_unset_lock(&own->lock);
+        }
+    }
+
+    for (int t = 0; t < nt; t++) {
+        omp_destroy_lock(&ranges[t].lock);
+    }
+    free(ranges);
+}
+
+// A ws_for_bases loop, for the body that runs its pieces.
+typedef struct {
+    const size_t* off;
+    size_t n;
+    size_t piece;
+    ws_part part;
+    void* ctx;
+} bases_loop;
+
+static void run_pieces(void* ctx, size_t begin, size_t end) {
+    const bases_loop* loop = ctx;
+    const size_t* off = loop->off;
+    size_t lo = off[0] + begin * loop->piece;
+    size_t hi = off[0] + end * loop->piece;
+    if (hi > off[loop->n]) {
+        hi = off[loop->n];
+    }
+
+    // First read ending after lo.
+    size_t a = 0;
+    size_t b = loop->n;
+    while (a < b) {
+        size_t mid = a + (b - a) / 2;
+        if (off[mid + 1] <= lo) {
+            a = mid + 1;
+        } else {
+            b = mid;
+        }
+    }
+
+    for (size_t r = a; r < loop->n && off[r] < hi; r++) {
+        size_t from = lo > off[r] ? lo - off[r] : 0;
+        size_t to = (hi < off[r + 1] ? hi : off[r + 1]) - off[r];
+        if (to > from) {
+            loop->part(loop->ctx, r, from, to, from == 0 && to == off[r + 1] - off[r]);
+        }
+    }
+}
+
+void ws_for_bases(const size_t* off, size_t n, size_t piece, ws_part part, void* ctx) {
+    // An empty batch may have no offsets at all.
+    if (n == 0) {
+        return;
+    }
+    if (piece == 0) {
+        piece = 1;
+    }
+    bases_loop loop = {off, n, piece, part, ctx};
+    size_t bases = off[n] - off[0];
+    ws_for((bases + piece - 1) / piece, 1, run_pieces, &loop);
+}
@@ -0,0 +1,34 @@
+// Work-stealing loops for work of uneven cost, on the OpenMP threads.
+//
+// Every thread starts with an even share of the iterations and works
+// through it from the front, a few at a time. A thread that runs out
+// steals the back half of another thread's remaining share, so threads
+// stay busy until the whole range is done however uneven the iterations
+// turn out to be.
+
+#ifndef _WSTEAL_H
+#define _WSTEAL_H
+
+#include <stddef.h>
+
+// Body of a loop: run iterations [begin, end).
+typedef void (*ws_body)(void* ctx, size_t begin, size_t end);
+
+// Run body over [0, n) on all threads, handing out grain iterations at a
+// time. Inside a parallel region, or if out of memory, the loop runs on
+// the calling thread.
+void ws_for(size_t n, size_t grain, ws_body body, void* ctx);
+
+// Body of a loop over bases: run bases [from, to) of read `read`. whole is
+// 1 if that is the whole read, so this call is the only one for it.
+typedef void (*ws_part)(void* ctx, size_t read, size_t from, size_t to, int whole);
+
+// Run part over the bases of n reads, read i having bases [off[i],
+// off[i + 1]) of one run of bases, as with read_batch offsets. The run is
+// cut into pieces of `piece` bases that are stolen like ws_for
+// iterations, so short reads are grouped and a long read is shared
+// between threads. A read cut by piece ends gets one call per piece it
+// touches, possibly on different threads at once.
+void ws_for_bases(const size_t* off, size_t n, size_t piece, ws_part part, void* ctx);
+
+#endif // _WSTEAL_H